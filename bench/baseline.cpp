@@ -0,0 +1,70 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/baseline.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/parser.hpp"
+
+#ifdef MC_HAVE_CODEGEN
+#include "mc-compiler/codegen.hpp"
+#include "mc-compiler/target.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#endif
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Compiles a generated corpus from the parsed program to an ELF object in
+// memory with the baseline compiler, then, where LLVM is available, to an
+// object at -O0 through the target machine. Parsing is not included.
+
+int benchBaseline(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 100;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench baseline [functions] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeCorpus(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+
+  std::size_t code = 0;
+  std::size_t object = 0;
+  double baseline = measure<std::chrono::microseconds>(passes, [&] {
+    x86_object obj = generateBaseline(prog);
+    std::ostringstream os;
+    writeElf(obj, os);
+    code = obj.code.size();
+    object = os.str().size();
+  });
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "input:     " << fns << " functions\n"
+            << "baseline:  " << baseline << " us (" << baseline / fns << " us per function), "
+            << code << " bytes of code, " << object << " byte object\n";
+#ifdef MC_HAVE_CODEGEN
+  std::error_code ec;
+  llvm::raw_fd_ostream null("/dev/null", ec, llvm::sys::fs::OF_None);
+  double llvm_O0 = measure<std::chrono::microseconds>(passes, [&] {
+    auto cxt = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> mod = generate(*cxt, prog);
+    std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine("native", opt_none);
+    setTarget(*mod, *tm);
+    emit(*mod, *tm, emit_object, null);
+  });
+  std::cout << "llvm -O0:  " << llvm_O0 << " us (" << llvm_O0 / fns << " us per function, " << std::setprecision(0)
+            << llvm_O0 / baseline << "x)\n";
+#endif
+  return 0;
+}
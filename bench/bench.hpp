@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Each benchmark is a subcommand of mc-bench. It receives the arguments
+// that follow its name and returns the process exit status.
+int benchLex(int argc, char* argv[]);
+int benchLexAlloc(int argc, char* argv[]);
+int benchSymbols(int argc, char* argv[]);
+int benchParse(int argc, char* argv[]);
+int benchSema(int argc, char* argv[]);
+int benchFlat(int argc, char* argv[]);
+int benchParseAlloc(int argc, char* argv[]);
+int benchInterp(int argc, char* argv[]);
+int benchBaseline(int argc, char* argv[]);
+int benchC(int argc, char* argv[]);
+int benchSsa(int argc, char* argv[]);
+#ifdef MC_HAVE_CODEGEN
+int benchCodegen(int argc, char* argv[]);
+#endif
+
+class file;
+
+// Writes 'text' to a temporary file and opens it. The file is unlinked
+// straight away; the returned object keeps its contents.
+std::unique_ptr<file> makeInput(const std::string& text);
+
+// A function whose body is 2 * 'stmts' assignments between a few
+// variables, eight identifier uses per pair.
+std::string makeAssignments(std::size_t stmts);
+
+// 'fns' functions of about ten statements each.
+std::string makeCorpus(std::size_t fns);
+
+// makeCorpus('fns') and a main that calls every function once and returns
+// the sum of their results modulo 256, for use as an exit status.
+std::string makeProgram(std::size_t fns);
+
+// The number of calls to the global operator new so far.
+std::size_t allocationCount();
+
+// A cycle counter where the target has one, nanoseconds otherwise.
+inline std::uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Runs 'fn' 'passes' times and returns the fastest run, counted in
+// 'Unit', a std::chrono duration.
+template<typename Unit, typename F>
+double measure(int passes, F fn) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i != passes; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double, typename Unit::period> t = std::chrono::steady_clock::now() - start;
+    best = std::min(best, t.count());
+  }
+  return best;
+}
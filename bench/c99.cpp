@@ -0,0 +1,103 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/c99.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/parser.hpp"
+
+#ifdef MC_HAVE_CODEGEN
+#include "mc-compiler/codegen.hpp"
+#include "mc-compiler/target.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Builds a generated corpus whose main calls every function once into an
+// executable two ways: translated to C and compiled by the system C
+// compiler at -O2, and, where LLVM is available, lowered and optimized at
+// -O2 by the LLVM backend with the same compiler linking the object. Both
+// executables are run to check that they agree. $CC picks the compiler.
+
+//The exit status of 'command', or -1 if it did not exit normally.
+static int runCommand(const std::string& command) {
+  int status = std::system(command.c_str());
+  return status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int benchC(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 100;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 3;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench c [functions] [passes]\n";
+    return 1;
+  }
+  const char* cc = std::getenv("CC") ? std::getenv("CC") : "cc";
+
+  std::unique_ptr<file> input = makeInput(makeProgram(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+
+  char dir[] = "/tmp/mc-bench-XXXXXX";
+  if (!mkdtemp(dir)) {
+    throw std::runtime_error(std::string("mkdtemp: ") + std::strerror(errno));
+  }
+  std::string base = dir;
+
+  std::string text;
+  double translate = measure<std::chrono::milliseconds>(passes, [&] {
+    std::ostringstream os;
+    generateC(prog, os);
+    text = os.str();
+  });
+  std::ofstream(base + "/out.c") << text;
+
+  std::string compile = std::string(cc) + " -std=c99 -O2 -c " + base + "/out.c -o " + base + "/c.o";
+  double c_build = measure<std::chrono::milliseconds>(passes, [&] {
+    if (runCommand(compile) != 0) {
+      throw std::runtime_error("failed: " + compile);
+    }
+  });
+  runCommand(std::string(cc) + " " + base + "/c.o -o " + base + "/c.out -lm");
+  int c_result = runCommand(base + "/c.out");
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "input:     " << fns << " functions, " << text.size() << " bytes of C\n"
+            << "translate: " << translate << " ms\n"
+            << "cc -O2:    " << c_build << " ms, main returns " << c_result << '\n';
+#ifdef MC_HAVE_CODEGEN
+  std::string object = base + "/llvm.o";
+  double llvm_build = measure<std::chrono::milliseconds>(passes, [&] {
+    auto cxt = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> mod = generate(*cxt, prog);
+    std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine("native", opt_default);
+    setTarget(*mod, *tm);
+    optimize(*mod, opt_default, tm.get());
+    std::error_code ec;
+    llvm::raw_fd_ostream os(object, ec, llvm::sys::fs::OF_None);
+    emit(*mod, *tm, emit_object, os);
+  });
+  runCommand(std::string(cc) + " " + object + " -o " + base + "/llvm.out -lm");
+  int llvm_result = runCommand(base + "/llvm.out");
+  std::cout << "llvm -O2:  " << llvm_build << " ms, main returns " << llvm_result << '\n';
+#endif
+  runCommand("rm -rf " + base);
+  return 0;
+}
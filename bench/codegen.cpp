@@ -0,0 +1,58 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/codegen.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/parser.hpp"
+#include "mc-compiler/target.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Lowers and optimizes a generated corpus at -O2, first in one module and
+// then split across 1, 2, 4 and 8 worker threads. The figure is wall
+// time, so it only improves with threads the machine actually has. The
+// serial leg targets the host like the workers do, so the ratios measure
+// the partitioning alone.
+
+int benchCodegen(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 2000;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 3;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench codegen [functions] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeCorpus(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+
+  double serial = measure<std::chrono::milliseconds>(passes, [&] {
+    llvm::LLVMContext cxt;
+    std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine("native", opt_default);
+    std::unique_ptr<llvm::Module> mod = generate(cxt, prog);
+    setTarget(*mod, *tm);
+    optimize(*mod, opt_default, tm.get());
+  });
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "input:     " << fns << " functions, " << std::thread::hardware_concurrency() << " hardware threads\n"
+            << "serial:    " << serial << " ms\n";
+  for (unsigned jobs : {1u, 2u, 4u, 8u}) {
+    double ms = measure<std::chrono::milliseconds>(passes, [&] {
+      llvm::LLVMContext cxt;
+      generate(cxt, prog, opt_default, jobs, "native");
+    });
+    std::cout << "-j " << jobs << ":      " << ms << " ms (" << std::setprecision(2) << serial / ms
+              << "x)\n" << std::setprecision(1);
+  }
+  return 0;
+}
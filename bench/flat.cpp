@@ -0,0 +1,228 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/flat_ast.hpp"
+#include "mc-compiler/parser.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Builds a large program both as the usual tree of nodes and as a flat
+// AST, then compares their size and the time to walk every expression.
+// Both walks visit the same nodes and compute the same sum.
+
+struct tally {
+  std::size_t nodes = 0;
+  long long sum = 0;
+};
+
+static void walk(const expr* e, tally& t) {
+  ++t.nodes;
+  switch (e->getKind()) {
+    case expr::int_kind:
+      t.sum += static_cast<const int_expr*>(e)->val;
+      break;
+    case expr::unop_kind:
+      walk(static_cast<const unop_expr*>(e)->m_arg, t);
+      break;
+    case expr::binop_kind:
+      walk(static_cast<const binop_expr*>(e)->m_lhs, t);
+      walk(static_cast<const binop_expr*>(e)->m_rhs, t);
+      break;
+    case expr::assign_kind:
+      walk(static_cast<const assign_expr*>(e)->m_lhs, t);
+      walk(static_cast<const assign_expr*>(e)->m_rhs, t);
+      break;
+    case expr::cast_kind:
+      walk(static_cast<const cast_expr*>(e)->m_src, t);
+      break;
+    case expr::conv_kind:
+      walk(static_cast<const conv_expr*>(e)->m_src, t);
+      break;
+    case expr::cond_kind:
+      walk(static_cast<const cond_expr*>(e)->m_cond, t);
+      walk(static_cast<const cond_expr*>(e)->m_true, t);
+      walk(static_cast<const cond_expr*>(e)->m_false, t);
+      break;
+    case expr::call_kind:
+    case expr::index_kind:
+      walk(static_cast<const postfix_expr*>(e)->m_base, t);
+      for (const expr* a : static_cast<const postfix_expr*>(e)->m_args) {
+        walk(a, t);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void walk(const decl* d, tally& t);
+
+static void walk(const stmt* s, tally& t) {
+  switch (s->getKind()) {
+    case stmt::block_kind:
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        walk(s1, t);
+      }
+      break;
+    case stmt::when_kind:
+      walk(static_cast<const when_stmt*>(s)->getCondition(), t);
+      walk(static_cast<const when_stmt*>(s)->getBody(), t);
+      break;
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      walk(i->getCondition(), t);
+      walk(i->getTrueBranch(), t);
+      if (i->getFalseBranch()) {
+        walk(i->getFalseBranch(), t);
+      }
+      break;
+    }
+    case stmt::while_kind:
+      walk(static_cast<const while_stmt*>(s)->getCondition(), t);
+      walk(static_cast<const while_stmt*>(s)->getBody(), t);
+      break;
+    case stmt::ret_kind:
+      if (const expr* e = static_cast<const ret_stmt*>(s)->m_val) {
+        walk(e, t);
+      }
+      break;
+    case stmt::decl_kind:
+      walk(static_cast<const decl_stmt*>(s)->m_decl, t);
+      break;
+    case stmt::expr_kind:
+      walk(static_cast<const expr_stmt*>(s)->m_expr, t);
+      break;
+    default:
+      break;
+  }
+}
+
+static void walk(const decl* d, tally& t) {
+  if (d->getKind() == decl::fn_kind) {
+    if (const stmt* s = static_cast<const fn_decl*>(d)->getBody()) {
+      walk(s, t);
+    }
+  } else if (const expr* e = static_cast<const object_decl*>(d)->getInit()) {
+    walk(e, t);
+  }
+}
+
+static void walkFlat(const flat_ast& ast, flat_ast::index e, tally& t) {
+  ast.forEachPostorder(e, [&](flat_ast::index n) {
+    ++t.nodes;
+    if (ast.getKind(n) == expr::int_kind) {
+      t.sum += ast.getInt(n);
+    }
+  });
+}
+
+static void walkFlatDecl(const flat_ast& ast, flat_ast::index d, tally& t);
+
+static void walkFlatStmt(const flat_ast& ast, flat_ast::index s, tally& t) {
+  switch (ast.getStatementKind(s)) {
+    case stmt::block_kind:
+      for (flat_ast::index s1 : ast.getStatements(s)) {
+        walkFlatStmt(ast, s1, t);
+      }
+      break;
+    case stmt::when_kind:
+    case stmt::while_kind:
+      walkFlat(ast, ast.getStatementCondition(s), t);
+      walkFlatStmt(ast, ast.getBody(s), t);
+      break;
+    case stmt::if_kind:
+      walkFlat(ast, ast.getStatementCondition(s), t);
+      walkFlatStmt(ast, ast.getTrueBranch(s), t);
+      if (ast.getFalseBranch(s) != flat_ast::none) {
+        walkFlatStmt(ast, ast.getFalseBranch(s), t);
+      }
+      break;
+    case stmt::ret_kind:
+      if (ast.getStatementExpression(s) != flat_ast::none) {
+        walkFlat(ast, ast.getStatementExpression(s), t);
+      }
+      break;
+    case stmt::decl_kind:
+      walkFlatDecl(ast, ast.getStatementDeclaration(s), t);
+      break;
+    case stmt::expr_kind:
+      walkFlat(ast, ast.getStatementExpression(s), t);
+      break;
+    default:
+      break;
+  }
+}
+
+static void walkFlatDecl(const flat_ast& ast, flat_ast::index d, tally& t) {
+  if (ast.getDeclarationKind(d) == decl::fn_kind) {
+    if (ast.getFunctionBody(d) != flat_ast::none) {
+      walkFlatStmt(ast, ast.getFunctionBody(d), t);
+    }
+  } else if (ast.getInit(d) != flat_ast::none) {
+    walkFlat(ast, ast.getInit(d), t);
+  }
+}
+
+int benchFlat(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 50000;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench flat [functions] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeCorpus(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+  const auto& decls = static_cast<const prog_decl*>(prog)->getDeclarations();
+
+  flat_ast flat(prog);
+
+  tally tree;
+  double tree_time = measure<std::chrono::nanoseconds>(passes, [&] {
+    tree = tally();
+    for (const decl* d : decls) {
+      walk(d, tree);
+    }
+  });
+
+  tally compact;
+  double flat_time = measure<std::chrono::nanoseconds>(passes, [&] {
+    compact = tally();
+    for (flat_ast::index d : flat.getDeclarations()) {
+      walkFlatDecl(flat, d, compact);
+    }
+  });
+
+  //Every expression in the flat AST, in evaluation order.
+  tally scan;
+  double scan_time = measure<std::chrono::nanoseconds>(passes, [&] {
+    scan = tally();
+    for (flat_ast::index e = 0; e != flat.getNumExpressions(); ++e) {
+      ++scan.nodes;
+      if (flat.getKind(e) == expr::int_kind) {
+        scan.sum += flat.getInt(e);
+      }
+    }
+  });
+
+  if (tree.nodes != compact.nodes || tree.sum != compact.sum || scan.sum != tree.sum) {
+    std::cerr << "the walks disagree\n";
+    return 1;
+  }
+
+  std::size_t nodes = flat.getNumExpressions() + flat.getNumStatements() + flat.getNumDeclarations();
+  std::cout << std::fixed << std::setprecision(2)
+            << "nodes:       " << nodes << " (" << tree.nodes << " expressions)\n"
+            << "tree:        " << double(ast.getCapacity()) / nodes << " bytes/node, "
+            << tree_time / tree.nodes << " ns/expression\n"
+            << "flat:        " << double(flat.getMemoryUsage()) / nodes << " bytes/node, "
+            << flat_time / tree.nodes << " ns/expression\n"
+            << "flat (scan): " << scan_time / tree.nodes << " ns/expression\n";
+  return 0;
+}
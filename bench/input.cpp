@@ -0,0 +1,59 @@
+#include "bench.hpp"
+
+#include "mc-compiler/file.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+std::unique_ptr<file> makeInput(const std::string& text) {
+  char path[] = "/tmp/mc-bench-XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("mkstemp: ") + std::strerror(errno));
+  }
+  close(fd);
+  std::ofstream(path) << text;
+  auto f = std::make_unique<file>(path);
+  unlink(path);
+  return f;
+}
+
+//A few small helpers, then functions mixing declarations, loops,
+//conditionals and calls with zero to three arguments.
+std::string makeCorpus(std::size_t fns) {
+  std::stringstream ss;
+  ss << "def zero() -> int { return 0; }\n"
+     << "def neg(a : int) -> int { return 0 - a; }\n"
+     << "def sub(a : int, b : int) -> int { return a - b; }\n"
+     << "def mid(a : int, b : int, c : int) -> int { return (a + b + c) / 3; }\n";
+  for (std::size_t i = 0; i != fns; ++i) {
+    ss << "def f" << i << "(a : int, b : int) -> int {\n"
+       << "  var x : int = a * " << i % 97 << " + b;\n"
+       << "  var y : int = (b << 2) ^ (a & 255);\n"
+       << "  while (x > y) {\n"
+       << "    x = x - (y + 3) * 2;\n"
+       << "    if (x == 7)\n"
+       << "      y = y | 1;\n"
+       << "    else\n"
+       << "      y = neg(x);\n"
+       << "  }\n"
+       << "  return sub(x, y) + mid(a, b, x) - zero();\n"
+       << "}\n";
+  }
+  return ss.str();
+}
+
+std::string makeProgram(std::size_t fns) {
+  std::stringstream ss;
+  ss << makeCorpus(fns) << "def main() -> int {\n  var r : int = 0;\n";
+  for (std::size_t i = 0; i != fns; ++i) {
+    ss << "  r = r + f" << i << "(" << i << ", 1);\n";
+  }
+  ss << "  return r % 256;\n}\n";
+  return ss.str();
+}
@@ -0,0 +1,63 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/bytecode.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/interp.hpp"
+#include "mc-compiler/parser.hpp"
+
+#ifdef MC_HAVE_CODEGEN
+#include "mc-compiler/codegen.hpp"
+#include "mc-compiler/jit.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#endif
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Runs a generated corpus whose main calls every function once, from the
+// parsed program to main's result: compiled to bytecode and interpreted,
+// then, where LLVM is available, lowered at -O0 and run by the lazy JIT.
+// Parsing is the same for both and not included.
+
+int benchInterp(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 100;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench interp [functions] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeProgram(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+
+  int result = 0;
+  double compile = measure<std::chrono::microseconds>(passes, [&] {
+    bc_program bc(prog);
+  });
+  double interp = measure<std::chrono::microseconds>(passes, [&] {
+    bc_program bc(prog);
+    interpreter vm(bc);
+    result = vm.runMain();
+  });
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "input:     " << fns << " functions, main returns " << result << '\n'
+            << "bytecode:  " << compile << " us (" << compile / fns << " us per function)\n"
+            << "interp:    " << interp << " us end to end\n";
+#ifdef MC_HAVE_CODEGEN
+  double jit = measure<std::chrono::microseconds>(passes, [&] {
+    auto cxt = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> mod = generate(*cxt, prog);
+    runMain(std::move(cxt), std::move(mod));
+  });
+  std::cout << "jit -O0:   " << jit << " us end to end (" << std::setprecision(2) << jit / interp << "x)\n";
+#endif
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "bench.hpp"
+
+#include "mc-compiler/chars.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/lexer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+// Compares the locale-aware <cctype> predicates the lexer used to call on
+// every byte with the compile-time class table, then measures the whole
+// lexer. Every figure is the best of several passes over the input.
+
+static std::size_t classifyLibc(std::string_view text) {
+  std::size_t n = 0;
+  for (char c : text) {
+    n += std::isalpha(c) || c == '_';
+    n += std::isdigit(c) != 0;
+    n += std::isxdigit(c) != 0;
+  }
+  return n;
+}
+
+static std::size_t classifyTable(std::string_view text) {
+  std::size_t n = 0;
+  for (char c : text) {
+    n += hasCharClass(c, cc_nondigit);
+    n += hasCharClass(c, cc_digit);
+    n += hasCharClass(c, cc_hex_digit);
+  }
+  return n;
+}
+
+static std::size_t lexAll(const file& f) {
+  symbol_table syms;
+  lexer lex(syms, f);
+  std::size_t n = 0;
+  while (lex()) {
+    ++n;
+  }
+  return n;
+}
+
+template<typename F>
+static double measure(std::size_t bytes, int passes, F fn) {
+  std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+  for (int i = 0; i != passes; ++i) {
+    std::uint64_t start = readCycles();
+    volatile std::size_t sink = fn();
+    (void)sink;
+    best = std::min(best, readCycles() - start);
+  }
+  return double(best) / bytes;
+}
+
+int benchLex(int argc, char* argv[]) {
+  if (argc < 1) {
+    std::cerr << "usage: mc-bench lex <file> [passes]\n";
+    return 1;
+  }
+
+  file f(argv[0]);
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  std::string_view text = f.getText();
+  if (text.empty()) {
+    std::cerr << "input is empty\n";
+    return 1;
+  }
+
+  double libc = measure(text.size(), passes, [&] { return classifyLibc(text); });
+  double table = measure(text.size(), passes, [&] { return classifyTable(text); });
+  double lex = measure(text.size(), passes, [&] { return lexAll(f); });
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "input:              " << text.size() << " bytes\n"
+            << "classify (cctype):  " << libc << " cycles/byte\n"
+            << "classify (table):   " << table << " cycles/byte\n"
+            << "lex:                " << lex << " cycles/byte\n";
+  return 0;
+}
+
+// Lexes the input twice against one symbol table. The first pass interns
+// every spelling; the second should not touch the heap at all.
+int benchLexAlloc(int argc, char* argv[]) {
+  if (argc < 1) {
+    std::cerr << "usage: mc-bench lex-alloc <file>\n";
+    return 1;
+  }
+
+  file f(argv[0]);
+  symbol_table syms;
+  for (const char* pass : {"cold", "warm"}) {
+    lexer lex(syms, f);
+    std::size_t tokens = 0;
+    std::size_t before = allocationCount();
+    while (lex()) {
+      ++tokens;
+    }
+    std::size_t allocs = allocationCount() - before;
+    std::cout << pass << ": " << tokens << " tokens, " << allocs << " allocations ("
+              << std::setprecision(4) << (tokens ? double(allocs) / tokens : 0.0) << " per token)\n";
+  }
+  return 0;
+}
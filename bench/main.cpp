@@ -0,0 +1,47 @@
+#include "bench.hpp"
+
+#include <cstring>
+#include <iostream>
+
+struct benchmark {
+  const char* name;
+  const char* help;
+  int (*run)(int argc, char* argv[]);
+};
+
+static const benchmark benchmarks[] = {
+  {"lex", "<file>  cycles per byte for character classification and lexing", benchLex},
+  {"lex-alloc", "<file>  heap allocations per token, cold and warm symbol table", benchLexAlloc},
+  {"symbols", "[ops]  symbol table throughput at 1/4/16/64 threads", benchSymbols},
+  {"parse", "[terms]  nanoseconds per operand for the two expression parsers", benchParse},
+  {"sema", "[statements]  cycles per identifier use when type-checking names", benchSema},
+  {"flat", "[statements]  memory and traversal time, pointer tree vs flat AST", benchFlat},
+  {"parse-alloc", "[functions]  heap allocations made while parsing a generated corpus", benchParseAlloc},
+  {"interp", "[functions]  bytecode compile time and end-to-end run, interpreter vs lazy JIT", benchInterp},
+  {"baseline", "[functions]  time to compile to an object, baseline compiler vs LLVM -O0", benchBaseline},
+  {"c", "[functions]  build time through C and the system compiler vs LLVM, both at -O2", benchC},
+  {"ssa", "[functions]  time to build the SSA IR, and to reach LLVM through it vs from the AST", benchSsa},
+#ifdef MC_HAVE_CODEGEN
+  {"codegen", "[functions]  time to lower and optimize at -O2, one module vs 1/2/4/8 threads", benchCodegen},
+#endif
+};
+
+static int usage() {
+  std::cerr << "usage: mc-bench <benchmark> [args...]\n";
+  for (const benchmark& b : benchmarks) {
+    std::cerr << "  " << b.name << ' ' << b.help << '\n';
+  }
+  return 1;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    return usage();
+  }
+  for (const benchmark& b : benchmarks) {
+    if (std::strcmp(argv[1], b.name) == 0) {
+      return b.run(argc - 2, argv + 2);
+    }
+  }
+  return usage();
+}
@@ -0,0 +1,274 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/lexer.hpp"
+#include "mc-compiler/parser.hpp"
+#include "mc-compiler/semantics.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+// Compares the precedence-climbing expression parser with the original
+// one-function-per-level descent, which only lives here now. The input is
+// one long expression of integer literals joined by a random mix of the
+// integer operators, so most of the time goes into deciding how to group
+// operands.
+
+static const char* const operators[] = {
+  "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^",
+};
+
+static std::string makeExpression(std::size_t terms, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> op(0, std::size(operators) - 1);
+  std::uniform_int_distribution<int> digit(1, 9);
+  std::string text;
+  text += char('0' + digit(gen));
+  for (std::size_t i = 1; i != terms; ++i) {
+    text += ' ';
+    text += operators[op(gen)];
+    text += ' ';
+    text += char('0' + digit(gen));
+  }
+  text += '\n';
+  return text;
+}
+
+// The grammar parseBinaryExpression replaced: each precedence level calls
+// the next one for its operands, so every operand passes through all ten.
+// Only what the generated input holds is supported.
+class descent_parser {
+  public:
+    descent_parser(symbol_table& syms, ast_context& ast, const file& f) : m_lex(syms, f), m_act(ast), m_tok(m_lex()) {}
+
+    semantics& getSemantics() {
+      return m_act;
+    }
+
+    expr* parseLogicalOrExpression();
+
+  private:
+    token accept() {
+      token tok = m_tok;
+      m_tok = m_lex();
+      return tok;
+    }
+
+    bool matchIf(token_name n, logical_op op) {
+      if (m_tok.getName() == n && m_tok.getLogicalOp() == op) {
+        accept();
+        return true;
+      }
+      return false;
+    }
+
+    bool matchIf(bitwise_op op) {
+      if (m_tok.getName() == tok_bitwise_operator && m_tok.getBitwiseOp() == op) {
+        accept();
+        return true;
+      }
+      return false;
+    }
+
+    template<typename... Ops>
+    token matchIfRelation(Ops... ops) {
+      if (m_tok.getName() == tok_relational_operator && ((m_tok.getRelationOp() == ops) || ...)) {
+        return accept();
+      }
+      return {};
+    }
+
+    template<typename... Ops>
+    token matchIfBitwise(Ops... ops) {
+      if (m_tok.getName() == tok_bitwise_operator && ((m_tok.getBitwiseOp() == ops) || ...)) {
+        return accept();
+      }
+      return {};
+    }
+
+    template<typename... Ops>
+    token matchIfArithmetic(Ops... ops) {
+      if (m_tok.getName() == tok_arithmetic_operator && ((m_tok.getArithmeticOp() == ops) || ...)) {
+        return accept();
+      }
+      return {};
+    }
+
+    expr* parseLogicalAndExpression();
+    expr* parseBitwiseOrExpression();
+    expr* parseBitwiseXorExpression();
+    expr* parseBitwiseAndExpression();
+    expr* parseEqualityExpression();
+    expr* parseRelationalExpression();
+    expr* parseShiftExpression();
+    expr* parseAdditiveExpression();
+    expr* parseMultiplicativeExpression();
+    expr* parseCastExpression();
+
+    lexer m_lex;
+    semantics m_act;
+    token m_tok;
+};
+
+expr* descent_parser::parseLogicalOrExpression() {
+  expr* e1 = parseLogicalAndExpression();
+  while (matchIf(tok_logical_operator, logical_or)) {
+    expr* e2 = parseLogicalAndExpression();
+    e1 = m_act.onLogicalOrExpression(e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseLogicalAndExpression() {
+  expr* e1 = parseBitwiseOrExpression();
+  while (matchIf(tok_logical_operator, logical_and)) {
+    expr* e2 = parseBitwiseOrExpression();
+    e1 = m_act.onLogicalAndExpression(e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseBitwiseOrExpression() {
+  expr* e1 = parseBitwiseXorExpression();
+  while (matchIf(op_ior)) {
+    expr* e2 = parseBitwiseXorExpression();
+    e1 = m_act.onBitwiseOrExpression(e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseBitwiseXorExpression() {
+  expr* e1 = parseBitwiseAndExpression();
+  while (matchIf(op_xor)) {
+    expr* e2 = parseBitwiseAndExpression();
+    e1 = m_act.onBitwiseXorExpression(e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseBitwiseAndExpression() {
+  expr* e1 = parseEqualityExpression();
+  while (matchIf(op_and)) {
+    expr* e2 = parseEqualityExpression();
+    e1 = m_act.onBitwiseAndExpression(e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseEqualityExpression() {
+  expr* e1 = parseRelationalExpression();
+  while (token tok = matchIfRelation(op_eq, op_ne)) {
+    expr* e2 = parseRelationalExpression();
+    e1 = m_act.onEqualityExpression(tok, e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseRelationalExpression() {
+  expr* e1 = parseShiftExpression();
+  while (token tok = matchIfRelation(op_lt, op_gt, op_le, op_ge)) {
+    expr* e2 = parseShiftExpression();
+    e1 = m_act.onRelationalExpression(tok, e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseShiftExpression() {
+  expr* e1 = parseAdditiveExpression();
+  while (token tok = matchIfBitwise(op_shl, op_shr)) {
+    expr* e2 = parseAdditiveExpression();
+    e1 = m_act.onShiftExpression(tok, e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseAdditiveExpression() {
+  expr* e1 = parseMultiplicativeExpression();
+  while (token tok = matchIfArithmetic(op_add, op_sub)) {
+    expr* e2 = parseMultiplicativeExpression();
+    e1 = m_act.onAdditiveExpression(tok, e1, e2);
+  }
+  return e1;
+}
+
+expr* descent_parser::parseMultiplicativeExpression() {
+  expr* e1 = parseCastExpression();
+  while (token tok = matchIfArithmetic(op_mul, op_div, op_mod)) {
+    expr* e2 = parseCastExpression();
+    e1 = m_act.onMultiplicativeExpression(tok, e1, e2);
+  }
+  return e1;
+}
+
+//Casts and unary operators never occur in the input.
+expr* descent_parser::parseCastExpression() {
+  if (m_tok.getName() != tok_decimal_integer) {
+    throw std::runtime_error("descent_parser: expected an integer literal");
+  }
+  return m_act.onIntegerLiteral(accept());
+}
+
+// Counts the heap allocations made by parsing and checking a program,
+// once the symbol table already holds every spelling. The nodes
+// themselves come from the arena, so what is left is mostly lists.
+int benchParseAlloc(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 10000;
+  std::unique_ptr<file> input = makeInput(makeCorpus(fns));
+
+  symbol_table syms;
+  for (int warm = 0; warm != 2; ++warm) {
+    ast_context ast;
+    std::size_t before = allocationCount();
+    std::size_t arena = ast.getCapacity();
+    parser p(syms, ast, *input);
+    p.parseProgram();
+    std::size_t allocs = allocationCount() - before;
+    std::size_t blocks = (ast.getCapacity() - arena) / (64 * 1024);
+    if (warm) {
+      std::cout << "input:       " << fns << " functions, " << input->getText().size() << " bytes\n"
+                << "allocations: " << allocs << " (" << std::setprecision(3) << double(allocs) / fns
+                << " per function)\n"
+                << "arena:       " << blocks << " blocks of 64 KiB\n";
+    }
+  }
+  return 0;
+}
+
+int benchParse(int argc, char* argv[]) {
+  std::size_t terms = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 1000000;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (terms == 0) {
+    std::cerr << "usage: mc-bench parse [terms] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeExpression(terms, 42));
+  const file& f = *input;
+
+  // Each pass gets its own parser and node context, so both engines do
+  // the same work. Folding is off: it would collapse the whole input.
+  symbol_table syms;
+  double climb = measure<std::chrono::nanoseconds>(passes, [&] {
+    ast_context ast;
+    parser p(syms, ast, f);
+    p.getSemantics().setFolding(false);
+    p.parseBinaryExpression();
+  });
+  double descent = measure<std::chrono::nanoseconds>(passes, [&] {
+    ast_context ast;
+    descent_parser p(syms, ast, f);
+    p.getSemantics().setFolding(false);
+    p.parseLogicalOrExpression();
+  });
+
+  std::cout << std::fixed << std::setprecision(2)
+            << "input:               " << terms << " operands, " << f.getText().size() << " bytes\n"
+            << "recursive descent:   " << descent / terms << " ns/operand\n"
+            << "precedence climbing: " << climb / terms << " ns/operand\n";
+  return 0;
+}
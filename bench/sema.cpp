@@ -0,0 +1,63 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/parser.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+// Parses and type-checks a function whose body is a long run of
+// assignments between a few variables. Nearly every operand is a name, so
+// the figure is dominated by identifier lookup and the types given to
+// each use.
+
+std::string makeAssignments(std::size_t stmts) {
+  std::stringstream ss;
+  ss << "def f(a : int, b : int) -> int {\n"
+     << "  var x : int = a;\n"
+     << "  var y : int = b;\n";
+  for (std::size_t i = 0; i != stmts; ++i) {
+    ss << "  x = x + a * b - y;\n"
+       << "  y = y - x + a;\n";
+  }
+  ss << "  return x;\n"
+     << "}\n";
+  return ss.str();
+}
+
+int benchSema(int argc, char* argv[]) {
+  std::size_t stmts = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 200000;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (stmts == 0) {
+    std::cerr << "usage: mc-bench sema [statements] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeAssignments(stmts));
+  const file& f = *input;
+
+  symbol_table syms;
+  std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+  std::size_t bytes = 0;
+  for (int i = 0; i != passes; ++i) {
+    ast_context ast;
+    std::uint64_t start = readCycles();
+    parser p(syms, ast, f);
+    p.parseProgram();
+    best = std::min(best, readCycles() - start);
+    bytes = ast.getCapacity();
+  }
+
+  //Two statements with eight names between them.
+  std::size_t uses = stmts * 8;
+  std::cout << std::fixed << std::setprecision(2)
+            << "input:  " << uses << " identifier uses, " << f.getText().size() << " bytes\n"
+            << "time:   " << double(best) / uses << " cycles/use\n"
+            << "nodes:  " << bytes / 1024 << " KiB\n";
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include "bench.hpp"
+
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/file.hpp"
+#include "mc-compiler/ir.hpp"
+#include "mc-compiler/parser.hpp"
+
+#ifdef MC_HAVE_CODEGEN
+#include "mc-compiler/codegen.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#endif
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+// Builds and verifies the SSA IR of a generated corpus, then, where LLVM
+// is available, compares lowering the AST to LLVM with lowering through
+// the IR: the time to an unoptimized module, its size, and the time to
+// one optimized at -O2. Parsing is not included.
+
+#ifdef MC_HAVE_CODEGEN
+static std::size_t countInstructions(const llvm::Module& mod) {
+  std::size_t n = 0;
+  for (const llvm::Function& f : mod) {
+    n += f.getInstructionCount();
+  }
+  return n;
+}
+#endif
+
+int benchSsa(int argc, char* argv[]) {
+  std::size_t fns = argc > 0 ? std::strtoul(argv[0], nullptr, 10) : 100;
+  int passes = argc > 1 ? std::atoi(argv[1]) : 5;
+  if (fns == 0) {
+    std::cerr << "usage: mc-bench ssa [functions] [passes]\n";
+    return 1;
+  }
+
+  std::unique_ptr<file> input = makeInput(makeCorpus(fns));
+  symbol_table syms;
+  ast_context ast;
+  parser p(syms, ast, *input);
+  const decl* prog = p.parseProgram();
+
+  std::size_t insns = 0;
+  std::size_t phis = 0;
+  double build = measure<std::chrono::microseconds>(passes, [&] {
+    ir_program ir(prog);
+    ir.verify();
+    insns = phis = 0;
+    for (const auto& fn : ir.getFunctions()) {
+      for (const ir_block* b : fn->getBlocks()) {
+        for (const ir_insn* i = b->first; i; i = i->next) {
+          ++insns;
+          phis += i->op == ir_phi;
+        }
+      }
+    }
+  });
+
+  std::cout << std::fixed << std::setprecision(1)
+            << "input:        " << fns << " functions\n"
+            << "ir:           " << build << " us (" << build / fns << " us per function), "
+            << insns << " instructions, " << phis << " phis\n";
+#ifdef MC_HAVE_CODEGEN
+  std::size_t ast_size = 0;
+  std::size_t ir_size = 0;
+  double ast_O0 = measure<std::chrono::microseconds>(passes, [&] {
+    llvm::LLVMContext cxt;
+    ast_size = countInstructions(*generate(cxt, prog));
+  });
+  double ir_O0 = measure<std::chrono::microseconds>(passes, [&] {
+    llvm::LLVMContext cxt;
+    ir_program ir(prog);
+    ir_size = countInstructions(*generate(cxt, ir));
+  });
+  double ast_O2 = measure<std::chrono::microseconds>(passes, [&] {
+    llvm::LLVMContext cxt;
+    std::unique_ptr<llvm::Module> mod = generate(cxt, prog);
+    optimize(*mod, opt_default);
+  });
+  double ir_O2 = measure<std::chrono::microseconds>(passes, [&] {
+    llvm::LLVMContext cxt;
+    std::unique_ptr<llvm::Module> mod = generate(cxt, ir_program(prog));
+    optimize(*mod, opt_default);
+  });
+  std::cout << "ast -> llvm:  " << ast_O0 << " us, " << ast_size << " instructions; " << ast_O2 << " us at -O2\n"
+            << "ir -> llvm:   " << ir_O0 << " us, " << ir_size << " instructions; " << ir_O2 << " us at -O2\n";
+#endif
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include "bench.hpp"
+
+#include "mc-compiler/symbol.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Interns a read-mostly workload from 1, 4, 16 and 64 threads sharing one
+// table: most lookups hit a pool of common spellings and one in sixteen
+// introduces a spelling private to its thread.
+
+static const int common_names = 4096;
+
+static std::vector<std::string> makeWorkload(int thread, std::size_t ops) {
+  std::vector<std::string> names;
+  names.reserve(ops);
+  unsigned seed = 2654435761u * (thread + 1);
+  for (std::size_t i = 0; i != ops; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    if (i % 16 == 0) {
+      names.push_back("t" + std::to_string(thread) + "_" + std::to_string(i));
+    } else {
+      names.push_back("name_" + std::to_string((seed >> 8) % common_names));
+    }
+  }
+  return names;
+}
+
+static bool runThreads(int threads, std::size_t total) {
+  std::vector<std::vector<std::string>> work;
+  for (int t = 0; t != threads; ++t) {
+    work.push_back(makeWorkload(t, total / threads));
+  }
+
+  symbol_table syms;
+  std::vector<std::vector<symbol>> seen(threads);
+  std::vector<std::thread> pool;
+
+  using namespace std::chrono;
+  steady_clock::time_point start = steady_clock::now();
+  for (int t = 0; t != threads; ++t) {
+    pool.emplace_back([&, t] {
+      std::vector<symbol>& out = seen[t];
+      out.reserve(work[t].size());
+      for (const std::string& s : work[t]) {
+        out.push_back(syms.get(s));
+      }
+    });
+  }
+  for (std::thread& th : pool) {
+    th.join();
+  }
+  double secs = duration<double>(steady_clock::now() - start).count();
+
+  //Every thread must agree on the symbol for a spelling, and ids must map
+  //back to their symbols.
+  bool ok = true;
+  for (int t = 0; t != threads; ++t) {
+    for (std::size_t i = 0; i != work[t].size(); ++i) {
+      symbol sym = seen[t][i];
+      ok &= sym == syms.get(work[t][i]) && syms[sym->id()] == sym;
+    }
+  }
+
+  std::size_t ops = (total / threads) * threads;
+  std::cout << std::setw(3) << threads << " threads: " << std::fixed << std::setprecision(2)
+            << ops / secs / 1e6 << " Mops/s, " << syms.size() << " symbols"
+            << (ok ? "" : "  INCONSISTENT") << '\n';
+  return ok;
+}
+
+int benchSymbols(int argc, char* argv[]) {
+  std::size_t total = argc > 0 ? std::strtoull(argv[0], nullptr, 10) : 4000000;
+  bool ok = true;
+  for (int threads : {1, 4, 16, 64}) {
+    ok &= runThreads(threads, total);
+  }
+  return ok ? 0 : 1;
+}
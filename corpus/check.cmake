@@ -0,0 +1,45 @@
+# Runs one corpus program under one backend:
+#
+#   cmake -DMC=<mc-compiler> -DCC=<c compiler> -DBACKEND=<backend>
+#         -DPROGRAM=<file.mc> -DWORK=<scratch dir> -P check.cmake
+#
+# The C backend's output is built with CC and run; the others run in the
+# driver.
+
+file(STRINGS ${PROGRAM} expect REGEX "^# expect: [0-9]+$" LIMIT_COUNT 1)
+string(REGEX REPLACE "^# expect: " "" expect "${expect}")
+if (expect STREQUAL "")
+  message(FATAL_ERROR "${PROGRAM} has no '# expect:' line")
+endif()
+
+if (BACKEND STREQUAL "interp")
+  set(command ${MC} --interp ${PROGRAM})
+elseif (BACKEND STREQUAL "llvm")
+  set(command ${MC} --run -O2 ${PROGRAM})
+elseif (BACKEND STREQUAL "ssa")
+  set(command ${MC} --run --ssa -O2 ${PROGRAM})
+elseif (BACKEND STREQUAL "tiered")
+  set(command ${MC} --tiered --tier-threshold=1 ${PROGRAM})
+elseif (BACKEND STREQUAL "baseline")
+  set(command ${MC} --baseline --run ${PROGRAM})
+elseif (BACKEND STREQUAL "c")
+  get_filename_component(stem ${PROGRAM} NAME_WE)
+  set(source ${WORK}/${stem}.c)
+  set(exe ${WORK}/${stem})
+  execute_process(COMMAND ${MC} --emit=c -o ${source} ${PROGRAM} RESULT_VARIABLE status)
+  if (NOT status EQUAL 0)
+    message(FATAL_ERROR "translating ${PROGRAM} to C failed: ${status}")
+  endif()
+  execute_process(COMMAND ${CC} -std=c99 -O2 -o ${exe} ${source} -lm RESULT_VARIABLE status)
+  if (NOT status EQUAL 0)
+    message(FATAL_ERROR "compiling ${source} failed: ${status}")
+  endif()
+  set(command ${exe})
+else()
+  message(FATAL_ERROR "unknown backend '${BACKEND}'")
+endif()
+
+execute_process(COMMAND ${command} RESULT_VARIABLE status)
+if (NOT status STREQUAL expect)
+  message(FATAL_ERROR "${BACKEND}: ${PROGRAM} exited with ${status}, expected ${expect}")
+endif()
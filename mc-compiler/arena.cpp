@@ -0,0 +1,50 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+#include <new>
+
+arena::arena(std::size_t block_size) :
+  m_first(nullptr),
+  m_last(nullptr),
+  m_blocks(nullptr),
+  m_block_size(block_size),
+  m_capacity(0) {}
+
+arena::~arena() {
+  while (m_blocks) {
+    block* next = m_blocks->next;
+    std::free(m_blocks);
+    m_blocks = next;
+  }
+}
+
+//Start a new block. Requests that would waste most of a regular block get
+//one of their own, and the current block stays open for small requests.
+void* arena::allocateSlow(std::size_t size, std::size_t align) {
+  std::size_t header = (sizeof(block) + align - 1) & ~(align - 1);
+  bool dedicated = size > m_block_size / 4;
+  std::size_t n = header + (dedicated ? size : m_block_size);
+  if (n < header + size) {
+    n = header + size;
+  }
+
+  block* b = static_cast<block*>(std::malloc(n));
+  if (!b) {
+    throw std::bad_alloc();
+  }
+  m_capacity += n;
+
+  char* p = reinterpret_cast<char*>(b) + header;
+  if (dedicated && m_blocks) {
+    //Keep bumping in the current block.
+    b->next = m_blocks->next;
+    m_blocks->next = b;
+    return p;
+  }
+
+  b->next = m_blocks;
+  m_blocks = b;
+  m_first = p + size;
+  m_last = reinterpret_cast<char*>(b) + n;
+  return p;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+// A bump allocator. Memory is carved out of large blocks and is only
+// released, all at once, when the arena is destroyed. Alignments up to
+// alignof(std::max_align_t) are supported.
+class arena {
+  public:
+    explicit arena(std::size_t block_size = 64 * 1024);
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+    // The number of bytes obtained from the system so far.
+    std::size_t getCapacity() const {
+      return m_capacity;
+    }
+
+  private:
+    void* allocateSlow(std::size_t size, std::size_t align);
+
+    struct block {
+      block* next;
+    };
+
+    char* m_first;
+    char* m_last;
+    block* m_blocks;
+    std::size_t m_block_size;
+    std::size_t m_capacity;
+};
+
+inline void* arena::allocate(std::size_t size, std::size_t align) {
+  std::size_t pad = -reinterpret_cast<std::size_t>(m_first) & (align - 1);
+  if (static_cast<std::size_t>(m_last - m_first) < size + pad) {
+    return allocateSlow(size, align);
+  }
+  char* p = m_first + pad;
+  m_first = p + size;
+  return p;
+}
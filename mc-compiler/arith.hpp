@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// The arithmetic of MC values, shared by everything that computes them at
+// compile time. An int is 32-bit two's complement and wraps on overflow;
+// a float is IEEE single precision. Callers diagnose division by zero
+// themselves; these functions require a nonzero divisor.
+
+inline std::int32_t addInt(std::int32_t a, std::int32_t b) {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) + static_cast<std::uint32_t>(b));
+}
+
+inline std::int32_t subInt(std::int32_t a, std::int32_t b) {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) - static_cast<std::uint32_t>(b));
+}
+
+inline std::int32_t mulInt(std::int32_t a, std::int32_t b) {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) * static_cast<std::uint32_t>(b));
+}
+
+inline std::int32_t negInt(std::int32_t a) {
+  return subInt(0, a);
+}
+
+//INT_MIN / -1 wraps to INT_MIN.
+inline std::int32_t divInt(std::int32_t a, std::int32_t b) {
+  return b == -1 ? negInt(a) : a / b;
+}
+
+//INT_MIN % -1 is 0.
+inline std::int32_t remInt(std::int32_t a, std::int32_t b) {
+  return b == -1 ? 0 : a % b;
+}
+
+//Only the low five bits of a shift count are used.
+inline std::int32_t shlInt(std::int32_t a, std::int32_t n) {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) << (n & 31));
+}
+
+//An arithmetic shift.
+inline std::int32_t shrInt(std::int32_t a, std::int32_t n) {
+  return a >> (n & 31);
+}
+
+inline float remFloat(float a, float b) {
+  return std::fmod(a, b);
+}
+
+inline float intToFloat(std::int32_t a) {
+  return static_cast<float>(a);
+}
+
+//Saturates at the ends of the int range; NaN becomes 0.
+inline std::int32_t floatToInt(float f) {
+  if (std::isnan(f)) {
+    return 0;
+  }
+  if (f >= 2147483648.0f) {
+    return INT32_MAX;
+  }
+  if (f < -2147483648.0f) {
+    return INT32_MIN;
+  }
+  return static_cast<std::int32_t>(f);
+}
@@ -1 +1,7 @@
 #include "ast.hpp"
+
+ast_context::~ast_context() {
+  for (auto i = m_finalizers.rbegin(); i != m_finalizers.rend(); ++i) {
+    i->destroy(i->node);
+  }
+}
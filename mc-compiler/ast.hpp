@@ -1,6 +1,54 @@
-#pragma ast
+#pragma once
 
-struct type;
-struct expr;
-struct stmt;
-struct decl;
+#include "arena.hpp"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class type;
+class expr;
+class stmt;
+class decl;
+
+// Owns every node of one compilation: types, expressions, statements and
+// declarations. Nodes are bump allocated and are never deleted one at a
+// time; they all go away with the context. Most nodes are trivially
+// destructible and cost nothing to release. The few that own a list are
+// remembered so their destructors can run.
+class ast_context {
+  public:
+    ast_context() = default;
+    ~ast_context();
+
+    ast_context(const ast_context&) = delete;
+    ast_context& operator=(const ast_context&) = delete;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args);
+
+    // The number of bytes obtained for nodes so far.
+    std::size_t getCapacity() const {
+      return m_mem.getCapacity();
+    }
+
+  private:
+    struct finalizer {
+      void* node;
+      void (*destroy)(void*);
+    };
+
+    arena m_mem;
+    std::vector<finalizer> m_finalizers;
+};
+
+template<typename T, typename... Args>
+inline T* ast_context::make(Args&&... args) {
+  void* mem = m_mem.allocate(sizeof(T), alignof(T));
+  T* n = new (mem) T(std::forward<Args>(args)...);
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    m_finalizers.push_back({n, [](void* p) { static_cast<T*>(p)->~T(); }});
+  }
+  return n;
+}
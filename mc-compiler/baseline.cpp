@@ -0,0 +1,1037 @@
+#include "baseline.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where an expression leaves its value: bools, chars and ints in eax,
+// with bools as 0 or 1 and chars sign-extended; floats in xmm0;
+// references and functions as addresses in rax. The second operand of a
+// binary operator goes in ecx, rcx or xmm1.
+enum value_class {
+  int_class,
+  float_class,
+  ptr_class,
+};
+
+static value_class getClass(const type* t) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+    case type::char_kind:
+    case type::int_kind:
+      return int_class;
+    case type::float_kind:
+      return float_class;
+    default:
+      return ptr_class;
+  }
+}
+
+// The type of the object a declaration names.
+static const type* getObjectType(const decl* d) {
+  return static_cast<const typed_decl*>(d)->getType();
+}
+
+// Integer and pointer arguments, in the order the System V ABI assigns
+// them. Each entry is 'pop reg'.
+static const std::initializer_list<std::uint8_t> arg_pops[] = {
+  {0x5f},       //rdi
+  {0x5e},       //rsi
+  {0x5a},       //rdx
+  {0x59},       //rcx
+  {0x41, 0x58}, //r8
+  {0x41, 0x59}, //r9
+};
+
+//The same registers as the reg field of a ModRM byte, plus REX.R.
+static const std::uint8_t arg_regs[] = {7, 6, 2, 1, 8, 9};
+
+static constexpr unsigned int_args = 6;
+static constexpr unsigned float_args = 8;
+
+class baseline_compiler {
+  public:
+    explicit baseline_compiler(const prog_decl* prog);
+
+    x86_object compile();
+
+  private:
+    void emit(std::initializer_list<std::uint8_t> bytes);
+    void emit32(std::uint32_t v);
+    std::size_t here() const;
+    void patch32(std::size_t at, std::uint32_t v);
+
+    std::size_t emitJump(std::initializer_list<std::uint8_t> op);
+    void patchJump(std::size_t field);
+    void emitJumpTo(std::initializer_list<std::uint8_t> op, std::size_t dest);
+    void emitTrapJump(std::initializer_list<std::uint8_t> op);
+
+    std::uint32_t getSymbol(const decl* d);
+    std::uint32_t getExternal(const std::string& name);
+    void emitReference(std::uint32_t sym, bool call);
+
+    void defineGlobal(const object_decl* d);
+
+    void compileFunction(const fn_decl* fn);
+    std::int32_t allocateSlot();
+    const decl* getLocal(const expr* e) const;
+
+    void push(value_class c);
+    void popSecond(value_class c);
+    void popFirst(value_class c);
+
+    void loadLocal(const type* t, std::int32_t slot);
+    void storeLocal(const type* t, std::int32_t slot);
+    void loadIndirect(const type* t);
+    void storeIndirect(const type* t);
+    void loadConstant(const const_value& v);
+
+    void compileExpr(const expr* e);
+    void compileId(const id_expr* e);
+    void compileUnary(const unop_expr* e);
+    void compileBinary(const binop_expr* e);
+    void compileLogical(const binop_expr* e);
+    void compileRelational(const binop_expr* e);
+    void compileIntBinary(binop op);
+    void compileFloatBinary(binop op);
+    void compileCall(const call_expr* e);
+    void compileAssign(const assign_expr* e);
+    void compileConditional(const cond_expr* e);
+    void compileConversion(const conv_expr* e);
+
+    void compileStmt(const stmt* s);
+    void compileDecl(const decl* d);
+
+    const prog_decl* m_prog;
+    x86_object m_obj;
+    std::unordered_map<const decl*, std::uint32_t> m_symbols;
+    std::unordered_map<std::string, std::uint32_t> m_externals;
+
+    //References to functions of this object, resolved once all of them
+    //have been placed.
+    struct fixup {
+      std::size_t field;
+      std::uint32_t symbol;
+    };
+    std::vector<fixup> m_fixups;
+
+    //The function being compiled. Slots are offsets from rbp; 'depth' is
+    //what has been pushed since the frame was set up, which decides how
+    //calls realign the stack.
+    std::unordered_map<const decl*, std::int32_t> m_slots;
+    std::int32_t m_frame;
+    std::int32_t m_frame_max;
+    std::uint32_t m_depth;
+    std::vector<std::size_t> m_traps;
+
+    struct loop {
+      std::size_t top;
+      std::vector<std::size_t> breaks;
+    };
+    std::vector<loop> m_loops;
+};
+
+baseline_compiler::baseline_compiler(const prog_decl* prog) : m_prog(prog), m_frame(0), m_frame_max(0), m_depth(0) {}
+
+void baseline_compiler::emit(std::initializer_list<std::uint8_t> bytes) {
+  m_obj.code.insert(m_obj.code.end(), bytes);
+}
+
+void baseline_compiler::emit32(std::uint32_t v) {
+  emit({std::uint8_t(v), std::uint8_t(v >> 8), std::uint8_t(v >> 16), std::uint8_t(v >> 24)});
+}
+
+std::size_t baseline_compiler::here() const {
+  return m_obj.code.size();
+}
+
+void baseline_compiler::patch32(std::size_t at, std::uint32_t v) {
+  for (int i = 0; i != 4; ++i) {
+    m_obj.code[at + i] = std::uint8_t(v >> 8 * i);
+  }
+}
+
+//A jump with a 32-bit displacement to be patched, which is returned.
+std::size_t baseline_compiler::emitJump(std::initializer_list<std::uint8_t> op) {
+  emit(op);
+  std::size_t field = here();
+  emit32(0);
+  return field;
+}
+
+void baseline_compiler::patchJump(std::size_t field) {
+  patch32(field, here() - (field + 4));
+}
+
+void baseline_compiler::emitJumpTo(std::initializer_list<std::uint8_t> op, std::size_t dest) {
+  emit(op);
+  emit32(dest - (here() + 4));
+}
+
+//Every failed check in a function shares one ud2 at its end, as
+//llvm.trap does.
+void baseline_compiler::emitTrapJump(std::initializer_list<std::uint8_t> op) {
+  m_traps.push_back(emitJump(op));
+}
+
+//Functions without a body are left to the linker, and only named once
+//something refers to them.
+std::uint32_t baseline_compiler::getSymbol(const decl* d) {
+  auto iter = m_symbols.find(d);
+  if (iter != m_symbols.end()) {
+    return iter->second;
+  }
+  std::uint32_t n = m_obj.symbols.size();
+  m_obj.symbols.push_back({std::string(d->getName()->str()), x86_symbol::undefined, true, 0, 0});
+  m_symbols.emplace(d, n);
+  return n;
+}
+
+std::uint32_t baseline_compiler::getExternal(const std::string& name) {
+  auto iter = m_externals.find(name);
+  if (iter != m_externals.end()) {
+    return iter->second;
+  }
+  std::uint32_t n = m_obj.symbols.size();
+  m_obj.symbols.push_back({name, x86_symbol::undefined, true, 0, 0});
+  m_externals.emplace(name, n);
+  return n;
+}
+
+//A rip-relative field. Functions defined here are patched directly;
+//anything else is left to whoever links the object.
+void baseline_compiler::emitReference(std::uint32_t sym, bool call) {
+  std::size_t field = here();
+  emit32(0);
+  if (m_obj.symbols[sym].sec == x86_symbol::text) {
+    m_fixups.push_back({field, sym});
+  } else {
+    m_obj.relocs.push_back({field, sym, call});
+  }
+}
+
+x86_object baseline_compiler::compile() {
+  //Functions are defined before any body refers to them; only variables
+  //need storage, since constants are always folded.
+  for (const decl* d : m_prog->getDeclarations()) {
+    if (d->getKind() == decl::fn_kind && static_cast<const fn_decl*>(d)->getBody()) {
+      m_symbols.emplace(d, m_obj.symbols.size());
+      m_obj.symbols.push_back({std::string(d->getName()->str()), x86_symbol::text, true, 0, 0});
+    } else if (d->getKind() == decl::var_kind) {
+      defineGlobal(static_cast<const object_decl*>(d));
+    }
+  }
+
+  for (const decl* d : m_prog->getDeclarations()) {
+    if (d->getKind() == decl::fn_kind && static_cast<const fn_decl*>(d)->getBody()) {
+      compileFunction(static_cast<const fn_decl*>(d));
+    }
+  }
+
+  for (const fixup& f : m_fixups) {
+    patch32(f.field, m_obj.symbols[f.symbol].offset - (f.field + 4));
+  }
+  return std::move(m_obj);
+}
+
+void baseline_compiler::defineGlobal(const object_decl* d) {
+  const const_value& v = d->getValue();
+  std::uint8_t bytes[4];
+  std::size_t size;
+  switch (getObjectType(d)->getKind()) {
+    case type::bool_kind:
+      bytes[0] = v.b;
+      size = 1;
+      break;
+    case type::char_kind:
+      bytes[0] = v.c;
+      size = 1;
+      break;
+    case type::int_kind:
+    case type::float_kind: {
+      std::uint32_t u;
+      std::memcpy(&u, &v.i, 4);
+      for (int i = 0; i != 4; ++i) {
+        bytes[i] = std::uint8_t(u >> 8 * i);
+      }
+      size = 4;
+      break;
+    }
+    default:
+      throw std::runtime_error("the baseline compiler only supports scalar globals");
+  }
+
+  std::vector<std::uint8_t>& data = m_obj.data;
+  data.resize((data.size() + size - 1) / size * size);
+  m_obj.data_align = std::max<std::uint32_t>(m_obj.data_align, size);
+  m_symbols.emplace(d, m_obj.symbols.size());
+  m_obj.symbols.push_back({std::string(d->getName()->str()), x86_symbol::data, false, data.size(), size});
+  data.insert(data.end(), bytes, bytes + size);
+}
+
+std::int32_t baseline_compiler::allocateSlot() {
+  m_frame += 8;
+  m_frame_max = std::max(m_frame_max, m_frame);
+  return -m_frame;
+}
+
+const decl* baseline_compiler::getLocal(const expr* e) const {
+  if (e->getKind() != expr::id_kind) {
+    return nullptr;
+  }
+  const decl* d = static_cast<const id_expr*>(e)->ref;
+  return m_slots.count(d) ? d : nullptr;
+}
+
+void baseline_compiler::compileFunction(const fn_decl* fn) {
+  x86_symbol& sym = m_obj.symbols[m_symbols.at(fn)];
+  sym.offset = here();
+  m_slots.clear();
+  m_frame = m_frame_max = 0;
+  m_depth = 0;
+  m_traps.clear();
+
+  //push rbp; mov rbp, rsp; sub rsp, frame
+  emit({0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec});
+  std::size_t frame = here();
+  emit32(0);
+
+  //Register arguments are spilled to slots; the rest are already in the
+  //caller's frame, above the return address.
+  unsigned ni = 0;
+  unsigned nf = 0;
+  unsigned ns = 0;
+  for (const decl* p : fn->getParameters()) {
+    value_class c = getClass(getObjectType(p));
+    if (c == float_class && nf < float_args) {
+      std::int32_t slot = allocateSlot();
+      emit({0xf3, 0x0f, 0x11, std::uint8_t(0x85 | nf++ << 3)});
+      emit32(slot);
+      m_slots.emplace(p, slot);
+    } else if (c != float_class && ni < int_args) {
+      std::int32_t slot = allocateSlot();
+      std::uint8_t r = arg_regs[ni++];
+      emit({std::uint8_t(r & 8 ? 0x4c : 0x48), 0x89, std::uint8_t(0x85 | (r & 7) << 3)});
+      emit32(slot);
+      m_slots.emplace(p, slot);
+    } else {
+      m_slots.emplace(p, 16 + 8 * ns++);
+    }
+  }
+
+  compileStmt(fn->getBody());
+
+  //Running off the end returns zero: xor eax, eax; xorps xmm0, xmm0;
+  //leave; ret
+  emit({0x31, 0xc0, 0x0f, 0x57, 0xc0, 0xc9, 0xc3});
+
+  if (!m_traps.empty()) {
+    for (std::size_t t : m_traps) {
+      patchJump(t);
+    }
+    emit({0x0f, 0x0b});
+  }
+
+  //The frame keeps rsp 16-byte aligned.
+  patch32(frame, (m_frame_max + 15) / 16 * 16);
+  sym.size = here() - sym.offset;
+}
+
+
+void baseline_compiler::push(value_class c) {
+  if (c == float_class) {
+    //sub rsp, 8; movss [rsp], xmm0
+    emit({0x48, 0x83, 0xec, 0x08, 0xf3, 0x0f, 0x11, 0x04, 0x24});
+  } else {
+    emit({0x50});
+  }
+  m_depth += 8;
+}
+
+//Pops into the second operand's register.
+void baseline_compiler::popSecond(value_class c) {
+  if (c == float_class) {
+    //movss xmm1, [rsp]; add rsp, 8
+    emit({0xf3, 0x0f, 0x10, 0x0c, 0x24, 0x48, 0x83, 0xc4, 0x08});
+  } else {
+    emit({0x59});
+  }
+  m_depth -= 8;
+}
+
+//Moves the value just computed to the second operand's register and pops
+//the one saved before it as the first.
+void baseline_compiler::popFirst(value_class c) {
+  switch (c) {
+    case int_class:
+      //mov ecx, eax; pop rax
+      emit({0x89, 0xc1, 0x58});
+      break;
+    case float_class:
+      //movaps xmm1, xmm0; movss xmm0, [rsp]; add rsp, 8
+      emit({0x0f, 0x28, 0xc8, 0xf3, 0x0f, 0x10, 0x04, 0x24, 0x48, 0x83, 0xc4, 0x08});
+      break;
+    case ptr_class:
+      //mov rcx, rax; pop rax
+      emit({0x48, 0x89, 0xc1, 0x58});
+      break;
+  }
+  m_depth -= 8;
+}
+
+//Memory holds bools and chars in a byte, as LLVM and C do.
+void baseline_compiler::loadLocal(const type* t, std::int32_t slot) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+      emit({0x0f, 0xb6, 0x85}); //movzx eax, byte [rbp + slot]
+      break;
+    case type::char_kind:
+      emit({0x0f, 0xbe, 0x85}); //movsx eax, byte [rbp + slot]
+      break;
+    case type::int_kind:
+      emit({0x8b, 0x85});       //mov eax, [rbp + slot]
+      break;
+    case type::float_kind:
+      emit({0xf3, 0x0f, 0x10, 0x85}); //movss xmm0, [rbp + slot]
+      break;
+    default:
+      emit({0x48, 0x8b, 0x85}); //mov rax, [rbp + slot]
+      break;
+  }
+  emit32(slot);
+}
+
+void baseline_compiler::storeLocal(const type* t, std::int32_t slot) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+    case type::char_kind:
+      emit({0x88, 0x85});       //mov [rbp + slot], al
+      break;
+    case type::int_kind:
+      emit({0x89, 0x85});       //mov [rbp + slot], eax
+      break;
+    case type::float_kind:
+      emit({0xf3, 0x0f, 0x11, 0x85}); //movss [rbp + slot], xmm0
+      break;
+    default:
+      emit({0x48, 0x89, 0x85}); //mov [rbp + slot], rax
+      break;
+  }
+  emit32(slot);
+}
+
+void baseline_compiler::loadIndirect(const type* t) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+      emit({0x0f, 0xb6, 0x00}); //movzx eax, byte [rax]
+      break;
+    case type::char_kind:
+      emit({0x0f, 0xbe, 0x00}); //movsx eax, byte [rax]
+      break;
+    case type::int_kind:
+      emit({0x8b, 0x00});       //mov eax, [rax]
+      break;
+    case type::float_kind:
+      emit({0xf3, 0x0f, 0x10, 0x00}); //movss xmm0, [rax]
+      break;
+    default:
+      emit({0x48, 0x8b, 0x00}); //mov rax, [rax]
+      break;
+  }
+}
+
+//Stores the second operand to where rax points.
+void baseline_compiler::storeIndirect(const type* t) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+    case type::char_kind:
+      emit({0x88, 0x08});       //mov [rax], cl
+      break;
+    case type::int_kind:
+      emit({0x89, 0x08});       //mov [rax], ecx
+      break;
+    case type::float_kind:
+      emit({0xf3, 0x0f, 0x11, 0x08}); //movss [rax], xmm1
+      break;
+    default:
+      emit({0x48, 0x89, 0x08}); //mov [rax], rcx
+      break;
+  }
+}
+
+void baseline_compiler::loadConstant(const const_value& v) {
+  std::uint32_t bits;
+  switch (v.kind) {
+    case type::bool_kind:
+      bits = v.b;
+      break;
+    case type::char_kind:
+      bits = static_cast<std::int32_t>(static_cast<signed char>(v.c));
+      break;
+    default:
+      std::memcpy(&bits, &v.i, 4);
+      break;
+  }
+  emit({0xb8}); //mov eax, imm
+  emit32(bits);
+  if (v.kind == type::float_kind) {
+    emit({0x66, 0x0f, 0x6e, 0xc0}); //movd xmm0, eax
+  }
+}
+
+
+void baseline_compiler::compileExpr(const expr* e) {
+  switch (e->getKind()) {
+    case expr::bool_kind:
+      loadConstant(const_value::makeBool(static_cast<const bool_expr*>(e)->val));
+      return;
+    case expr::int_kind:
+      loadConstant(const_value::makeInt(static_cast<const int_expr*>(e)->val));
+      return;
+    case expr::float_kind:
+      loadConstant(const_value::makeFloat(static_cast<float>(static_cast<const float_expr*>(e)->val)));
+      return;
+    case expr::id_kind:
+      return compileId(static_cast<const id_expr*>(e));
+    case expr::unop_kind:
+      return compileUnary(static_cast<const unop_expr*>(e));
+    case expr::binop_kind:
+      return compileBinary(static_cast<const binop_expr*>(e));
+    case expr::call_kind:
+      return compileCall(static_cast<const call_expr*>(e));
+    case expr::cast_kind:
+      return compileExpr(static_cast<const cast_expr*>(e)->m_src);
+    case expr::assign_kind:
+      return compileAssign(static_cast<const assign_expr*>(e));
+    case expr::cond_kind:
+      return compileConditional(static_cast<const cond_expr*>(e));
+    case expr::conv_kind:
+      return compileConversion(static_cast<const conv_expr*>(e));
+    default:
+      throw std::runtime_error("not supported by the baseline compiler");
+  }
+}
+
+//Objects give their address; constants and functions their value.
+void baseline_compiler::compileId(const id_expr* e) {
+  const decl* d = e->ref;
+  switch (d->getKind()) {
+    case decl::const_kind:
+    case decl::value_kind: {
+      const object_decl* obj = static_cast<const object_decl*>(d);
+      if (obj->hasValue()) {
+        return loadConstant(obj->getValue());
+      }
+      return loadLocal(getObjectType(d), m_slots.at(d));
+    }
+    case decl::var_kind:
+    case decl::parm_kind: {
+      auto iter = m_slots.find(d);
+      if (iter != m_slots.end()) {
+        emit({0x48, 0x8d, 0x85}); //lea rax, [rbp + slot]
+        emit32(iter->second);
+      } else {
+        emit({0x48, 0x8d, 0x05}); //lea rax, [rip + var]
+        emitReference(getSymbol(d), false);
+      }
+      return;
+    }
+    case decl::fn_kind:
+      emit({0x48, 0x8d, 0x05}); //lea rax, [rip + fn]
+      emitReference(getSymbol(d), false);
+      return;
+    default:
+      throw std::logic_error("not a valid id expression");
+  }
+}
+
+void baseline_compiler::compileUnary(const unop_expr* e) {
+  compileExpr(e->m_arg);
+  switch (e->m_op) {
+    case uo_pos:
+      return;
+    case uo_neg:
+      if (getClass(e->m_arg->getType()) == float_class) {
+        //movd eax, xmm0; xor eax, 0x80000000; movd xmm0, eax
+        emit({0x66, 0x0f, 0x7e, 0xc0, 0x35, 0x00, 0x00, 0x00, 0x80, 0x66, 0x0f, 0x6e, 0xc0});
+      } else {
+        emit({0xf7, 0xd8}); //neg eax
+      }
+      return;
+    case uo_cmp:
+      emit({0xf7, 0xd0}); //not eax
+      return;
+    case uo_not:
+      emit({0x83, 0xf0, 0x01}); //xor eax, 1
+      return;
+    default:
+      throw std::runtime_error("not supported by the baseline compiler");
+  }
+}
+
+void baseline_compiler::compileBinary(const binop_expr* e) {
+  switch (e->m_op) {
+    case bo_land:
+    case bo_lor:
+      return compileLogical(e);
+    case bo_eq:
+    case bo_ne:
+    case bo_lt:
+    case bo_gt:
+    case bo_le:
+    case bo_ge:
+      return compileRelational(e);
+    default:
+      break;
+  }
+
+  value_class c = getClass(e->m_lhs->getType());
+  compileExpr(e->m_lhs);
+  push(c);
+  compileExpr(e->m_rhs);
+  popFirst(c);
+  if (c == float_class) {
+    compileFloatBinary(e->m_op);
+  } else {
+    compileIntBinary(e->m_op);
+  }
+}
+
+//eax op= ecx. Shifts use only the low five bits of cl, as MC does.
+void baseline_compiler::compileIntBinary(binop op) {
+  switch (op) {
+    case bo_add:
+      return emit({0x01, 0xc8});
+    case bo_sub:
+      return emit({0x29, 0xc8});
+    case bo_mul:
+      return emit({0x0f, 0xaf, 0xc1});
+    case bo_and:
+      return emit({0x21, 0xc8});
+    case bo_ior:
+      return emit({0x09, 0xc8});
+    case bo_xor:
+      return emit({0x31, 0xc8});
+    case bo_shl:
+      return emit({0xd3, 0xe0});
+    case bo_shr:
+      return emit({0xd3, 0xf8});
+
+    //idiv faults on INT_MIN / -1, so a divisor of -1 negates instead:
+    //  test ecx, ecx; jz trap; cmp ecx, -1; jne 1f
+    //  neg eax (xor eax, eax for %); jmp 2f
+    //  1: cdq; idiv ecx (mov eax, edx for %)
+    //  2:
+    case bo_quo:
+      emit({0x85, 0xc9});
+      emitTrapJump({0x0f, 0x84});
+      return emit({0x83, 0xf9, 0xff, 0x75, 0x04, 0xf7, 0xd8, 0xeb, 0x03, 0x99, 0xf7, 0xf9});
+    case bo_rem:
+      emit({0x85, 0xc9});
+      emitTrapJump({0x0f, 0x84});
+      return emit({0x83, 0xf9, 0xff, 0x75, 0x04, 0x31, 0xc0, 0xeb, 0x05, 0x99, 0xf7, 0xf9, 0x89, 0xd0});
+    default:
+      throw std::logic_error("not an int operation");
+  }
+}
+
+//xmm0 op= xmm1. The remainder is fmodf's, as LLVM's frem.
+void baseline_compiler::compileFloatBinary(binop op) {
+  switch (op) {
+    case bo_add:
+      return emit({0xf3, 0x0f, 0x58, 0xc1});
+    case bo_sub:
+      return emit({0xf3, 0x0f, 0x5c, 0xc1});
+    case bo_mul:
+      return emit({0xf3, 0x0f, 0x59, 0xc1});
+    case bo_quo:
+      return emit({0xf3, 0x0f, 0x5e, 0xc1});
+    case bo_rem: {
+      bool pad = m_depth % 16 != 0;
+      if (pad) {
+        emit({0x48, 0x83, 0xec, 0x08}); //sub rsp, 8
+      }
+      emit({0xe8});
+      emitReference(getExternal("fmodf"), true);
+      if (pad) {
+        emit({0x48, 0x83, 0xc4, 0x08}); //add rsp, 8
+      }
+      return;
+    }
+    default:
+      throw std::logic_error("not a float operation");
+  }
+}
+
+//Both operands are 0 or 1, so the one that decides is the result.
+void baseline_compiler::compileLogical(const binop_expr* e) {
+  compileExpr(e->m_lhs);
+  emit({0x85, 0xc0}); //test eax, eax
+  std::size_t end = emitJump(e->m_op == bo_land ? std::initializer_list<std::uint8_t>{0x0f, 0x84} : std::initializer_list<std::uint8_t>{0x0f, 0x85});
+  compileExpr(e->m_rhs);
+  patchJump(end);
+}
+
+//Chars and ints compare signed, bools and functions unsigned. Float
+//comparisons are false when either side is NaN, except for !=.
+void baseline_compiler::compileRelational(const binop_expr* e) {
+  const type* t = e->m_lhs->getType();
+  value_class c = getClass(t);
+  compileExpr(e->m_lhs);
+  push(c);
+  compileExpr(e->m_rhs);
+  popFirst(c);
+
+  std::size_t n = e->m_op - bo_eq;
+  if (c == float_class) {
+    //ucomiss with the operands ordered so that only 'above' is needed.
+    static const std::uint8_t ops[][9] = {
+      {0x0f, 0x2e, 0xc1, 0x0f, 0x94, 0xc0, 0x0f, 0x9b, 0xc1}, //sete al; setnp cl
+      {0x0f, 0x2e, 0xc1, 0x0f, 0x95, 0xc0, 0x0f, 0x9a, 0xc1}, //setne al; setp cl
+      {0x0f, 0x2e, 0xc8, 0x0f, 0x97, 0xc0},                   //ucomiss xmm1, xmm0; seta
+      {0x0f, 0x2e, 0xc1, 0x0f, 0x97, 0xc0},                   //seta
+      {0x0f, 0x2e, 0xc8, 0x0f, 0x93, 0xc0},                   //ucomiss xmm1, xmm0; setae
+      {0x0f, 0x2e, 0xc1, 0x0f, 0x93, 0xc0},                   //setae
+    };
+    const std::uint8_t* op = ops[n];
+    m_obj.code.insert(m_obj.code.end(), op, op + (n < 2 ? 9 : 6));
+    if (e->m_op == bo_eq) {
+      emit({0x20, 0xc8}); //and al, cl
+    } else if (e->m_op == bo_ne) {
+      emit({0x08, 0xc8}); //or al, cl
+    }
+  } else {
+    static const std::uint8_t signed_cc[] = {0x94, 0x95, 0x9c, 0x9f, 0x9e, 0x9d};
+    static const std::uint8_t unsigned_cc[] = {0x94, 0x95, 0x92, 0x97, 0x96, 0x93};
+    bool is_signed = t->getKind() == type::char_kind || t->getKind() == type::int_kind;
+    if (c == ptr_class) {
+      emit({0x48});
+    }
+    emit({0x39, 0xc8}); //cmp eax, ecx
+    emit({0x0f, is_signed ? signed_cc[n] : unsigned_cc[n], 0xc0});
+  }
+  emit({0x0f, 0xb6, 0xc0}); //movzx eax, al
+}
+
+//Arguments are evaluated left to right. Those passed in registers are
+//pushed and popped into place once all are known; those passed on the
+//stack go straight into the area reserved below them. The callee, when
+//it is not named directly, is evaluated first and saved above that area.
+void baseline_compiler::compileCall(const call_expr* e) {
+  const decl* callee = nullptr;
+  if (e->m_base->getKind() == expr::id_kind) {
+    const decl* d = static_cast<const id_expr*>(e->m_base)->ref;
+    if (d->getKind() == decl::fn_kind) {
+      callee = d;
+    }
+  }
+  if (!callee) {
+    compileExpr(e->m_base);
+    push(ptr_class);
+  }
+
+  std::size_t n = e->m_args.size();
+  std::vector<int> regs(n);
+  unsigned ni = 0;
+  unsigned nf = 0;
+  unsigned ns = 0;
+  for (std::size_t i = 0; i != n; ++i) {
+    if (getClass(e->m_args[i]->getType()) == float_class) {
+      regs[i] = nf < float_args ? int(nf++) : -1;
+    } else {
+      regs[i] = ni < int_args ? int(ni++) : -1;
+    }
+    ns += regs[i] < 0;
+  }
+
+  std::uint32_t reserve = 8 * ns;
+  if ((m_depth + reserve) % 16) {
+    reserve += 8;
+  }
+  if (reserve) {
+    emit({0x48, 0x81, 0xec}); //sub rsp, reserve
+    emit32(reserve);
+    m_depth += reserve;
+  }
+
+  std::uint32_t pushed = 0;
+  std::uint32_t stack_arg = 0;
+  for (std::size_t i = 0; i != n; ++i) {
+    value_class c = getClass(e->m_args[i]->getType());
+    compileExpr(e->m_args[i]);
+    if (regs[i] >= 0) {
+      push(c);
+      pushed += 8;
+      continue;
+    }
+    if (c == float_class) {
+      emit({0xf3, 0x0f, 0x11, 0x84, 0x24}); //movss [rsp + off], xmm0
+    } else {
+      emit({0x48, 0x89, 0x84, 0x24}); //mov [rsp + off], rax
+    }
+    emit32(pushed + 8 * stack_arg++);
+  }
+
+  for (std::size_t i = n; i-- != 0;) {
+    if (regs[i] < 0) {
+      continue;
+    }
+    if (getClass(e->m_args[i]->getType()) == float_class) {
+      //movss xmmN, [rsp]; add rsp, 8
+      emit({0xf3, 0x0f, 0x10, std::uint8_t(0x04 | regs[i] << 3), 0x24, 0x48, 0x83, 0xc4, 0x08});
+    } else {
+      emit(arg_pops[regs[i]]);
+    }
+    m_depth -= 8;
+  }
+
+  if (callee) {
+    emit({0xe8});
+    emitReference(getSymbol(callee), true);
+  } else {
+    emit({0x4c, 0x8b, 0x9c, 0x24}); //mov r11, [rsp + reserve]
+    emit32(reserve);
+    emit({0x41, 0xff, 0xd3});       //call r11
+    reserve += 8;
+  }
+  if (reserve) {
+    emit({0x48, 0x81, 0xc4}); //add rsp, reserve
+    emit32(reserve);
+    m_depth -= reserve;
+  }
+
+  //Only the low byte of a bool or char result is defined.
+  switch (e->getType()->getKind()) {
+    case type::bool_kind:
+      emit({0x0f, 0xb6, 0xc0}); //movzx eax, al
+      break;
+    case type::char_kind:
+      emit({0x0f, 0xbe, 0xc0}); //movsx eax, al
+      break;
+    default:
+      break;
+  }
+}
+
+//The value is computed before the object it is stored to. The result is
+//the object's address.
+void baseline_compiler::compileAssign(const assign_expr* e) {
+  const type* t = e->m_rhs->getType();
+  compileExpr(e->m_rhs);
+  if (const decl* d = getLocal(e->m_lhs)) {
+    std::int32_t slot = m_slots.at(d);
+    storeLocal(t, slot);
+    emit({0x48, 0x8d, 0x85}); //lea rax, [rbp + slot]
+    emit32(slot);
+    return;
+  }
+  value_class c = getClass(t);
+  push(c);
+  compileExpr(e->m_lhs);
+  popSecond(c);
+  storeIndirect(t);
+}
+
+void baseline_compiler::compileConditional(const cond_expr* e) {
+  compileExpr(e->m_cond);
+  emit({0x85, 0xc0}); //test eax, eax
+  std::size_t to_false = emitJump({0x0f, 0x84});
+  compileExpr(e->m_true);
+  std::size_t to_end = emitJump({0xe9});
+  patchJump(to_false);
+  compileExpr(e->m_false);
+  patchJump(to_end);
+}
+
+void baseline_compiler::compileConversion(const conv_expr* e) {
+  if (e->m_conv == conv_value) {
+    if (const decl* d = getLocal(e->m_src)) {
+      return loadLocal(e->getType(), m_slots.at(d));
+    }
+    compileExpr(e->m_src);
+    return loadIndirect(e->getType());
+  }
+
+  compileExpr(e->m_src);
+  switch (e->m_conv) {
+    case conv_identity:
+    case conv_int:
+      return;
+    case conv_bool:
+      switch (getClass(e->m_src->getType())) {
+        case float_class:
+          //xorps xmm1, xmm1; ucomiss xmm0, xmm1; setne al; setp cl; or al, cl
+          emit({0x0f, 0x57, 0xc9, 0x0f, 0x2e, 0xc1, 0x0f, 0x95, 0xc0, 0x0f, 0x9a, 0xc1, 0x08, 0xc8});
+          break;
+        case ptr_class:
+          emit({0x48, 0x85, 0xc0, 0x0f, 0x95, 0xc0}); //test rax, rax; setne al
+          break;
+        case int_class:
+          emit({0x85, 0xc0, 0x0f, 0x95, 0xc0});       //test eax, eax; setne al
+          break;
+      }
+      return emit({0x0f, 0xb6, 0xc0}); //movzx eax, al
+    case conv_char:
+      return emit({0x0f, 0xbe, 0xc0}); //movsx eax, al
+    case conv_ext:
+      return emit({0xf3, 0x0f, 0x2a, 0xc0}); //cvtsi2ss xmm0, eax
+
+    //cvttss2si gives INT_MIN for NaN and anything out of range, so that
+    //result is checked:
+    //  cvttss2si eax, xmm0; cmp eax, INT_MIN; jne 2f
+    //  ucomiss xmm0, xmm0; jp 1f
+    //  xorps xmm1, xmm1; ucomiss xmm0, xmm1; jb 2f
+    //  mov eax, INT_MAX; jmp 2f
+    //  1: xor eax, eax
+    //  2:
+    case conv_trunc:
+      return emit({0xf3, 0x0f, 0x2c, 0xc0, 0x3d, 0x00, 0x00, 0x00, 0x80, 0x75, 0x16,
+                   0x0f, 0x2e, 0xc0, 0x7a, 0x0f,
+                   0x0f, 0x57, 0xc9, 0x0f, 0x2e, 0xc1, 0x72, 0x09,
+                   0xb8, 0xff, 0xff, 0xff, 0x7f, 0xeb, 0x02,
+                   0x31, 0xc0});
+    default:
+      throw std::logic_error("not a valid conversion");
+  }
+}
+
+
+void baseline_compiler::compileStmt(const stmt* s) {
+  switch (s->getKind()) {
+    case stmt::block_kind: {
+      //Slots of a block are reused once it ends.
+      std::int32_t frame = m_frame;
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        compileStmt(s1);
+      }
+      m_frame = frame;
+      return;
+    }
+
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      compileExpr(w->getCondition());
+      emit({0x85, 0xc0});
+      std::size_t skip = emitJump({0x0f, 0x84});
+      compileStmt(w->getBody());
+      patchJump(skip);
+      return;
+    }
+
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      compileExpr(i->getCondition());
+      emit({0x85, 0xc0});
+      std::size_t to_false = emitJump({0x0f, 0x84});
+      compileStmt(i->getTrueBranch());
+      if (i->getFalseBranch()) {
+        std::size_t to_end = emitJump({0xe9});
+        patchJump(to_false);
+        compileStmt(i->getFalseBranch());
+        patchJump(to_end);
+      } else {
+        patchJump(to_false);
+      }
+      return;
+    }
+
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      std::size_t top = here();
+      compileExpr(w->getCondition());
+      emit({0x85, 0xc0});
+      std::size_t exit = emitJump({0x0f, 0x84});
+      m_loops.push_back({top, {}});
+      compileStmt(w->getBody());
+      emitJumpTo({0xe9}, top);
+      patchJump(exit);
+      for (std::size_t b : m_loops.back().breaks) {
+        patchJump(b);
+      }
+      m_loops.pop_back();
+      return;
+    }
+
+    case stmt::break_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("break outside of a loop");
+      }
+      m_loops.back().breaks.push_back(emitJump({0xe9}));
+      return;
+
+    case stmt::cont_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("continue outside of a loop");
+      }
+      emitJumpTo({0xe9}, m_loops.back().top);
+      return;
+
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      if (e) {
+        compileExpr(e);
+      }
+      emit({0xc9, 0xc3}); //leave; ret
+      return;
+    }
+
+    case stmt::decl_kind:
+      return compileDecl(static_cast<const decl_stmt*>(s)->m_decl);
+
+    case stmt::expr_kind:
+      return compileExpr(static_cast<const expr_stmt*>(s)->m_expr);
+  }
+}
+
+//Constants with a compile-time value need no slot.
+void baseline_compiler::compileDecl(const decl* d) {
+  const object_decl* obj = static_cast<const object_decl*>(d);
+  if (d->getKind() != decl::var_kind && obj->hasValue()) {
+    return;
+  }
+  std::int32_t slot = allocateSlot();
+  if (obj->getInit()) {
+    compileExpr(obj->getInit());
+    storeLocal(getObjectType(d), slot);
+  } else {
+    emit({0x48, 0xc7, 0x85}); //mov qword [rbp + slot], 0
+    emit32(slot);
+    emit32(0);
+  }
+  m_slots[d] = slot;
+}
+
+
+x86_object generateBaseline(const decl* prog) {
+  baseline_compiler c(static_cast<const prog_decl*>(prog));
+  return c.compile();
+}
+
+int runBaseline(const decl* d) {
+  const prog_decl* prog = static_cast<const prog_decl*>(d);
+  const fn_decl* main = nullptr;
+  for (const decl* d1 : prog->getDeclarations()) {
+    if (d1->getKind() == decl::fn_kind && d1->getName()->str() == "main") {
+      main = static_cast<const fn_decl*>(d1);
+    }
+  }
+  if (!main || !main->getBody()) {
+    throw std::runtime_error("the program has no main function");
+  }
+  if (!main->getParameters().empty() || main->getReturnType()->getKind() != type::int_kind) {
+    throw std::runtime_error("main must take no arguments and return int");
+  }
+
+  x86_image image(generateBaseline(prog));
+  auto fn = reinterpret_cast<int (*)()>(image.getSymbol("main"));
+  return fn();
+}
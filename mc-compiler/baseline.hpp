@@ -0,0 +1,17 @@
+#pragma once
+
+#include "x86.hpp"
+
+class decl;
+
+// Compiles 'prog' to x86-64 machine code in a single pass over the AST,
+// without LLVM. Every local lives in a stack slot and every expression
+// leaves its value in eax, rax or xmm0, so each construct is a fixed
+// instruction template with its displacements and immediates patched in.
+// Nothing is optimized: this is a much faster -O0 for edit-compile-run
+// loops. Calls follow the System V ABI, so the code links with C.
+x86_object generateBaseline(const decl* prog);
+
+// Compiles 'prog' with generateBaseline, loads it into this process and
+// returns what 'def main() -> int' returns.
+int runBaseline(const decl* prog);
@@ -0,0 +1,849 @@
+#include "bytecode.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+const char* toString(bc_op op) {
+  static const char* const names[] = {
+#define MC_BYTECODE_NAME(name) #name,
+    MC_BYTECODE_OPS(MC_BYTECODE_NAME)
+#undef MC_BYTECODE_NAME
+  };
+  return names[op];
+}
+
+// Where an object lives: a register of the frame, a global, or, when it
+// depends on run-time values, wherever the reference in a register points.
+struct bc_place {
+  enum kind {
+    reg_kind,
+    global_kind,
+    ref_kind,
+  };
+
+  kind k;
+  std::uint32_t index;
+};
+
+// Compiles one function. Registers are handed out like a stack: the
+// parameters come first, then each local as it is declared, then the
+// temporaries of the statement being compiled. A block releases its
+// locals when it ends and a statement its temporaries.
+//
+// Reading a local needs no instruction; its register is used directly.
+// An expression compiled into a requested register only writes it with
+// its last instruction, so the register can be one of its own operands.
+class bc_compiler {
+  public:
+    bc_compiler(bc_program& prog, const fn_decl* fn);
+
+    bc_function compile();
+
+  private:
+    using reg = std::uint16_t;
+
+    //No register requested.
+    static constexpr int any = -1;
+
+    reg allocate();
+    reg target(int want);
+    void release(std::uint32_t mark);
+
+    std::size_t emit(bc_insn i);
+    std::size_t emitJump(bc_op op, reg a = 0);
+    void patch(std::size_t jump);
+    void emitJumpTo(bc_op op, std::size_t dest, reg a = 0);
+
+    reg compileExpr(const expr* e, int want = any);
+    reg compileBinary(const binop_expr* e, int want);
+    reg compileLogical(const binop_expr* e, int want);
+    reg compileUnary(const unop_expr* e, int want);
+    reg compileConversion(const conv_expr* e, int want);
+    reg compileConditional(const cond_expr* e, int want);
+    reg compileCall(const call_expr* e, int want);
+    reg compileId(const id_expr* e, int want);
+    reg compileLoad(bc_place p, const type* t, int want);
+    reg compileMove(reg r, int want);
+
+    bc_place compilePlace(const expr* e);
+    void compileStore(bc_place p, reg r);
+    reg compileAddress(bc_place p);
+
+    void compileStmt(const stmt* s);
+    void compileDecl(const decl* d);
+
+    bc_program& m_prog;
+    const fn_decl* m_fn;
+    bc_function m_out;
+
+    std::unordered_map<const decl*, reg> m_slots;
+    std::uint32_t m_top;
+
+    //The loop being compiled: where continue goes, and the breaks to
+    //patch when it ends.
+    struct loop {
+      std::size_t cont;
+      std::vector<std::size_t> breaks;
+    };
+    std::vector<loop> m_loops;
+};
+
+//Whether evaluating 'e' can change a local. Only assignments can; a call
+//has no access to the caller's registers.
+static bool hasAssignment(const expr* e) {
+  switch (e->getKind()) {
+    case expr::assign_kind:
+      return true;
+    case expr::unop_kind:
+      return hasAssignment(static_cast<const unop_expr*>(e)->m_arg);
+    case expr::binop_kind: {
+      const binop_expr* b = static_cast<const binop_expr*>(e);
+      return hasAssignment(b->m_lhs) || hasAssignment(b->m_rhs);
+    }
+    case expr::call_kind:
+    case expr::index_kind: {
+      const postfix_expr* p = static_cast<const postfix_expr*>(e);
+      if (hasAssignment(p->m_base)) {
+        return true;
+      }
+      for (const expr* a : p->m_args) {
+        if (hasAssignment(a)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case expr::cast_kind:
+      return hasAssignment(static_cast<const cast_expr*>(e)->m_src);
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      return hasAssignment(c->m_cond) || hasAssignment(c->m_true) || hasAssignment(c->m_false);
+    }
+    case expr::conv_kind:
+      return hasAssignment(static_cast<const conv_expr*>(e)->m_src);
+    default:
+      return false;
+  }
+}
+
+static bool isFloat(const expr* e) {
+  return e->getType()->getKind() == type::float_kind;
+}
+
+static std::int32_t getImmediate(const const_value& v) {
+  switch (v.kind) {
+    case type::bool_kind:
+      return v.b;
+    case type::char_kind:
+      return static_cast<signed char>(v.c);
+    case type::float_kind: {
+      bc_value x;
+      x.f = v.f;
+      return x.i;
+    }
+    default:
+      return v.i;
+  }
+}
+
+bc_compiler::bc_compiler(bc_program& prog, const fn_decl* fn) : m_prog(prog), m_fn(fn), m_top(0) {
+  m_out.decl = fn;
+  m_out.name = fn->getName();
+  m_out.params = fn->getParameters().size();
+  m_out.frame_size = 0;
+}
+
+bc_function bc_compiler::compile() {
+  //Parameters arrive in the first registers.
+  for (const decl* p : m_fn->getParameters()) {
+    m_slots[p] = allocate();
+  }
+  compileStmt(m_fn->getBody());
+
+  //A function that runs off its end returns zero.
+  reg r = allocate();
+  emit(bc_insn::makeImmediate(bc_ldi, r, 0));
+  emit(bc_insn(bc_ret, r, 0, 0));
+
+  //A call's result lands in the callee's first register.
+  if (m_out.frame_size == 0) {
+    m_out.frame_size = 1;
+  }
+  return std::move(m_out);
+}
+
+bc_compiler::reg bc_compiler::allocate() {
+  if (m_top > std::numeric_limits<reg>::max()) {
+    std::stringstream ss;
+    ss << "'" << *m_fn->getName() << "' needs too many registers";
+    throw std::runtime_error(ss.str());
+  }
+  reg r = m_top++;
+  if (m_top > m_out.frame_size) {
+    m_out.frame_size = m_top;
+  }
+  return r;
+}
+
+bc_compiler::reg bc_compiler::target(int want) {
+  return want == any ? allocate() : static_cast<reg>(want);
+}
+
+void bc_compiler::release(std::uint32_t mark) {
+  m_top = mark;
+}
+
+std::size_t bc_compiler::emit(bc_insn i) {
+  m_out.code.push_back(i);
+  return m_out.code.size() - 1;
+}
+
+//A forward jump, patched once its destination is known.
+std::size_t bc_compiler::emitJump(bc_op op, reg a) {
+  return emit(bc_insn::makeImmediate(op, a, 0));
+}
+
+void bc_compiler::patch(std::size_t jump) {
+  m_out.code[jump].bc = static_cast<std::uint32_t>(m_out.code.size() - (jump + 1));
+}
+
+void bc_compiler::emitJumpTo(bc_op op, std::size_t dest, reg a) {
+  std::int32_t off = static_cast<std::int32_t>(dest) - static_cast<std::int32_t>(m_out.code.size() + 1);
+  emit(bc_insn::makeImmediate(op, a, off));
+}
+
+
+bc_compiler::reg bc_compiler::compileExpr(const expr* e, int want) {
+  if (e->getType()->isReference()) {
+    return compileMove(compileAddress(compilePlace(e)), want);
+  }
+
+  switch (e->getKind()) {
+    case expr::bool_kind: {
+      reg r = target(want);
+      emit(bc_insn::makeImmediate(bc_ldi, r, static_cast<const bool_expr*>(e)->val));
+      return r;
+    }
+    case expr::int_kind: {
+      reg r = target(want);
+      emit(bc_insn::makeImmediate(bc_ldi, r, static_cast<const int_expr*>(e)->val));
+      return r;
+    }
+    case expr::float_kind: {
+      reg r = target(want);
+      bc_value v;
+      v.f = static_cast<float>(static_cast<const float_expr*>(e)->val);
+      emit(bc_insn::makeImmediate(bc_ldi, r, v.i));
+      return r;
+    }
+    case expr::id_kind:
+      return compileId(static_cast<const id_expr*>(e), want);
+    case expr::unop_kind:
+      return compileUnary(static_cast<const unop_expr*>(e), want);
+    case expr::binop_kind:
+      return compileBinary(static_cast<const binop_expr*>(e), want);
+    case expr::call_kind:
+      return compileCall(static_cast<const call_expr*>(e), want);
+    case expr::cast_kind:
+      //The operand was already converted to the target type.
+      return compileExpr(static_cast<const cast_expr*>(e)->m_src, want);
+    case expr::cond_kind:
+      return compileConditional(static_cast<const cond_expr*>(e), want);
+    case expr::conv_kind:
+      return compileConversion(static_cast<const conv_expr*>(e), want);
+    default:
+      throw std::runtime_error("not supported by the interpreter");
+  }
+}
+
+//Names of objects have reference type and go through compilePlace. What
+//is left are constants and functions.
+bc_compiler::reg bc_compiler::compileId(const id_expr* e, int want) {
+  const decl* d = e->ref;
+  switch (d->getKind()) {
+    case decl::const_kind:
+    case decl::value_kind: {
+      const object_decl* obj = static_cast<const object_decl*>(d);
+      if (obj->hasValue()) {
+        reg r = target(want);
+        emit(bc_insn::makeImmediate(bc_ldi, r, getImmediate(obj->getValue())));
+        return r;
+      }
+      return compileMove(m_slots.at(d), want);
+    }
+    case decl::fn_kind: {
+      reg r = target(want);
+      emit(bc_insn::makeImmediate(bc_ldi, r, m_prog.m_fn_ids.at(d)));
+      return r;
+    }
+    default:
+      throw std::logic_error("not a value");
+  }
+}
+
+bc_compiler::reg bc_compiler::compileMove(reg r, int want) {
+  if (want != any && want != r) {
+    emit(bc_insn(bc_mov, static_cast<reg>(want), r, 0));
+    return static_cast<reg>(want);
+  }
+  return r;
+}
+
+static bc_op getIntOp(binop op) {
+  static const bc_op ops[] = {
+    bc_add, bc_sub, bc_mul, bc_div, bc_rem,
+    bc_band, bc_bor, bc_bxor, bc_shl, bc_shr,
+    bc_jmp, bc_jmp, //The logical operators have no instruction.
+    bc_eq, bc_ne, bc_lt, bc_gt, bc_le, bc_ge,
+  };
+  return ops[op];
+}
+
+static bc_op getFloatOp(binop op) {
+  switch (op) {
+    case bo_add:
+      return bc_fadd;
+    case bo_sub:
+      return bc_fsub;
+    case bo_mul:
+      return bc_fmul;
+    case bo_quo:
+      return bc_fdiv;
+    case bo_rem:
+      return bc_frem;
+    case bo_eq:
+      return bc_feq;
+    case bo_ne:
+      return bc_fne;
+    case bo_lt:
+      return bc_flt;
+    case bo_gt:
+      return bc_fgt;
+    case bo_le:
+      return bc_fle;
+    case bo_ge:
+      return bc_fge;
+    default:
+      throw std::logic_error("not a float operation");
+  }
+}
+
+bc_compiler::reg bc_compiler::compileBinary(const binop_expr* e, int want) {
+  if (e->m_op == bo_land || e->m_op == bo_lor) {
+    return compileLogical(e, want);
+  }
+
+  std::uint32_t mark = m_top;
+  reg l = compileExpr(e->m_lhs);
+  //The right operand could change a local the left one is still reading.
+  if (l < mark && hasAssignment(e->m_rhs)) {
+    l = compileMove(l, allocate());
+  }
+  reg r = compileExpr(e->m_rhs);
+  release(mark);
+
+  bc_op op = isFloat(e->m_lhs) ? getFloatOp(e->m_op) : getIntOp(e->m_op);
+  reg t = target(want);
+  emit(bc_insn(op, t, l, r));
+  return t;
+}
+
+//Short-circuits, so the result is built in a fresh register and only then
+//moved to the one requested.
+bc_compiler::reg bc_compiler::compileLogical(const binop_expr* e, int want) {
+  std::uint32_t mark = m_top;
+  reg t = allocate();
+  compileExpr(e->m_lhs, t);
+  std::size_t skip = emitJump(e->m_op == bo_land ? bc_jf : bc_jt, t);
+  compileExpr(e->m_rhs, t);
+  patch(skip);
+  if (want == any) {
+    release(t + 1);
+    return t;
+  }
+  release(mark);
+  return compileMove(t, want);
+}
+
+bc_compiler::reg bc_compiler::compileUnary(const unop_expr* e, int want) {
+  if (e->m_op == uo_pos) {
+    return compileExpr(e->m_arg, want);
+  }
+
+  std::uint32_t mark = m_top;
+  reg a = compileExpr(e->m_arg);
+  release(mark);
+
+  bc_op op;
+  switch (e->m_op) {
+    case uo_neg:
+      op = isFloat(e->m_arg) ? bc_fneg : bc_neg;
+      break;
+    case uo_cmp:
+      op = bc_bnot;
+      break;
+    case uo_not:
+      op = bc_lnot;
+      break;
+    default:
+      throw std::runtime_error("not supported by the interpreter");
+  }
+  reg t = target(want);
+  emit(bc_insn(op, t, a, 0));
+  return t;
+}
+
+//Bools and chars are already stored as ints, so widening them is free.
+bc_compiler::reg bc_compiler::compileConversion(const conv_expr* e, int want) {
+  bc_op op;
+  switch (e->m_conv) {
+    case conv_identity:
+      return compileExpr(e->m_src, want);
+    case conv_value:
+      return compileLoad(compilePlace(e->m_src), e->getType(), want);
+    case conv_int:
+      return compileExpr(e->m_src, want);
+    case conv_bool:
+      switch (e->m_src->getType()->getKind()) {
+        case type::float_kind:
+          op = bc_ftob;
+          break;
+        case type::fn_kind: {
+          //A function is never null.
+          std::uint32_t mark = m_top;
+          compileExpr(e->m_src);
+          release(mark);
+          reg t = target(want);
+          emit(bc_insn::makeImmediate(bc_ldi, t, 1));
+          return t;
+        }
+        default:
+          op = bc_itob;
+          break;
+      }
+      break;
+    case conv_char:
+      op = bc_itoc;
+      break;
+    case conv_ext:
+      op = bc_itof;
+      break;
+    case conv_trunc:
+      op = bc_ftoi;
+      break;
+    default:
+      throw std::logic_error("not a valid conversion");
+  }
+
+  std::uint32_t mark = m_top;
+  reg a = compileExpr(e->m_src);
+  release(mark);
+  reg t = target(want);
+  emit(bc_insn(op, t, a, 0));
+  return t;
+}
+
+bc_compiler::reg bc_compiler::compileConditional(const cond_expr* e, int want) {
+  std::uint32_t mark = m_top;
+  reg t = allocate();
+  reg c = compileExpr(e->m_cond);
+  release(t + 1);
+  std::size_t to_false = emitJump(bc_jf, c);
+  compileExpr(e->m_true, t);
+  release(t + 1);
+  std::size_t to_end = emitJump(bc_jmp);
+  patch(to_false);
+  compileExpr(e->m_false, t);
+  patch(to_end);
+  if (want == any) {
+    release(t + 1);
+    return t;
+  }
+  release(mark);
+  return compileMove(t, want);
+}
+
+//The arguments go in consecutive registers above everything live, which
+//become the first registers of the callee's frame. The result comes back
+//in the first of them.
+bc_compiler::reg bc_compiler::compileCall(const call_expr* e, int want) {
+  std::uint32_t mark = m_top;
+
+  const decl* callee = nullptr;
+  if (e->m_base->getKind() == expr::id_kind) {
+    const decl* d = static_cast<const id_expr*>(e->m_base)->ref;
+    if (d->getKind() == decl::fn_kind) {
+      callee = d;
+    }
+  }
+  //An indirect callee is copied, since the arguments could assign it.
+  reg fn = 0;
+  if (!callee) {
+    fn = compileExpr(e->m_base, allocate());
+  }
+
+  reg base = static_cast<reg>(m_top);
+  std::size_t n = e->m_args.size();
+  for (std::size_t i = 0; i != (n ? n : 1); ++i) {
+    allocate();
+  }
+  for (std::size_t i = 0; i != n; ++i) {
+    compileExpr(e->m_args[i], base + i);
+    release(base + n);
+  }
+
+  if (callee) {
+    emit(bc_insn::makeImmediate(bc_call, base, m_prog.m_fn_ids.at(callee)));
+  } else {
+    emit(bc_insn(bc_calli, base, fn, 0));
+  }
+
+  if (want == any) {
+    release(base + 1);
+    if (base != mark) {
+      //Move the result down over the callee register.
+      release(mark);
+      return compileMove(base, allocate());
+    }
+    return base;
+  }
+  release(mark);
+  return compileMove(base, want);
+}
+
+//Objects named directly are found at compile time. Only a conditional
+//choosing between objects needs a reference at run time.
+bc_place bc_compiler::compilePlace(const expr* e) {
+  switch (e->getKind()) {
+    case expr::id_kind: {
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      auto iter = m_slots.find(d);
+      if (iter != m_slots.end()) {
+        return {bc_place::reg_kind, iter->second};
+      }
+      return {bc_place::global_kind, m_prog.m_global_ids.at(d)};
+    }
+    case expr::assign_kind: {
+      const assign_expr* a = static_cast<const assign_expr*>(e);
+      //A local is the target of the value's last instruction.
+      if (a->m_lhs->getKind() == expr::id_kind) {
+        auto iter = m_slots.find(static_cast<const id_expr*>(a->m_lhs)->ref);
+        if (iter != m_slots.end()) {
+          std::uint32_t mark = m_top;
+          compileExpr(a->m_rhs, iter->second);
+          release(mark);
+          return {bc_place::reg_kind, iter->second};
+        }
+      }
+
+      //The value is computed before the object it is stored to.
+      std::uint32_t mark = m_top;
+      reg v = compileExpr(a->m_rhs);
+      bc_place p = compilePlace(a->m_lhs);
+      compileStore(p, v);
+      if (p.k != bc_place::ref_kind) {
+        release(mark);
+      }
+      return p;
+    }
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      reg t = allocate();
+      reg r = compileExpr(c->m_cond);
+      release(t + 1);
+      std::size_t to_false = emitJump(bc_jf, r);
+      compileMove(compileAddress(compilePlace(c->m_true)), t);
+      release(t + 1);
+      std::size_t to_end = emitJump(bc_jmp);
+      patch(to_false);
+      compileMove(compileAddress(compilePlace(c->m_false)), t);
+      release(t + 1);
+      patch(to_end);
+      return {bc_place::ref_kind, t};
+    }
+    default:
+      throw std::runtime_error("not supported by the interpreter");
+  }
+}
+
+//Native code shares the globals and only writes the low byte of a char,
+//so a char read from memory is sign-extended again.
+bc_compiler::reg bc_compiler::compileLoad(bc_place p, const type* t, int want) {
+  reg r;
+  switch (p.k) {
+    case bc_place::reg_kind:
+      return compileMove(static_cast<reg>(p.index), want);
+    case bc_place::global_kind:
+      r = target(want);
+      emit(bc_insn::makeImmediate(bc_ldg, r, p.index));
+      break;
+    case bc_place::ref_kind:
+      r = target(want);
+      emit(bc_insn(bc_load, r, static_cast<reg>(p.index), 0));
+      break;
+    default:
+      throw std::logic_error("not a valid place");
+  }
+  if (t->getKind() == type::char_kind) {
+    emit(bc_insn(bc_itoc, r, r, 0));
+  }
+  return r;
+}
+
+void bc_compiler::compileStore(bc_place p, reg r) {
+  switch (p.k) {
+    case bc_place::reg_kind:
+      compileMove(r, p.index);
+      return;
+    case bc_place::global_kind:
+      emit(bc_insn::makeImmediate(bc_stg, r, p.index));
+      return;
+    case bc_place::ref_kind:
+      emit(bc_insn(bc_store, static_cast<reg>(p.index), r, 0));
+      return;
+  }
+}
+
+bc_compiler::reg bc_compiler::compileAddress(bc_place p) {
+  switch (p.k) {
+    case bc_place::reg_kind: {
+      reg t = allocate();
+      emit(bc_insn(bc_addr, t, static_cast<reg>(p.index), 0));
+      return t;
+    }
+    case bc_place::global_kind: {
+      reg t = allocate();
+      emit(bc_insn::makeImmediate(bc_addrg, t, p.index));
+      return t;
+    }
+    case bc_place::ref_kind:
+      return static_cast<reg>(p.index);
+  }
+  throw std::logic_error("not a valid place");
+}
+
+
+void bc_compiler::compileStmt(const stmt* s) {
+  std::uint32_t mark = m_top;
+  switch (s->getKind()) {
+    case stmt::block_kind:
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        compileStmt(s1);
+      }
+      break;
+
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      reg c = compileExpr(w->getCondition());
+      release(mark);
+      std::size_t skip = emitJump(bc_jf, c);
+      compileStmt(w->getBody());
+      patch(skip);
+      break;
+    }
+
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      reg c = compileExpr(i->getCondition());
+      release(mark);
+      std::size_t to_false = emitJump(bc_jf, c);
+      compileStmt(i->getTrueBranch());
+      if (i->getFalseBranch()) {
+        std::size_t to_end = emitJump(bc_jmp);
+        patch(to_false);
+        compileStmt(i->getFalseBranch());
+        patch(to_end);
+      } else {
+        patch(to_false);
+      }
+      break;
+    }
+
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      std::size_t top = m_out.code.size();
+      reg c = compileExpr(w->getCondition());
+      release(mark);
+      std::size_t exit = emitJump(bc_jf, c);
+      m_loops.push_back({top, {}});
+      compileStmt(w->getBody());
+      emitJumpTo(bc_jmp, top);
+      patch(exit);
+      for (std::size_t b : m_loops.back().breaks) {
+        patch(b);
+      }
+      m_loops.pop_back();
+      break;
+    }
+
+    case stmt::break_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("break outside of a loop");
+      }
+      m_loops.back().breaks.push_back(emitJump(bc_jmp));
+      break;
+
+    case stmt::cont_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("continue outside of a loop");
+      }
+      emitJumpTo(bc_jmp, m_loops.back().cont);
+      break;
+
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      reg r;
+      if (e) {
+        r = compileExpr(e);
+      } else {
+        r = allocate();
+        emit(bc_insn::makeImmediate(bc_ldi, r, 0));
+      }
+      emit(bc_insn(bc_ret, r, 0, 0));
+      break;
+    }
+
+    case stmt::decl_kind:
+      //A local keeps its register until the enclosing block ends.
+      compileDecl(static_cast<const decl_stmt*>(s)->m_decl);
+      return;
+
+    case stmt::expr_kind: {
+      const expr* e = static_cast<const expr_stmt*>(s)->m_expr;
+      if (e->getType()->isReference()) {
+        compilePlace(e);
+      } else {
+        compileExpr(e);
+      }
+      break;
+    }
+  }
+  release(mark);
+}
+
+//Constants with a compile-time value need no register.
+void bc_compiler::compileDecl(const decl* d) {
+  const object_decl* obj = static_cast<const object_decl*>(d);
+  if (d->getKind() != decl::var_kind && obj->hasValue()) {
+    return;
+  }
+  reg r = allocate();
+  if (obj->getInit()) {
+    compileExpr(obj->getInit(), r);
+  } else {
+    emit(bc_insn::makeImmediate(bc_ldi, r, 0));
+  }
+  release(r + 1);
+  m_slots[d] = r;
+}
+
+
+bc_program::bc_program(const decl* d) {
+  const prog_decl* prog = static_cast<const prog_decl*>(d);
+
+  //Functions and globals get their indices first so bodies can refer to
+  //any of them.
+  for (const decl* d1 : prog->getDeclarations()) {
+    switch (d1->getKind()) {
+      case decl::fn_kind:
+        m_fn_ids.emplace(d1, m_fn_ids.size());
+        break;
+      case decl::var_kind: {
+        const object_decl* obj = static_cast<const object_decl*>(d1);
+        bc_value v;
+        v.ref = nullptr;
+        v.i = getImmediate(obj->getValue());
+        m_global_ids.emplace(d1, m_globals.size());
+        m_globals.push_back(v);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  for (const decl* d1 : prog->getDeclarations()) {
+    if (d1->getKind() == decl::fn_kind) {
+      const fn_decl* fn = static_cast<const fn_decl*>(d1);
+      if (!fn->getBody()) {
+        std::stringstream ss;
+        ss << "'" << *fn->getName() << "' is never defined";
+        throw std::runtime_error(ss.str());
+      }
+      bc_compiler c(*this, fn);
+      m_fns.push_back(c.compile());
+    }
+  }
+}
+
+std::uint32_t bc_program::getIndex(const decl* fn) const {
+  return m_fn_ids.at(fn);
+}
+
+std::uint32_t bc_program::getGlobalIndex(const decl* var) const {
+  return m_global_ids.at(var);
+}
+
+std::int32_t bc_program::findFunction(const std::string& name) const {
+  for (std::size_t i = 0; i != m_fns.size(); ++i) {
+    if (m_fns[i].name->str() == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void bc_program::print(std::ostream& os) const {
+  for (const bc_function& fn : m_fns) {
+    os << *fn.name << ": " << fn.params << " params, " << fn.frame_size << " registers\n";
+    for (std::size_t pc = 0; pc != fn.code.size(); ++pc) {
+      const bc_insn& i = fn.code[pc];
+      os << "  " << pc << '\t' << toString(static_cast<bc_op>(i.op)) << '\t';
+      switch (i.op) {
+        case bc_ldi:
+        case bc_ldg:
+        case bc_stg:
+        case bc_addrg:
+        case bc_call:
+          os << 'r' << i.a << ", " << i.imm();
+          break;
+        case bc_jmp:
+          os << "-> " << std::int64_t(pc) + 1 + i.imm();
+          break;
+        case bc_jt:
+        case bc_jf:
+          os << 'r' << i.a << ", -> " << std::int64_t(pc) + 1 + i.imm();
+          break;
+        case bc_ret:
+          os << 'r' << i.a;
+          break;
+        case bc_mov:
+        case bc_addr:
+        case bc_load:
+        case bc_store:
+        case bc_neg:
+        case bc_bnot:
+        case bc_lnot:
+        case bc_fneg:
+        case bc_itof:
+        case bc_ftoi:
+        case bc_itoc:
+        case bc_itob:
+        case bc_ftob:
+        case bc_calli:
+          os << 'r' << i.a << ", r" << i.b();
+          break;
+        default:
+          os << 'r' << i.a << ", r" << i.b() << ", r" << i.c();
+          break;
+      }
+      os << '\n';
+    }
+  }
+}
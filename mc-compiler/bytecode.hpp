@@ -0,0 +1,133 @@
+#pragma once
+
+#include "symbol.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class decl;
+class fn_decl;
+
+// A register or global. Every MC scalar is stored unboxed: bools, chars
+// and ints as a 32-bit int (bools are 0 or 1, chars are sign-extended),
+// floats as a float, function values as the index of the function.
+// References, which only exist while an expression designates an object
+// that is not known at compile time, point at a register or global.
+union bc_value {
+  std::int32_t i;
+  float f;
+  bc_value* ref;
+};
+
+// The instruction set. Register operands are indices into the frame of
+// the running function. Arithmetic is 'a = b op c'; jumps are relative to
+// the next instruction.
+#define MC_BYTECODE_OPS(X) \
+  X(mov)    /*a = b*/ \
+  X(ldi)    /*a = imm*/ \
+  X(ldg)    /*a = global imm*/ \
+  X(stg)    /*global imm = a*/ \
+  X(addr)   /*a = &b*/ \
+  X(addrg)  /*a = &global imm*/ \
+  X(load)   /*a = *b*/ \
+  X(store)  /**a = b*/ \
+  X(add) X(sub) X(mul) X(div) X(rem) \
+  X(band) X(bor) X(bxor) X(shl) X(shr) \
+  X(neg) X(bnot) X(lnot) \
+  X(fadd) X(fsub) X(fmul) X(fdiv) X(frem) X(fneg) \
+  X(eq) X(ne) X(lt) X(gt) X(le) X(ge) \
+  X(feq) X(fne) X(flt) X(fgt) X(fle) X(fge) \
+  X(itof) X(ftoi) X(itoc) X(itob) X(ftob) \
+  X(jmp)    /*pc += imm*/ \
+  X(jt)     /*if a: pc += imm*/ \
+  X(jf)     /*if !a: pc += imm*/ \
+  X(call)   /*a = function imm(a, a + 1, ...)*/ \
+  X(calli)  /*a = function b(a, a + 1, ...)*/ \
+  X(ret)    /*return a*/
+
+enum bc_op : std::uint16_t {
+#define MC_BYTECODE_ENUM(name) bc_##name,
+  MC_BYTECODE_OPS(MC_BYTECODE_ENUM)
+#undef MC_BYTECODE_ENUM
+};
+
+const char* toString(bc_op op);
+
+// One instruction, either three 16-bit registers or a register and a
+// 32-bit immediate sharing the same bits.
+struct bc_insn {
+  bc_insn(bc_op op, std::uint16_t a, std::uint16_t b, std::uint16_t c) : op(op), a(a), bc(b | std::uint32_t(c) << 16) {}
+
+  static bc_insn makeImmediate(bc_op op, std::uint16_t a, std::int32_t imm) {
+    bc_insn i(op, a, 0, 0);
+    i.bc = static_cast<std::uint32_t>(imm);
+    return i;
+  }
+
+  std::uint16_t b() const {
+    return bc & 0xffff;
+  }
+
+  std::uint16_t c() const {
+    return bc >> 16;
+  }
+
+  std::int32_t imm() const {
+    return static_cast<std::int32_t>(bc);
+  }
+
+  std::uint16_t op;
+  std::uint16_t a;
+  std::uint32_t bc;
+};
+
+struct bc_function {
+  const fn_decl* decl;
+  symbol name;
+  std::uint32_t params;
+  std::uint32_t frame_size; //Registers, including the parameters.
+  std::vector<bc_insn> code;
+};
+
+// A whole program compiled for the interpreter.
+class bc_program {
+  public:
+    // Compiles the checked program 'prog'. Throws if it uses something the
+    // interpreter does not support.
+    explicit bc_program(const decl* prog);
+
+    const std::vector<bc_function>& getFunctions() const {
+      return m_fns;
+    }
+
+    const bc_function& getFunction(std::uint32_t n) const {
+      return m_fns[n];
+    }
+
+    // The index of function 'fn'.
+    std::uint32_t getIndex(const decl* fn) const;
+
+    // The index of global variable 'var'.
+    std::uint32_t getGlobalIndex(const decl* var) const;
+
+    // The index of the function named 'name', or -1.
+    std::int32_t findFunction(const std::string& name) const;
+
+    // The initial values of the global variables.
+    const std::vector<bc_value>& getGlobals() const {
+      return m_globals;
+    }
+
+    void print(std::ostream& os) const;
+
+  private:
+    friend class bc_compiler;
+
+    std::vector<bc_function> m_fns;
+    std::vector<bc_value> m_globals;
+    std::unordered_map<const decl*, std::uint32_t> m_fn_ids;
+    std::unordered_map<const decl*, std::uint32_t> m_global_ids;
+};
@@ -0,0 +1,679 @@
+#include "c99.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Helpers for the operations whose C meaning differs from MC's. Casting
+// back from uint32_t is implementation-defined in C99 but wraps on every
+// two's complement target.
+static const char prelude[] =
+  "#include <stdint.h>\n"
+  "\n"
+  "float fmodf(float, float);\n"
+  "\n"
+  "#ifdef __GNUC__\n"
+  "#define mc_trap() __builtin_trap()\n"
+  "#else\n"
+  "void abort(void);\n"
+  "#define mc_trap() abort()\n"
+  "#endif\n"
+  "\n"
+  "static inline int32_t mc_add(int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }\n"
+  "static inline int32_t mc_sub(int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }\n"
+  "static inline int32_t mc_mul(int32_t a, int32_t b) { return (int32_t)((uint32_t)a * (uint32_t)b); }\n"
+  "static inline int32_t mc_neg(int32_t a) { return (int32_t)(0u - (uint32_t)a); }\n"
+  "static inline int32_t mc_div(int32_t a, int32_t b) { if (b == 0) mc_trap(); return b == -1 ? mc_neg(a) : a / b; }\n"
+  "static inline int32_t mc_rem(int32_t a, int32_t b) { if (b == 0) mc_trap(); return b == -1 ? 0 : a % b; }\n"
+  "static inline int32_t mc_shl(int32_t a, int32_t n) { return (int32_t)((uint32_t)a << (n & 31)); }\n"
+  "static inline int32_t mc_shr(int32_t a, int32_t n) { return a < 0 ? ~(~a >> (n & 31)) : a >> (n & 31); }\n"
+  "static inline int8_t mc_char(int32_t a) { int32_t b = (int32_t)((uint32_t)a & 0xffu); return (int8_t)(b < 128 ? b : b - 256); }\n"
+  "static inline int32_t mc_ftoi(float f) {\n"
+  "  if (f != f) return 0;\n"
+  "  if (f >= 2147483648.0f) return INT32_MAX;\n"
+  "  if (f < -2147483648.0f) return INT32_MIN;\n"
+  "  return (int32_t)f;\n"
+  "}\n";
+
+//True if evaluating 'e' can change anything, so operands evaluated
+//before it have to be saved first.
+static bool hasEffects(const expr* e) {
+  switch (e->getKind()) {
+    case expr::call_kind:
+    case expr::assign_kind:
+      return true;
+    case expr::unop_kind:
+      return hasEffects(static_cast<const unop_expr*>(e)->m_arg);
+    case expr::binop_kind: {
+      const binop_expr* b = static_cast<const binop_expr*>(e);
+      return hasEffects(b->m_lhs) || hasEffects(b->m_rhs);
+    }
+    case expr::cast_kind:
+      return hasEffects(static_cast<const cast_expr*>(e)->m_src);
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      return hasEffects(c->m_cond) || hasEffects(c->m_true) || hasEffects(c->m_false);
+    }
+    case expr::conv_kind:
+      return hasEffects(static_cast<const conv_expr*>(e)->m_src);
+    default:
+      return false;
+  }
+}
+
+// A C expression without side effects. It is 'stable' when nothing the
+// program does later can change its value: a constant, a function or a
+// temporary.
+struct c_expr {
+  std::string text;
+  bool stable;
+};
+
+//Each expression with side effects becomes statements that perform them
+//in MC's order, and the expression that is left is free of them.
+class c_generator {
+  public:
+    c_generator(const prog_decl* prog, std::ostream& os);
+
+    void generate();
+
+  private:
+    std::string getName(const decl* d) const;
+    static std::string getGlobalName(const decl* d);
+    std::string makeName(const std::string& base);
+    std::string declare(const type* t, const std::string& name) const;
+    std::string declareFunction(const fn_decl* fn, bool define);
+
+    std::ostream& indent();
+    c_expr makeTemp(const type* t, const c_expr& value);
+    c_expr makeStable(const type* t, const c_expr& value);
+    std::string getConstant(const const_value& v) const;
+
+    c_expr compileExpr(const expr* e);
+    c_expr compileId(const id_expr* e);
+    c_expr compileUnary(const unop_expr* e);
+    c_expr compileBinary(const binop_expr* e);
+    c_expr compileLogical(const binop_expr* e);
+    c_expr compileCall(const call_expr* e, bool discard);
+    c_expr compileAssign(const assign_expr* e);
+    c_expr compileConditional(const cond_expr* e);
+    c_expr compileConversion(const conv_expr* e);
+
+    void compileFunction(const fn_decl* fn);
+    void compileStmt(const stmt* s);
+    void compileBlock(const stmt* s);
+    void compileDecl(const decl* d);
+
+    const prog_decl* m_prog;
+    std::ostream& m_os;
+    std::unordered_set<std::string> m_globals;
+
+    //Locals and temporaries of the function being generated. Each gets a
+    //name of its own, so C's scopes never hide one from another.
+    std::unordered_map<const decl*, std::string> m_locals;
+    unsigned m_next;
+    unsigned m_indent;
+};
+
+c_generator::c_generator(const prog_decl* prog, std::ostream& os) : m_prog(prog), m_os(os), m_next(0), m_indent(0) {}
+
+std::string c_generator::getName(const decl* d) const {
+  auto iter = m_locals.find(d);
+  if (iter != m_locals.end()) {
+    return iter->second;
+  }
+  return getGlobalName(d);
+}
+
+//Globals and functions are prefixed, so no MC name can be taken for a C
+//keyword, library function or macro. Only main keeps its name, since it
+//is the entry point.
+std::string c_generator::getGlobalName(const decl* d) {
+  std::string name(d->getName()->str());
+  if (d->getKind() == decl::fn_kind && name == "main") {
+    return name;
+  }
+  return "g_" + name;
+}
+
+//Locals are suffixed, so only a global of the same name can collide.
+std::string c_generator::makeName(const std::string& base) {
+  std::string name;
+  do {
+    name = base + std::to_string(++m_next);
+  } while (m_globals.count(name));
+  return name;
+}
+
+//Builds the declarator inside out, as C reads it.
+std::string c_generator::declare(const type* t, const std::string& name) const {
+  std::string sep = name.empty() ? "" : " ";
+  switch (t->getKind()) {
+    case type::bool_kind:
+      return "_Bool" + sep + name;
+    case type::char_kind:
+      return "int8_t" + sep + name;
+    case type::int_kind:
+      return "int32_t" + sep + name;
+    case type::float_kind:
+      return "float" + sep + name;
+    case type::ptr_kind:
+      return declare(static_cast<const ptr_type*>(t)->getElementType(), "*" + name);
+    case type::ref_kind:
+      return declare(static_cast<const ref_type*>(t)->getObjectType(), "*" + name);
+    case type::fn_kind: {
+      const fn_type* f = static_cast<const fn_type*>(t);
+      std::string params;
+      for (const type* p : f->getParameterTypes()) {
+        params += (params.empty() ? "" : ", ") + declare(p, "");
+      }
+      std::string inner = !name.empty() && name[0] == '*' ? "(" + name + ")" : name;
+      return declare(f->getReturnType(), inner + "(" + (params.empty() ? "void" : params) + ")");
+    }
+  }
+  throw std::logic_error("Not a valid type");
+}
+
+//Parameters are only named where the function is defined.
+std::string c_generator::declareFunction(const fn_decl* fn, bool define) {
+  std::string params;
+  for (const decl* p : fn->getParameters()) {
+    std::string name;
+    if (define) {
+      name = makeName(std::string(p->getName()->str()) + "_");
+      m_locals.emplace(p, name);
+    }
+    params += (params.empty() ? "" : ", ") + declare(static_cast<const parm_decl*>(p)->getType(), name);
+  }
+  return declare(fn->getReturnType(), getName(fn) + "(" + (params.empty() ? "void" : params) + ")");
+}
+
+//Drops the parentheses around a whole expression, which a statement's
+//own parentheses make redundant.
+static std::string unwrap(const std::string& s) {
+  if (s.size() < 2 || s.front() != '(' || s.back() != ')') {
+    return s;
+  }
+  int depth = 0;
+  for (std::size_t i = 0; i + 1 != s.size(); ++i) {
+    depth += s[i] == '(' ? 1 : s[i] == ')' ? -1 : 0;
+    if (depth == 0) {
+      return s;
+    }
+  }
+  return s.substr(1, s.size() - 2);
+}
+
+std::ostream& c_generator::indent() {
+  return m_os << std::string(2 * m_indent, ' ');
+}
+
+c_expr c_generator::makeTemp(const type* t, const c_expr& value) {
+  std::string name = makeName("t");
+  indent() << declare(t, name) << " = " << value.text << ";\n";
+  return {name, true};
+}
+
+//Saves 'value' when what is evaluated next could change it.
+c_expr c_generator::makeStable(const type* t, const c_expr& value) {
+  return value.stable ? value : makeTemp(t, value);
+}
+
+//Floats are printed with enough digits to read back exactly.
+std::string c_generator::getConstant(const const_value& v) const {
+  switch (v.kind) {
+    case type::bool_kind:
+      return v.b ? "1" : "0";
+    case type::char_kind:
+      return "((int8_t)" + std::to_string(static_cast<signed char>(v.c)) + ")";
+    case type::int_kind:
+      if (v.i == INT32_MIN) {
+        return "(-2147483647 - 1)";
+      }
+      return v.i < 0 ? "(" + std::to_string(v.i) + ")" : std::to_string(v.i);
+    case type::float_kind: {
+      if (std::isnan(v.f)) {
+        return "(0.0f / 0.0f)";
+      }
+      if (std::isinf(v.f)) {
+        return v.f < 0 ? "(-1.0f / 0.0f)" : "(1.0f / 0.0f)";
+      }
+      char buf[32];
+      std::snprintf(buf, sizeof buf, "%.9g", v.f);
+      std::string s = buf;
+      if (s.find_first_of(".e") == std::string::npos) {
+        s += ".0";
+      }
+      return v.f < 0 ? "(" + s + "f)" : s + "f";
+    }
+    default:
+      throw std::logic_error("not a constant type");
+  }
+}
+
+void c_generator::generate() {
+  m_os << prelude;
+
+  //Everything is declared before any body refers to it.
+  for (const decl* d : m_prog->getDeclarations()) {
+    m_globals.insert(getGlobalName(d));
+  }
+
+  m_os << '\n';
+  for (const decl* d : m_prog->getDeclarations()) {
+    if (d->getKind() == decl::fn_kind) {
+      m_os << declareFunction(static_cast<const fn_decl*>(d), false) << ";\n";
+    }
+  }
+
+  m_os << '\n';
+  for (const decl* d : m_prog->getDeclarations()) {
+    if (d->getKind() == decl::fn_kind) {
+      continue;
+    }
+    const object_decl* obj = static_cast<const object_decl*>(d);
+    m_os << (d->getKind() == decl::var_kind ? "" : "const ") << declare(obj->getType(), getName(d)) << " = "
+         << getConstant(obj->getValue()) << ";\n";
+  }
+
+  for (const decl* d : m_prog->getDeclarations()) {
+    if (d->getKind() == decl::fn_kind && static_cast<const fn_decl*>(d)->getBody()) {
+      compileFunction(static_cast<const fn_decl*>(d));
+    }
+  }
+}
+
+void c_generator::compileFunction(const fn_decl* fn) {
+  m_locals.clear();
+  m_next = 0;
+  m_os << '\n' << declareFunction(fn, true) << " {\n";
+  m_indent = 1;
+  const stmt* body = fn->getBody();
+  const stmt* last = body;
+  if (body->getKind() == stmt::block_kind) {
+    for (const stmt* s : static_cast<const block_stmt*>(body)->getStatements()) {
+      compileStmt(s);
+      last = s;
+    }
+  } else {
+    compileStmt(body);
+  }
+
+  //Running off the end returns zero.
+  if (last->getKind() != stmt::ret_kind) {
+    indent() << "return 0;\n";
+  }
+  m_indent = 0;
+  m_os << "}\n";
+}
+
+
+c_expr c_generator::compileExpr(const expr* e) {
+  switch (e->getKind()) {
+    case expr::bool_kind:
+      return {getConstant(const_value::makeBool(static_cast<const bool_expr*>(e)->val)), true};
+    case expr::int_kind:
+      return {getConstant(const_value::makeInt(static_cast<const int_expr*>(e)->val)), true};
+    case expr::float_kind:
+      return {getConstant(const_value::makeFloat(static_cast<float>(static_cast<const float_expr*>(e)->val))), true};
+    case expr::id_kind:
+      return compileId(static_cast<const id_expr*>(e));
+    case expr::unop_kind:
+      return compileUnary(static_cast<const unop_expr*>(e));
+    case expr::binop_kind:
+      return compileBinary(static_cast<const binop_expr*>(e));
+    case expr::call_kind:
+      return compileCall(static_cast<const call_expr*>(e), false);
+    case expr::cast_kind:
+      //The operand was already converted to the target type.
+      return compileExpr(static_cast<const cast_expr*>(e)->m_src);
+    case expr::assign_kind:
+      return compileAssign(static_cast<const assign_expr*>(e));
+    case expr::cond_kind:
+      return compileConditional(static_cast<const cond_expr*>(e));
+    case expr::conv_kind:
+      return compileConversion(static_cast<const conv_expr*>(e));
+    default:
+      throw std::runtime_error("not implemented in this compiler version");
+  }
+}
+
+//Names of objects are lvalues; constants are inlined.
+c_expr c_generator::compileId(const id_expr* e) {
+  const decl* d = e->ref;
+  switch (d->getKind()) {
+    case decl::const_kind:
+    case decl::value_kind: {
+      const object_decl* obj = static_cast<const object_decl*>(d);
+      if (obj->hasValue()) {
+        return {getConstant(obj->getValue()), true};
+      }
+      return {getName(d), false};
+    }
+    case decl::var_kind:
+    case decl::parm_kind:
+      return {getName(d), false};
+    case decl::fn_kind:
+      return {getName(d), true};
+    default:
+      throw std::logic_error("not a valid id expression");
+  }
+}
+
+c_expr c_generator::compileUnary(const unop_expr* e) {
+  c_expr a = compileExpr(e->m_arg);
+  switch (e->m_op) {
+    case uo_pos:
+      return a;
+    case uo_neg:
+      if (e->m_arg->getType()->getKind() == type::float_kind) {
+        return {"(-" + a.text + ")", false};
+      }
+      return {"mc_neg(" + a.text + ")", false};
+    case uo_cmp:
+      return {"(~" + a.text + ")", false};
+    case uo_not:
+      return {"(!" + a.text + ")", false};
+    default:
+      throw std::runtime_error("not implemented in this compiler version");
+  }
+}
+
+c_expr c_generator::compileBinary(const binop_expr* e) {
+  if (e->m_op == bo_land || e->m_op == bo_lor) {
+    return compileLogical(e);
+  }
+
+  c_expr l = compileExpr(e->m_lhs);
+  if (hasEffects(e->m_rhs)) {
+    l = makeStable(e->m_lhs->getType(), l);
+  }
+  c_expr r = compileExpr(e->m_rhs);
+  std::string args = "(" + l.text + ", " + r.text + ")";
+
+  bool is_float = e->m_lhs->getType()->getKind() == type::float_kind;
+  switch (e->m_op) {
+    case bo_add:
+      return {is_float ? "(" + l.text + " + " + r.text + ")" : "mc_add" + args, false};
+    case bo_sub:
+      return {is_float ? "(" + l.text + " - " + r.text + ")" : "mc_sub" + args, false};
+    case bo_mul:
+      return {is_float ? "(" + l.text + " * " + r.text + ")" : "mc_mul" + args, false};
+    case bo_quo:
+      return {is_float ? "(" + l.text + " / " + r.text + ")" : "mc_div" + args, false};
+    case bo_rem:
+      return {(is_float ? "fmodf" : "mc_rem") + args, false};
+    case bo_and:
+      return {"(" + l.text + " & " + r.text + ")", false};
+    case bo_ior:
+      return {"(" + l.text + " | " + r.text + ")", false};
+    case bo_xor:
+      return {"(" + l.text + " ^ " + r.text + ")", false};
+    case bo_shl:
+      return {"mc_shl" + args, false};
+    case bo_shr:
+      return {"mc_shr" + args, false};
+    case bo_eq:
+      return {"(" + l.text + " == " + r.text + ")", false};
+    case bo_ne:
+      return {"(" + l.text + " != " + r.text + ")", false};
+    case bo_lt:
+      return {"(" + l.text + " < " + r.text + ")", false};
+    case bo_gt:
+      return {"(" + l.text + " > " + r.text + ")", false};
+    case bo_le:
+      return {"(" + l.text + " <= " + r.text + ")", false};
+    case bo_ge:
+      return {"(" + l.text + " >= " + r.text + ")", false};
+    default:
+      throw std::logic_error("not a binary operator");
+  }
+}
+
+//C's && and || already short-circuit; only an operand with side
+//effects needs statements of its own.
+c_expr c_generator::compileLogical(const binop_expr* e) {
+  bool land = e->m_op == bo_land;
+  c_expr l = compileExpr(e->m_lhs);
+  if (!hasEffects(e->m_rhs)) {
+    c_expr r = compileExpr(e->m_rhs);
+    return {"(" + l.text + (land ? " && " : " || ") + r.text + ")", false};
+  }
+
+  c_expr t = makeTemp(e->getType(), l);
+  indent() << "if (" << (land ? "" : "!") << t.text << ") {\n";
+  ++m_indent;
+  c_expr r = compileExpr(e->m_rhs);
+  indent() << t.text << " = " << r.text << ";\n";
+  --m_indent;
+  indent() << "}\n";
+  return t;
+}
+
+//Arguments are evaluated left to right, so each is saved if one after
+//it has side effects. The call itself happens here; only its result is
+//left for later.
+c_expr c_generator::compileCall(const call_expr* e, bool discard) {
+  std::size_t n = e->m_args.size();
+  std::vector<bool> effects(n + 1, false);
+  for (std::size_t i = n; i-- != 0;) {
+    effects[i] = effects[i + 1] || hasEffects(e->m_args[i]);
+  }
+
+  c_expr callee = compileExpr(e->m_base);
+  if (effects[0]) {
+    callee = makeStable(e->m_base->getType(), callee);
+  }
+  std::string call = callee.text + "(";
+  for (std::size_t i = 0; i != n; ++i) {
+    c_expr a = compileExpr(e->m_args[i]);
+    if (effects[i + 1]) {
+      a = makeStable(e->m_args[i]->getType(), a);
+    }
+    call += (i ? ", " : "") + a.text;
+  }
+  call += ")";
+
+  if (discard) {
+    indent() << call << ";\n";
+    return {"", true};
+  }
+  return makeTemp(e->getType(), {call, false});
+}
+
+//The value is computed before the object it is stored to. What is left
+//is the object, as an lvalue.
+c_expr c_generator::compileAssign(const assign_expr* e) {
+  c_expr r = compileExpr(e->m_rhs);
+  if (hasEffects(e->m_lhs)) {
+    r = makeStable(e->m_rhs->getType(), r);
+  }
+  c_expr l = compileExpr(e->m_lhs);
+  indent() << l.text << " = " << r.text << ";\n";
+  return l;
+}
+
+//A conditional object is chosen through its address.
+c_expr c_generator::compileConditional(const cond_expr* e) {
+  bool ref = e->getType()->isReference();
+  c_expr c = compileExpr(e->m_cond);
+  if (!hasEffects(e->m_true) && !hasEffects(e->m_false)) {
+    c_expr a = compileExpr(e->m_true);
+    c_expr b = compileExpr(e->m_false);
+    if (ref) {
+      return {"(*(" + c.text + " ? &" + a.text + " : &" + b.text + "))", false};
+    }
+    return {"(" + c.text + " ? " + a.text + " : " + b.text + ")", false};
+  }
+
+  std::string t = makeName("t");
+  std::string addr = ref ? "&" : "";
+  indent() << declare(e->getType(), t) << ";\n";
+  indent() << "if (" << c.text << ") {\n";
+  ++m_indent;
+  c_expr a = compileExpr(e->m_true);
+  indent() << t << " = " << addr << a.text << ";\n";
+  --m_indent;
+  indent() << "} else {\n";
+  ++m_indent;
+  c_expr b = compileExpr(e->m_false);
+  indent() << t << " = " << addr << b.text << ";\n";
+  --m_indent;
+  indent() << "}\n";
+  return {ref ? "(*" + t + ")" : t, !ref};
+}
+
+c_expr c_generator::compileConversion(const conv_expr* e) {
+  c_expr a = compileExpr(e->m_src);
+  switch (e->m_conv) {
+    case conv_identity:
+      return a;
+    case conv_value:
+      //Reading the object; what it holds can still change.
+      return {a.text, false};
+    case conv_bool:
+      if (e->m_src->getType()->getKind() == type::float_kind) {
+        return {"(" + a.text + " != 0.0f)", false};
+      }
+      return {"(" + a.text + " != 0)", false};
+    case conv_char:
+      return {"mc_char(" + a.text + ")", false};
+    case conv_int:
+      return {"((int32_t)" + a.text + ")", a.stable};
+    case conv_ext:
+      return {"((float)" + a.text + ")", a.stable};
+    case conv_trunc:
+      return {"mc_ftoi(" + a.text + ")", a.stable};
+    default:
+      throw std::logic_error("not a valid conversion");
+  }
+}
+
+
+//A statement that is not a block still gets braces.
+void c_generator::compileBlock(const stmt* s) {
+  m_os << "{\n";
+  ++m_indent;
+  if (s->getKind() == stmt::block_kind) {
+    for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+      compileStmt(s1);
+    }
+  } else {
+    compileStmt(s);
+  }
+  --m_indent;
+  indent() << "}";
+}
+
+void c_generator::compileStmt(const stmt* s) {
+  switch (s->getKind()) {
+    case stmt::block_kind:
+      indent();
+      compileBlock(s);
+      m_os << '\n';
+      return;
+
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      c_expr c = compileExpr(w->getCondition());
+      indent() << "if (" << unwrap(c.text) << ") ";
+      compileBlock(w->getBody());
+      m_os << '\n';
+      return;
+    }
+
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      c_expr c = compileExpr(i->getCondition());
+      indent() << "if (" << unwrap(c.text) << ") ";
+      compileBlock(i->getTrueBranch());
+      if (i->getFalseBranch()) {
+        m_os << " else ";
+        compileBlock(i->getFalseBranch());
+      }
+      m_os << '\n';
+      return;
+    }
+
+    //A condition with side effects is evaluated at the top of the body,
+    //which is also where continue goes.
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      if (!hasEffects(w->getCondition())) {
+        c_expr c = compileExpr(w->getCondition());
+        indent() << "while (" << unwrap(c.text) << ") ";
+        compileBlock(w->getBody());
+        m_os << '\n';
+        return;
+      }
+      indent() << "for (;;) {\n";
+      ++m_indent;
+      c_expr c = compileExpr(w->getCondition());
+      indent() << "if (!" << c.text << ") break;\n";
+      indent();
+      compileBlock(w->getBody());
+      m_os << '\n';
+      --m_indent;
+      indent() << "}\n";
+      return;
+    }
+
+    case stmt::break_kind:
+      indent() << "break;\n";
+      return;
+
+    case stmt::cont_kind:
+      indent() << "continue;\n";
+      return;
+
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      std::string v = e ? compileExpr(e).text : "0";
+      indent() << "return " << v << ";\n";
+      return;
+    }
+
+    case stmt::decl_kind:
+      return compileDecl(static_cast<const decl_stmt*>(s)->m_decl);
+
+    //Pure expressions are still evaluated, since dividing by zero traps.
+    case stmt::expr_kind: {
+      const expr* e = static_cast<const expr_stmt*>(s)->m_expr;
+      if (e->getKind() == expr::call_kind) {
+        compileCall(static_cast<const call_expr*>(e), true);
+      } else if (e->getKind() == expr::assign_kind) {
+        compileAssign(static_cast<const assign_expr*>(e));
+      } else {
+        indent() << "(void)" << compileExpr(e).text << ";\n";
+      }
+      return;
+    }
+  }
+}
+
+//Constants with a compile-time value are inlined where they are used.
+void c_generator::compileDecl(const decl* d) {
+  const object_decl* obj = static_cast<const object_decl*>(d);
+  if (d->getKind() != decl::var_kind && obj->hasValue()) {
+    return;
+  }
+  std::string init = obj->getInit() ? compileExpr(obj->getInit()).text : "0";
+  std::string name = makeName(std::string(d->getName()->str()) + "_");
+  indent() << declare(obj->getType(), name) << " = " << init << ";\n";
+  m_locals.emplace(d, name);
+}
+
+
+void generateC(const decl* prog, std::ostream& os) {
+  c_generator gen(static_cast<const prog_decl*>(prog), os);
+  gen.generate();
+}
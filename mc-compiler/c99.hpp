@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iosfwd>
+
+class decl;
+
+// Translates 'prog' to one C99 translation unit, written to 'os'. The
+// output keeps MC's semantics whatever C leaves undefined:
+//
+// - Integer arithmetic wraps.
+// - Division by zero traps.
+// - Shift counts are masked.
+// - float-to-int conversion saturates.
+// - Operands are evaluated left to right, and an assignment's value
+//   before its object.
+//
+// Globals and functions keep their MC names and the C calling
+// convention, so files translated separately link with each other and
+// with objects from the LLVM backend. Build with -std=c99 so that float
+// expressions are not contracted.
+void generateC(const decl* prog, std::ostream& os);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+
+// Character classes used by the lexer. Each byte value maps to a set of
+// class bits in a table that is built at compile time, so classifying a
+// character is a single load and never consults the C locale.
+enum char_class : unsigned char {
+  cc_space = 1 << 0, // ' ' and '\t'
+  cc_newline = 1 << 1,
+  cc_digit = 1 << 2,
+  cc_bin_digit = 1 << 3,
+  cc_hex_digit = 1 << 4,
+  cc_nondigit = 1 << 5, // letters and '_'
+
+  cc_alphanumeric = cc_digit | cc_nondigit,
+};
+
+constexpr std::array<unsigned char, 256> makeCharClassTable() {
+  std::array<unsigned char, 256> t{};
+  t[' '] |= cc_space;
+  t['\t'] |= cc_space;
+  t['\n'] |= cc_newline;
+  for (int c = '0'; c <= '9'; ++c) {
+    t[c] |= cc_digit | cc_hex_digit;
+  }
+  t['0'] |= cc_bin_digit;
+  t['1'] |= cc_bin_digit;
+  for (int c = 'a'; c <= 'z'; ++c) {
+    t[c] |= cc_nondigit;
+    t[c - 'a' + 'A'] |= cc_nondigit;
+  }
+  for (int c = 'a'; c <= 'f'; ++c) {
+    t[c] |= cc_hex_digit;
+    t[c - 'a' + 'A'] |= cc_hex_digit;
+  }
+  t['_'] |= cc_nondigit;
+  return t;
+}
+
+inline constexpr std::array<unsigned char, 256> char_classes = makeCharClassTable();
+
+// Returns true if 'c' belongs to any of the classes in 'cls'.
+constexpr bool hasCharClass(char c, unsigned cls) {
+  return char_classes[static_cast<unsigned char>(c)] & cls;
+}
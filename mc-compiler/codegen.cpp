@@ -1,72 +1,87 @@
 #include "codegen.hpp"
+#include "bytecode.hpp"
+#include "ir.hpp"
+#include "target.hpp"
 #include "type.hpp"
 #include "expr.hpp"
 #include "decl.hpp"
 #include "stmt.hpp"
-#include "token.hpp"
 
-#include <llvm/IR/LLBMContext.>h
-#include <llvm/IR/Module.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
-#include <llvm/IR/Type.h>
-#include <llvm/IR/Constant.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 
+#include <algorithm>
 #include <cassert>
-#include <iostream>
-#include <sstream>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
-
-
-using vairable_map = std::unordered_map<const decl*, llvm::Value*>;
+using variable_map = std::unordered_map<const decl*, llvm::Value*>;
 
 struct cg_context {
-    cg_context() : ll(new llvm:LLVMContext()) {}
-    
-    ~cg_context() {
-        delete ll;
-    }
-
-llvm:LLVMContext *getContext() const {
-     return ll;
-     }
-
-
-     std::string getName(const decl* d);
+    explicit cg_context(llvm::LLVMContext& cxt) : ll(&cxt) {}
 
+    llvm::LLVMContext* getContext() const {
+        return ll;
+    }
 
-     llvm::Type* getType(const type* t);
-     llvm::Type* getBoolType(const boolType* t);
-     llvm::Type* getCharType(const char_type* t);
-     llvm::Type* getIntType(const int_type* t);
-     llvm::Type* getFloatType(const float_type* t);
-     llvm::Type* getRefType(const ref_type* t);
-     llvm::Type* getFnType(const fn_type* t);
+    std::string getName(const decl* d);
+    std::string getGlobalName(const decl* d);
 
+    llvm::Type* getType(const type* t);
+    llvm::Type* getBoolType(const bool_type* t);
+    llvm::Type* getCharType(const char_type* t);
+    llvm::Type* getIntType(const int_type* t);
+    llvm::Type* getFloatType(const float_type* t);
+    llvm::Type* getPtrType(const ptr_type* t);
+    llvm::Type* getRefType(const ref_type* t);
+    llvm::Type* getFnType(const fn_type* t);
 
-     llvm::Type* getType(const typed_decl* d);
+    llvm::Type* getType(const typed_decl* d);
 
+    // The signature of a function; values of function type are pointers
+    // to it.
+    llvm::FunctionType* getFunctionType(const fn_type* t);
 
-     llvm::LLVMContext* ll;
+    llvm::Constant* getValue(const const_value& v);
 
+    llvm::LLVMContext* ll;
 };
 
 
 struct cg_module {
-    cg_module(cg_context* context, const prog_decl* prog);
+    cg_module(cg_context& cxt, const prog_decl* prog);
 
-    llvm::LLVMContext* getContext() const  {
-      return parent->getContext();
+    llvm::LLVMContext* getContext() const {
+        return parent->getContext();
     }
 
     llvm::Module* getModule() const {
-        return mod;
+        return mod.get();
+    }
+
+    std::unique_ptr<llvm::Module> release() {
+        return std::move(mod);
     }
 
     std::string getName(const decl* d) {
-        return parent->geetName(d);
+        return parent->getName(d);
     }
 
     llvm::Type* getType(const type* t) {
@@ -77,31 +92,39 @@ struct cg_module {
         return parent->getType(d);
     }
 
-    void declare(const decl* d, llvm::GLobalValue* v);
+    void declare(const decl* d, llvm::Value* v);
 
-
-    llvm::GlobalValue* lookup(const decl* d) const;
+    llvm::Value* lookup(const decl* d) const;
 
     void generate();
-    void generate(const decl* d);
-    void generateVarDecl(Const var_decl* d);
+    void generate(const fn_decl* const* first, const fn_decl* const* last, bool owner);
+    void declareGlobal(const decl* d, bool define);
+    void generateVarDecl(const object_decl* d, bool define);
+    void declareFnDecl(const fn_decl* d);
     void generateFnDecl(const fn_decl* d);
+    void removeUnusedDeclarations();
 
     cg_context* parent;
 
     const prog_decl* prog;
 
-    llvm::Module* mod;
+    std::unique_ptr<llvm::Module> mod;
 
     variable_map globals;
 };
 
 
+//The blocks that break and continue jump to.
+struct cg_loop {
+    llvm::BasicBlock* brk;
+    llvm::BasicBlock* cont;
+};
+
 struct cg_function {
     cg_function(cg_module& m, const fn_decl* d);
 
     llvm::LLVMContext* getContext() const {
-      return parent->getContext();
+        return parent->getContext();
     }
 
     llvm::Module* getModule() const {
@@ -112,12 +135,10 @@ struct cg_function {
         return fn;
     }
 
-
     std::string getName(const decl* d) {
         return parent->getName(d);
     }
 
-
     llvm::Type* getType(const type* t) {
         return parent->getType(t);
     }
@@ -130,9 +151,8 @@ struct cg_function {
         return parent->getType(t);
     }
 
-
     void declare(const decl* x, llvm::Value* v);
-    
+
     llvm::Value* lookup(const decl* x) const;
 
     void define();
@@ -141,15 +161,19 @@ struct cg_function {
         return entry;
     }
 
-    llvm::BasiBlock* getCurrentBlock() const {
+    llvm::BasicBlock* getCurrentBlock() const {
         return curr;
     }
 
     llvm::BasicBlock* makeBlock(const char* label);
 
-
     void emitBlock(llvm::BasicBlock* bb);
 
+    void emitBranch(llvm::BasicBlock* bb);
+
+    llvm::AllocaInst* makeAlloca(llvm::Type* t, const std::string& name);
+
+    void checkDivisor(llvm::Value* v);
 
     llvm::Value* generateExpr(const expr* e);
     llvm::Value* generateBoolExpr(const bool_expr* e);
@@ -158,49 +182,33 @@ struct cg_function {
     llvm::Value* generateIdExpr(const id_expr* e);
 
     llvm::Value* generateUnopExpr(const unop_expr* e);
-    llvm::Value* generateArithmeticExpr(const unop_expr* e);
-    llvm::Value* generateIntExpr(const unop_expr* e);
-    llvm::Value* generateFloatExpr(const unop_expr* e);
-    llvm::Value* generateBitwiseExpr(const unop_expr* e);
-    llvm::Value* generateLogicalExpr(const unop_expr* e);
-    llvm::Value* generateAddressExpr(const unop_expr* e);
-    llvm::Value* generateDerefExpr(const unop_expr* e);
 
     llvm::Value* generateBinopExpr(const binop_expr* e);
-    llvm::Value* generateArithmeticExpr(const binop_expr* e);
-    llvm::Value* genetateIntExpr(const binop_expr* e);
-    llvm::Value* generateFloatExpr(const binop_expr* e);
-    llvm::Value* generateBitwiseExpr(const binop_expr* e);
+    llvm::Value* generateIntExpr(binop op, llvm::Value* lhs, llvm::Value* rhs);
+    llvm::Value* generateDivisionExpr(binop op, llvm::Value* lhs, llvm::Value* rhs);
+    llvm::Value* generateFloatExpr(binop op, llvm::Value* lhs, llvm::Value* rhs);
     llvm::Value* generateLogicalExpr(const binop_expr* e);
-    llvm::Value* generateAndExpr(const binop_expr* e);
-    llvm::Value* generateOrExpr(const binop_expr* e);
     llvm::Value* generateRelationalExpr(const binop_expr* e);
 
     llvm::Value* generateCallExpr(const call_expr* e);
-    llvm::value* generateIndexExpr(const index_expr* e);
+    llvm::Value* generateIndexExpr(const index_expr* e);
     llvm::Value* generateCondExpr(const cond_expr* e);
     llvm::Value* generateAssignExpr(const assign_expr* e);
     llvm::Value* generateConvExpr(const conv_expr* e);
 
-
     void generateStmt(const stmt* s);
     void generateBlockStmt(const block_stmt* s);
     void generateWhenStmt(const when_stmt* s);
     void generateIfStmt(const if_stmt* s);
     void generateWhileStmt(const while_stmt* s);
-    void generarteBreakStmt(const break_stmt* s);
+    void generateBreakStmt(const break_stmt* s);
     void generateContStmt(const cont_stmt* s);
     void generateRetStmt(const ret_stmt* s);
     void generateDeclStmt(const decl_stmt* s);
     void generateExprStmt(const expr_stmt* s);
 
-    void generateDecl(const decl* d);
-    void generateVarDecl(const var_decl* d);
-
-
     void makeVariable(const var_decl* d);
-    void makeReference(const var_decl* d);
-
+    void makeValue(const object_decl* d);
 
     cg_module* parent;
 
@@ -212,32 +220,52 @@ struct cg_function {
 
     llvm::BasicBlock* curr;
 
+    llvm::BasicBlock* trap;
+
+    llvm::IRBuilder<> ir;
+
     variable_map locals;
+
+    std::vector<cg_loop> loops;
 };
 
-std::string cg_context::getType(const type* t) {
+std::string cg_context::getName(const decl* d) {
+    return std::string(d->getName()->str());
+}
 
-  switch (t->getKind()) {
-    case type::bool_kind:
-      return getBoolType(static_cast<const bool_type*>(t));
+//Functions and globals get a prefix that no C name has, so a function
+//named like a library one (abs, sqrtf) is not compiled as that builtin.
+//Only main keeps its name, since it is the entry point.
+std::string cg_context::getGlobalName(const decl* d) {
+    std::string n = getName(d);
+    if (d->getKind() == decl::fn_kind && n == "main") {
+        return n;
+    }
+    return "mc." + n;
+}
 
-    case type::char_kind:
-      return getCharType(static_cast<const char_type*>(t));
-    case type::int_kind:
-      return getIntType(static_cast<const int_type*>(t));
-    case type::float_kind:
-      return getFloatType(static_cast<const float_type*>(t));
-    case ref_kind:
-      return getRefType(static_cast<const ref_type*>(t));
-    case type::fn_kind:
-      return getFnType(static_cast<const fn_type*>(t));
-    default:
-      throw std::logic_error("Not a valid type");
-  }
+llvm::Type* cg_context::getType(const type* t) {
+    switch (t->getKind()) {
+      case type::bool_kind:
+        return getBoolType(static_cast<const bool_type*>(t));
+      case type::char_kind:
+        return getCharType(static_cast<const char_type*>(t));
+      case type::int_kind:
+        return getIntType(static_cast<const int_type*>(t));
+      case type::float_kind:
+        return getFloatType(static_cast<const float_type*>(t));
+      case type::ptr_kind:
+        return getPtrType(static_cast<const ptr_type*>(t));
+      case type::ref_kind:
+        return getRefType(static_cast<const ref_type*>(t));
+      case type::fn_kind:
+        return getFnType(static_cast<const fn_type*>(t));
+    }
+    throw std::logic_error("Not a valid type");
 }
 
 llvm::Type* cg_context::getBoolType(const bool_type* t) {
-  return llvm::Type::getInt1Ty(*ll);
+    return llvm::Type::getInt1Ty(*ll);
 }
 
 llvm::Type* cg_context::getCharType(const char_type* t) {
@@ -252,118 +280,168 @@ llvm::Type* cg_context::getFloatType(const float_type* t) {
     return llvm::Type::getFloatTy(*ll);
 }
 
-llvm::Type* cg_context::getRefTyppe(const ref_type* t) {
-    llvm::Type* obj = getType(->getObjectType());
-    return obj->getPointerTo();
+llvm::Type* cg_context::getPtrType(const ptr_type* t) {
+    return getType(t->getElementType())->getPointerTo();
 }
 
+llvm::Type* cg_context::getRefType(const ref_type* t) {
+    return getType(t->getObjectType())->getPointerTo();
+}
 
-llvm::Type* cg_contexxt::getFnType(const fn_type* t) {
-    const type_list& ps = t->getParameterTypes();
-    std::vector<llvm::Type*> parms(ps.size());
-    std::transform(ps.begin(), ps.end(), parms,begin(), [this](const type* p) {
-        return getType(p);
-        });
+llvm::Type* cg_context::getFnType(const fn_type* t) {
+    return getFunctionType(t)->getPointerTo();
+}
+
+llvm::FunctionType* cg_context::getFunctionType(const fn_type* t) {
+    std::vector<llvm::Type*> parms;
+    for (const type* p : t->getParameterTypes()) {
+        parms.push_back(getType(p));
+    }
     llvm::Type* ret = getType(t->getReturnType());
-    llvm::Type* base = llvm::FunctionType::get(ret, parms, false);
-    return base->getPointerTo();
+    return llvm::FunctionType::get(ret, parms, false);
 }
 
 llvm::Type* cg_context::getType(const typed_decl* d) {
     return getType(d->getType());
 }
 
+llvm::Constant* cg_context::getValue(const const_value& v) {
+    switch (v.kind) {
+      case type::bool_kind:
+        return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*ll), v.b);
+      case type::char_kind:
+        return llvm::ConstantInt::get(llvm::Type::getInt8Ty(*ll), v.c, true);
+      case type::int_kind:
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ll), v.i, true);
+      case type::float_kind:
+        return llvm::ConstantFP::get(llvm::Type::getFloatTy(*ll), v.f);
+      default:
+        throw std::logic_error("Not a valid constant");
+    }
+}
+
 
-cg_module::cg_module(cg_context& cxt, const prog_decl8 prog) : parent(&cxt), prog(prog), mod(new llvm::Module("a.ll", *getContext())) {}
+cg_module::cg_module(cg_context& cxt, const prog_decl* prog) : parent(&cxt), prog(prog), mod(new llvm::Module("a.ll", *getContext())) {}
 
-void cg_module::declare(const decl* d, llvm::GlobalValue* v) {
+void cg_module::declare(const decl* d, llvm::Value* v) {
     assert(globals.count(d) == 0);
-    globals.exmplace(d, v);
+    globals.emplace(d, v);
 }
 
-
-llvm::GlobalValue* cg_module::lookup(const decl* d) const {
+llvm::Value* cg_module::lookup(const decl* d) const {
     auto iter = globals.find(d);
     if (iter != globals.end()) {
-        return llvm::cast<llvm::GLobalValue>(iter->second);
+        return iter->second;
     } else {
         return nullptr;
     }
 }
 
-
+//Every global is declared before any function body is lowered, so a body
+//can refer to anything in the module.
 void cg_module::generate() {
     for (const decl* d : prog->getDeclarations()) {
-        generate(d);
+        declareGlobal(d, true);
+    }
+    for (const decl* d : prog->getDeclarations()) {
+        if (d->getKind() == decl::fn_kind) {
+            generateFnDecl(static_cast<const fn_decl*>(d));
+        }
     }
 }
 
+//Lowers one part of a program split across modules: the functions in
+//[first, last), plus declarations of whatever they use from the rest.
+//Exactly one part is the owner, which defines the global variables.
+void cg_module::generate(const fn_decl* const* first, const fn_decl* const* last, bool owner) {
+    for (const decl* d : prog->getDeclarations()) {
+        declareGlobal(d, owner);
+    }
+    for (; first != last; ++first) {
+        generateFnDecl(*first);
+    }
+    removeUnusedDeclarations();
+}
 
-void cg_module:;generate(const decl* d) {
-    switch(d->getKind()) {
-        case decl::var_kind:
-          return generateVarDecl(static_cast<const var_decl*>(d));
-        case decl::fn_kind:
-          return generateFnDecl(static_cast<const fn_decl*>(d));
-        default:
-          throw std::logic_error("Not a valid declaration");
+void cg_module::declareGlobal(const decl* d, bool define) {
+    switch (d->getKind()) {
+      case decl::var_kind:
+      case decl::const_kind:
+      case decl::value_kind:
+        return generateVarDecl(static_cast<const object_decl*>(d), define);
+      case decl::fn_kind:
+        return declareFnDecl(static_cast<const fn_decl*>(d));
+      default:
+        throw std::logic_error("Not a valid declaration");
     }
 }
 
-void cg_module::generateVarDecl(const var_decl* d) {
-    std::string n = getName(d);
-    llvm::Type* t = getType(d->getType());
-    llvm::Constant* c = llvm::Constant::getNullValuet(t);
-    llvm::GLobalVariable* var = new llvm::GlobalVariable( *mod, t, false, llvm::GlobalVariable::ExternalLinkage, c, n);
+//The initializers of globals were evaluated during semantic analysis.
+void cg_module::generateVarDecl(const object_decl* d, bool define) {
+    assert(d->hasValue());
+    std::string n = parent->getGlobalName(d);
+    llvm::Type* t = getType(d);
+    llvm::Constant* c = define ? parent->getValue(d->getValue()) : nullptr;
+    bool constant = d->getKind() != decl::var_kind;
+    llvm::GlobalVariable* var = new llvm::GlobalVariable(*mod, t, constant, llvm::GlobalVariable::ExternalLinkage, c, n);
 
     declare(d, var);
 }
 
+void cg_module::declareFnDecl(const fn_decl* d) {
+    std::string n = parent->getGlobalName(d);
+    llvm::FunctionType* t = parent->getFunctionType(d->getType());
+    llvm::Function* fn = llvm::Function::Create(t, llvm::Function::ExternalLinkage, n, getModule());
+
+    declare(d, fn);
+}
 
 void cg_module::generateFnDecl(const fn_decl* d) {
+    if (!d->getBody()) {
+        return;
+    }
     cg_function fn(*this, d);
     fn.define();
 }
 
-
-static llvm::FunctionType* getFnType(llvm::Type* t) {
-    assert(llvm::isa<<llvm::PointerType>(t));
-    return llvm::cast<llvm::FunctionType>(t->getPointerElementType());
+void cg_module::removeUnusedDeclarations() {
+    for (llvm::Function& f : llvm::make_early_inc_range(*mod)) {
+        if (f.isDeclaration() && f.use_empty()) {
+            f.eraseFromParent();
+        }
+    }
+    for (llvm::GlobalVariable& g : llvm::make_early_inc_range(mod->globals())) {
+        if (g.isDeclaration() && g.use_empty()) {
+            g.eraseFromParent();
+        }
+    }
 }
 
 
-cg_function::cg_function(cg_module& m, const fn_decl* d) : parent(&m), src(d), fn(), entry(), curr() {
-    std::string n = getName(d);
-    llvm::Type* t = getType(d);
-    fn = llvm::Function::Create(getFnType(t), llvm::Function:;ExternalLinkage, n, getModule());
-
-
-    parent->declare(d, fn);
-
+cg_function::cg_function(cg_module& m, const fn_decl* d) : parent(&m), src(d), fn(), entry(), curr(), trap(), ir(*m.getContext()) {
+    fn = llvm::cast<llvm::Function>(parent->lookup(d));
 
     entry = makeBlock("entry");
     emitBlock(entry);
 
-    llvm::IRBuilder<> ir(getCurrentBlock());
-
+    //Parameters are variables, so each gets a slot; mem2reg removes them.
     assert(d->getParameters().size() == fn->arg_size());
     auto pi = d->getParameters().begin();
     auto ai = fn->arg_begin();
 
     while (ai != fn->arg_end()) {
-        const parm_decl* parm = staic_cast<const parm_decl*>(*pi);
+        const parm_decl* parm = static_cast<const parm_decl*>(*pi);
         llvm::Argument& arg = *ai;
 
         arg.setName(getName(parm));
 
-llvm:Value* var = ir.CreateAlloca(arg.egtType(), nullptr, arg.egtName());
-     decalre(parm, var);
+        llvm::Value* var = makeAlloca(arg.getType(), getName(parm));
+        declare(parm, var);
 
-     ir.CreateStore(&arg, var);
-     ++ai;
-     ++pi;
+        ir.CreateStore(&arg, var);
+        ++ai;
+        ++pi;
     }
-
 }
 
 void cg_function::declare(const decl* d, llvm::Value* v) {
@@ -371,7 +449,6 @@ void cg_function::declare(const decl* d, llvm::Value* v) {
     locals.emplace(d, v);
 }
 
-
 llvm::Value* cg_function::lookup(const decl* d) const {
     auto iter = locals.find(d);
     if (iter != locals.end()) {
@@ -381,22 +458,113 @@ llvm::Value* cg_function::lookup(const decl* d) const {
     }
 }
 
-llvm::BasicBlock* cg_function::make_block(const char* label) {
-    return llvm::BasicBlock::Create(*get_context(), label);
+llvm::BasicBlock* cg_function::makeBlock(const char* label) {
+    return llvm::BasicBlock::Create(*getContext(), label);
 }
 
-void cg_function::emit_block(llvm::BasicBlock* bb) {
+void cg_function::emitBlock(llvm::BasicBlock* bb) {
     bb->insertInto(getFunction());
     curr = bb;
+    ir.SetInsertPoint(bb);
+}
+
+//Falls through into 'bb' unless the current block already ended.
+void cg_function::emitBranch(llvm::BasicBlock* bb) {
+    if (!curr->getTerminator()) {
+        ir.CreateBr(bb);
+    }
+}
+
+//Slots go at the top of the entry block, where mem2reg looks for them,
+//in the order they are declared.
+llvm::AllocaInst* cg_function::makeAlloca(llvm::Type* t, const std::string& name) {
+    auto pos = entry->begin();
+    while (pos != entry->end() && llvm::isa<llvm::AllocaInst>(*pos)) {
+        ++pos;
+    }
+    llvm::IRBuilder<> tmp(entry, pos);
+    return tmp.CreateAlloca(t, nullptr, name);
+}
+
+//Every check in a function that fails at run time branches to the same
+//block, made on first use and cached in 'trap'. Both lowerings use it.
+static llvm::BasicBlock* getTrapBlock(llvm::Function* fn, llvm::BasicBlock*& trap) {
+    if (!trap) {
+        trap = llvm::BasicBlock::Create(fn->getContext(), "trap", fn);
+        llvm::IRBuilder<> tmp(trap);
+        tmp.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+        tmp.CreateUnreachable();
+    }
+    return trap;
+}
+
+//Only a divisor known to be nonzero needs no check.
+static bool mayBeZero(llvm::Value* v) {
+    auto* c = llvm::dyn_cast<llvm::ConstantInt>(v);
+    return !c || c->isZero();
+}
+
+//INT_MIN / -1 wraps and INT_MIN % -1 is 0, but both are undefined for
+//sdiv and srem, so a divisor of -1 is replaced by 1 and the result fixed
+//up. Constant divisors fold all of this away. The caller has already
+//checked the divisor against zero.
+static llvm::Value* createDivision(llvm::IRBuilder<>& ir, bool quo, llvm::Value* lhs, llvm::Value* rhs) {
+    llvm::Type* t = rhs->getType();
+    llvm::Value* minus_one = ir.CreateICmpEQ(rhs, llvm::ConstantInt::get(t, -1, true));
+    llvm::Value* d = ir.CreateSelect(minus_one, llvm::ConstantInt::get(t, 1), rhs);
+    if (quo) {
+        return ir.CreateSelect(minus_one, ir.CreateNeg(lhs), ir.CreateSDiv(lhs, d));
+    }
+    return ir.CreateSelect(minus_one, llvm::ConstantInt::get(t, 0), ir.CreateSRem(lhs, d));
+}
+
+//Compares two values of type 't'; 'n' is the position of the operator in
+//==, !=, <, >, <=, >=. Chars and ints compare as signed numbers, bools
+//and functions as unsigned ones. Float comparisons are false when either
+//side is NaN, except for != which is true.
+static llvm::Value* createComparison(llvm::IRBuilder<>& ir, const type* t, std::size_t n, llvm::Value* lhs, llvm::Value* rhs) {
+    static const llvm::CmpInst::Predicate fp[] = {
+      llvm::CmpInst::FCMP_OEQ, llvm::CmpInst::FCMP_UNE, llvm::CmpInst::FCMP_OLT,
+      llvm::CmpInst::FCMP_OGT, llvm::CmpInst::FCMP_OLE, llvm::CmpInst::FCMP_OGE,
+    };
+    static const llvm::CmpInst::Predicate sp[] = {
+      llvm::CmpInst::ICMP_EQ, llvm::CmpInst::ICMP_NE, llvm::CmpInst::ICMP_SLT,
+      llvm::CmpInst::ICMP_SGT, llvm::CmpInst::ICMP_SLE, llvm::CmpInst::ICMP_SGE,
+    };
+    static const llvm::CmpInst::Predicate up[] = {
+      llvm::CmpInst::ICMP_EQ, llvm::CmpInst::ICMP_NE, llvm::CmpInst::ICMP_ULT,
+      llvm::CmpInst::ICMP_UGT, llvm::CmpInst::ICMP_ULE, llvm::CmpInst::ICMP_UGE,
+    };
+    switch (t->getKind()) {
+      case type::float_kind:
+        return ir.CreateFCmp(fp[n], lhs, rhs);
+      case type::char_kind:
+      case type::int_kind:
+        return ir.CreateICmp(sp[n], lhs, rhs);
+      default:
+        return ir.CreateICmp(up[n], lhs, rhs);
+    }
+}
+
+void cg_function::checkDivisor(llvm::Value* v) {
+    if (!mayBeZero(v)) {
+        return;
+    }
+    llvm::BasicBlock* ok = makeBlock("div.ok");
+    llvm::Value* zero = llvm::ConstantInt::get(v->getType(), 0);
+    ir.CreateCondBr(ir.CreateICmpEQ(v, zero), getTrapBlock(fn, trap), ok);
+    emitBlock(ok);
 }
 
+//A function that runs off its end returns zero.
 void cg_function::define() {
     generateStmt(src->getBody());
+    if (!curr->getTerminator()) {
+        ir.CreateRet(llvm::Constant::getNullValue(fn->getReturnType()));
+    }
 }
 
 
-//Determine which base xpression type it is, and go from there
-
 llvm::Value* cg_function::generateExpr(const expr* e) {
     switch (e->getKind()) {
       case expr::bool_kind:
@@ -415,164 +583,933 @@ llvm::Value* cg_function::generateExpr(const expr* e) {
         return generateCallExpr(static_cast<const call_expr*>(e));
       case expr::index_kind:
         return generateIndexExpr(static_cast<const index_expr*>(e));
+      case expr::cast_kind:
+        //The operand was already converted to the target type.
+        return generateExpr(static_cast<const cast_expr*>(e)->m_src);
       case expr::cond_kind:
         return generateCondExpr(static_cast<const cond_expr*>(e));
       case expr::assign_kind:
         return generateAssignExpr(static_cast<const assign_expr*>(e));
       case expr::conv_kind:
-        return genreateConvExpr(static_cast<const conv_expr*>(e));
+        return generateConvExpr(static_cast<const conv_expr*>(e));
       default:
-        throw std::runtime_error("not avalid expression");
+        throw std::runtime_error("not a valid expression");
     }
 }
 
 llvm::Value* cg_function::generateBoolExpr(const bool_expr* e) {
-    return llvm::ConstantInt::get(getType(e), e->getValue(), false);
+    return llvm::ConstantInt::get(getType(e), e->val, false);
 }
 
 llvm::Value* cg_function::generateIntExpr(const int_expr* e) {
-    return llvm::ConstantInt::get(getType(e), e->getValue(), true);
+    return llvm::ConstantInt::get(getType(e), e->val, true);
 }
 
 llvm::Value* cg_function::generateFloatExpr(const float_expr* e) {
-    return llvm::ConstantFP::get(getType(e), e->getValue());
+    return llvm::ConstantFP::get(getType(e), e->val);
 }
 
+//Variables and parameters name their slot. Constants with a compile-time
+//value are emitted in place; other local constants name the value they
+//were initialized with.
 llvm::Value* cg_function::generateIdExpr(const id_expr* e) {
-  decl* ref = e->ref;
-  switch (ref->getKind()) {
-    case const_kind:
-        return llvm::ConstantExpr::get(getType(ref), e->getInit());
-    case var_kind:
-      return generateVarDecl(static_cast<const var_decl*>(e));
-    case fn_kind:
-      return generateFnDecl(static_cast<const fn_decl*>(e));
-    default:
-      throw std::runtime_error("not a valid ID EXPR");
-  }
+    const decl* ref = e->ref;
+    switch (ref->getKind()) {
+      case decl::const_kind:
+      case decl::value_kind: {
+        const object_decl* obj = static_cast<const object_decl*>(ref);
+        if (obj->hasValue()) {
+            return parent->parent->getValue(obj->getValue());
+        }
+        return lookup(ref);
+      }
+      case decl::var_kind:
+      case decl::parm_kind:
+      case decl::fn_kind:
+        return lookup(ref);
+      default:
+        throw std::runtime_error("not a valid id expression");
+    }
 }
 
 llvm::Value* cg_function::generateUnopExpr(const unop_expr* e) {
-  unop* op = unop_expr->m_op;
-  expr* exp = unop_expr->m_arg;
-  llvm::Constant cons = 
-  switch (op) {
-    case uo_pos:
-        //The + unary op does not have any effect by itself, let it pass.
-        return cg_function::generateExpr(exp);
-    case uo_neg:
-        //Should function like 0 - expr
-        expr* zeroExpr = new int_expr(exp->getType(), 0);
-        expr* binopExpr = new binop_expr(exp->getType(), bo_sub, exp, zeroExpr);
-        return cg_function::generateBinopExpr(binopExpr);
-    case uo_not:
-    case uo_cmp:
-    case uo_addr:
-    case uo_deref:
-        return generateDerefExpr(e);
-        return 
-  }
-}
-
-llvm::Value* cg_function::generateDerefExpr(const unop_expr* e) {
-    return nullptr;
+    llvm::Value* v = generateExpr(e->m_arg);
+    switch (e->m_op) {
+      case uo_pos:
+        return v;
+      case uo_neg:
+        if (v->getType()->isFloatingPointTy()) {
+            return ir.CreateFNeg(v);
+        }
+        return ir.CreateNeg(v);
+      case uo_cmp:
+      case uo_not:
+        return ir.CreateNot(v);
+      default:
+        throw std::runtime_error("not implemented in this compiler version");
+    }
 }
 
 llvm::Value* cg_function::generateBinopExpr(const binop_expr* e) {
-    return nullptr;
+    switch (e->m_op) {
+      case bo_land:
+      case bo_lor:
+        return generateLogicalExpr(e);
+      case bo_eq:
+      case bo_ne:
+      case bo_lt:
+      case bo_gt:
+      case bo_le:
+      case bo_ge:
+        return generateRelationalExpr(e);
+      default:
+        break;
+    }
+
+    llvm::Value* lhs = generateExpr(e->m_lhs);
+    llvm::Value* rhs = generateExpr(e->m_rhs);
+    if (lhs->getType()->isFloatingPointTy()) {
+        return generateFloatExpr(e->m_op, lhs, rhs);
+    }
+    return generateIntExpr(e->m_op, lhs, rhs);
+}
+
+//Ints wrap, so none of these carry nsw. Only the low five bits of a
+//shift count are used.
+llvm::Value* cg_function::generateIntExpr(binop op, llvm::Value* lhs, llvm::Value* rhs) {
+    switch (op) {
+      case bo_add:
+        return ir.CreateAdd(lhs, rhs);
+      case bo_sub:
+        return ir.CreateSub(lhs, rhs);
+      case bo_mul:
+        return ir.CreateMul(lhs, rhs);
+      case bo_quo:
+      case bo_rem:
+        return generateDivisionExpr(op, lhs, rhs);
+      case bo_and:
+        return ir.CreateAnd(lhs, rhs);
+      case bo_ior:
+        return ir.CreateOr(lhs, rhs);
+      case bo_xor:
+        return ir.CreateXor(lhs, rhs);
+      case bo_shl:
+        return ir.CreateShl(lhs, ir.CreateAnd(rhs, 31));
+      case bo_shr:
+        return ir.CreateAShr(lhs, ir.CreateAnd(rhs, 31));
+      default:
+        throw std::logic_error("not an int operation");
+    }
+}
+
+//Division by zero traps.
+llvm::Value* cg_function::generateDivisionExpr(binop op, llvm::Value* lhs, llvm::Value* rhs) {
+    checkDivisor(rhs);
+    return createDivision(ir, op == bo_quo, lhs, rhs);
+}
+
+llvm::Value* cg_function::generateFloatExpr(binop op, llvm::Value* lhs, llvm::Value* rhs) {
+    switch (op) {
+      case bo_add:
+        return ir.CreateFAdd(lhs, rhs);
+      case bo_sub:
+        return ir.CreateFSub(lhs, rhs);
+      case bo_mul:
+        return ir.CreateFMul(lhs, rhs);
+      case bo_quo:
+        return ir.CreateFDiv(lhs, rhs);
+      case bo_rem:
+        return ir.CreateFRem(lhs, rhs);
+      default:
+        throw std::logic_error("not a float operation");
+    }
+}
+
+//The right operand is only evaluated when the left one does not decide
+//the result.
+llvm::Value* cg_function::generateLogicalExpr(const binop_expr* e) {
+    bool is_and = e->m_op == bo_land;
+    llvm::Value* lhs = generateExpr(e->m_lhs);
+    llvm::BasicBlock* from = curr;
+    llvm::BasicBlock* rhs_bb = makeBlock(is_and ? "and.rhs" : "or.rhs");
+    llvm::BasicBlock* end = makeBlock(is_and ? "and.end" : "or.end");
+    if (is_and) {
+        ir.CreateCondBr(lhs, rhs_bb, end);
+    } else {
+        ir.CreateCondBr(lhs, end, rhs_bb);
+    }
+
+    emitBlock(rhs_bb);
+    llvm::Value* rhs = generateExpr(e->m_rhs);
+    rhs_bb = curr;
+    ir.CreateBr(end);
+
+    emitBlock(end);
+    llvm::PHINode* phi = ir.CreatePHI(lhs->getType(), 2);
+    phi->addIncoming(ir.getInt1(!is_and), from);
+    phi->addIncoming(rhs, rhs_bb);
+    return phi;
 }
 
 llvm::Value* cg_function::generateRelationalExpr(const binop_expr* e) {
-    return nullptr;
+    llvm::Value* lhs = generateExpr(e->m_lhs);
+    llvm::Value* rhs = generateExpr(e->m_rhs);
+    return createComparison(ir, e->m_lhs->getType(), e->m_op - bo_eq, lhs, rhs);
 }
 
 llvm::Value* cg_function::generateCallExpr(const call_expr* e) {
-    return nullptr;
+    const fn_type* t = static_cast<const fn_type*>(e->m_base->getType());
+    llvm::FunctionType* ft = parent->parent->getFunctionType(t);
+    llvm::Value* callee = generateExpr(e->m_base);
+
+    std::vector<llvm::Value*> args;
+    args.reserve(e->m_args.size());
+    for (const expr* a : e->m_args) {
+        args.push_back(generateExpr(a));
+    }
+    return ir.CreateCall(ft, callee, args);
 }
 
-llvm::Value* cg_function::generateIndexExpr(const index_expr* e) {
-    return nullptr;
+llvm::Value* cg_function::generateIndexExpr(const index_expr*) {
+    throw std::runtime_error("not implemented in this compiler version");
 }
 
+//The value is computed before the object it is stored to. The result is
+//the object itself.
 llvm::Value* cg_function::generateAssignExpr(const assign_expr* e) {
-    return nullptr;
+    llvm::Value* rhs = generateExpr(e->m_rhs);
+    llvm::Value* lhs = generateExpr(e->m_lhs);
+    ir.CreateStore(rhs, lhs);
+    return lhs;
 }
 
 llvm::Value* cg_function::generateCondExpr(const cond_expr* e) {
-    return nullptr;
+    llvm::Value* c = generateExpr(e->m_cond);
+    llvm::BasicBlock* t_bb = makeBlock("cond.true");
+    llvm::BasicBlock* f_bb = makeBlock("cond.false");
+    llvm::BasicBlock* end = makeBlock("cond.end");
+    ir.CreateCondBr(c, t_bb, f_bb);
+
+    emitBlock(t_bb);
+    llvm::Value* t = generateExpr(e->m_true);
+    t_bb = curr;
+    ir.CreateBr(end);
+
+    emitBlock(f_bb);
+    llvm::Value* f = generateExpr(e->m_false);
+    f_bb = curr;
+    ir.CreateBr(end);
+
+    emitBlock(end);
+    llvm::PHINode* phi = ir.CreatePHI(t->getType(), 2);
+    phi->addIncoming(t, t_bb);
+    phi->addIncoming(f, f_bb);
+    return phi;
 }
 
+//Conversions from float to int saturate, with NaN becoming 0.
 llvm::Value* cg_function::generateConvExpr(const conv_expr* c) {
-    return nullptr;
+    llvm::Value* v = generateExpr(c->m_src);
+    llvm::Type* t = getType(c);
+    switch (c->m_conv) {
+      case conv_identity:
+        return v;
+      case conv_value:
+        return ir.CreateLoad(t, v);
+      case conv_bool:
+        if (v->getType()->isFloatingPointTy()) {
+            return ir.CreateFCmpUNE(v, llvm::ConstantFP::get(v->getType(), 0.0));
+        }
+        return ir.CreateIsNotNull(v);
+      case conv_char:
+        return ir.CreateTrunc(v, t);
+      case conv_int:
+        if (c->m_src->getType()->getKind() == type::bool_kind) {
+            return ir.CreateZExt(v, t);
+        }
+        return ir.CreateSExt(v, t);
+      case conv_ext:
+        return ir.CreateSIToFP(v, t);
+      case conv_trunc:
+        return ir.CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {t, v->getType()}, {v});
+    }
+    throw std::logic_error("not a valid conversion");
 }
 
+
 void cg_function::generateStmt(const stmt* s) {
     switch (s->getKind()) {
-    case stmt::block_kind:
-      return generateBlockStmt(static_cast<const block_stmt*>(s));
-    case stmt::when_kind:
-      return generateWhenStmt(static_cast<const when_stmt*>(s));
-    case stmt::if_kind:
-      return generateIfStmt(static_cast<const if_stmt*>(s));
-    case stmt::while_kind:
-      return generateWhileStmt(static_cat<const while_stmt*>(s));
-    case stmt::break_kind:
-      return generateBreakStmt(static_cast<const break_stmt*>(s));
-    case stmt::cont_kind:
-      return generateContStmt(static_cast<const cont_stmt*>(s));
-    case stmt::ret_kind:
-      return generateRetStmt(static_cast<const ret_stmt*>(s));
-    case stmt::decl_kind:
-      return generateDeclStmt(static_cast<const decl_stmt*>(s));
-    case stmt::expr_kind:
-      return generateExprStmt(static_cast<const expr_stmt*>(s));
+      case stmt::block_kind:
+        return generateBlockStmt(static_cast<const block_stmt*>(s));
+      case stmt::when_kind:
+        return generateWhenStmt(static_cast<const when_stmt*>(s));
+      case stmt::if_kind:
+        return generateIfStmt(static_cast<const if_stmt*>(s));
+      case stmt::while_kind:
+        return generateWhileStmt(static_cast<const while_stmt*>(s));
+      case stmt::break_kind:
+        return generateBreakStmt(static_cast<const break_stmt*>(s));
+      case stmt::cont_kind:
+        return generateContStmt(static_cast<const cont_stmt*>(s));
+      case stmt::ret_kind:
+        return generateRetStmt(static_cast<const ret_stmt*>(s));
+      case stmt::decl_kind:
+        return generateDeclStmt(static_cast<const decl_stmt*>(s));
+      case stmt::expr_kind:
+        return generateExprStmt(static_cast<const expr_stmt*>(s));
     }
 }
 
+//Statements after a jump can never run, so they are not lowered.
 void cg_function::generateBlockStmt(const block_stmt* s) {
-
+    for (const stmt* s1 : s->getStatements()) {
+        if (curr->getTerminator()) {
+            break;
+        }
+        generateStmt(s1);
+    }
 }
 
 void cg_function::generateWhenStmt(const when_stmt* s) {
+    llvm::Value* c = generateExpr(s->getCondition());
+    llvm::BasicBlock* body = makeBlock("when.body");
+    llvm::BasicBlock* end = makeBlock("when.end");
+    ir.CreateCondBr(c, body, end);
+
+    emitBlock(body);
+    generateStmt(s->getBody());
+    emitBranch(end);
 
+    emitBlock(end);
 }
 
 void cg_function::generateIfStmt(const if_stmt* s) {
+    llvm::Value* c = generateExpr(s->getCondition());
+    llvm::BasicBlock* t = makeBlock("if.then");
+    llvm::BasicBlock* f = s->getFalseBranch() ? makeBlock("if.else") : nullptr;
+    llvm::BasicBlock* end = makeBlock("if.end");
+    ir.CreateCondBr(c, t, f ? f : end);
+
+    emitBlock(t);
+    generateStmt(s->getTrueBranch());
+    emitBranch(end);
+
+    if (f) {
+        emitBlock(f);
+        generateStmt(s->getFalseBranch());
+        emitBranch(end);
+    }
 
+    emitBlock(end);
 }
 
 void cg_function::generateWhileStmt(const while_stmt* s) {
+    llvm::BasicBlock* cond = makeBlock("while.cond");
+    llvm::BasicBlock* body = makeBlock("while.body");
+    llvm::BasicBlock* end = makeBlock("while.end");
+    emitBranch(cond);
+
+    emitBlock(cond);
+    llvm::Value* c = generateExpr(s->getCondition());
+    ir.CreateCondBr(c, body, end);
+
+    emitBlock(body);
+    loops.push_back({end, cond});
+    generateStmt(s->getBody());
+    loops.pop_back();
+    emitBranch(cond);
+
+    emitBlock(end);
+}
+
+void cg_function::generateBreakStmt(const break_stmt*) {
+    if (loops.empty()) {
+        throw std::runtime_error("break outside of a loop");
+    }
+    ir.CreateBr(loops.back().brk);
+}
+
+void cg_function::generateContStmt(const cont_stmt*) {
+    if (loops.empty()) {
+        throw std::runtime_error("continue outside of a loop");
+    }
+    ir.CreateBr(loops.back().cont);
+}
+
+void cg_function::generateRetStmt(const ret_stmt* s) {
+    ir.CreateRet(generateExpr(s->m_val));
+}
+
+void cg_function::generateDeclStmt(const decl_stmt* s) {
+    const decl* d = s->m_decl;
+    switch (d->getKind()) {
+      case decl::var_kind:
+        return makeVariable(static_cast<const var_decl*>(d));
+      case decl::const_kind:
+      case decl::value_kind:
+        return makeValue(static_cast<const object_decl*>(d));
+      default:
+        throw std::runtime_error("not a valid local declaration");
+    }
+}
 
+void cg_function::generateExprStmt(const expr_stmt* s) {
+    generateExpr(s->m_expr);
 }
 
-void cg_function::generateBreakStmt(const break_stmt* e) {
+//A variable without an initializer starts out as zero.
+void cg_function::makeVariable(const var_decl* d) {
+    llvm::Type* t = getType(d);
+    llvm::Value* init = d->getInit() ? generateExpr(d->getInit()) : llvm::Constant::getNullValue(t);
+    llvm::AllocaInst* var = makeAlloca(t, getName(d));
+    declare(d, var);
+    ir.CreateStore(init, var);
+}
 
+//Constants never change, so they need no slot. Those evaluated at
+//compile time are emitted where they are used.
+void cg_function::makeValue(const object_decl* d) {
+    if (d->hasValue()) {
+        return;
+    }
+    llvm::Value* v = generateExpr(d->getInit());
+    if (!llvm::isa<llvm::Constant>(v)) {
+        v->setName(getName(d));
+    }
+    declare(d, v);
 }
 
-void cg_function::generateContStmt(const cont_stmt* e) {
 
+//An invalid module is a bug in the lowering, not in the program.
+static void verify(const llvm::Module& mod) {
+    std::string msg;
+    llvm::raw_string_ostream os(msg);
+    if (llvm::verifyModule(mod, &os)) {
+        throw std::logic_error("generated an invalid module: " + os.str());
+    }
 }
 
-void cg_function::generateRetStmt(const ret_stmt* e) {
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& ll, const decl* d) {
+    assert(d->getKind() == decl::prog_kind);
 
+    cg_context cxt(ll);
+    cg_module mod(cxt, static_cast<const prog_decl*>(d));
+    mod.generate();
+    verify(*mod.getModule());
+    return mod.release();
 }
 
-void cg_function::generateDeclStmt(const decl_stmt* e) {
+//Lowers one function of an ir_program. Values are mapped as their
+//definitions are reached, which in layout order is before any use but a
+//phi's, so phis get their incoming values once every block is done.
+struct cg_ir_function {
+    cg_ir_function(cg_module& m, const ir_function& f);
+
+    llvm::LLVMContext* getContext() const {
+        return parent->getContext();
+    }
+
+    llvm::Type* getType(const type* t) {
+        return parent->getType(t);
+    }
+
+    void define();
+
+    llvm::Value* getValue(const ir_value* v);
+
+    llvm::Value* generateInsn(const ir_insn* i);
+    llvm::Value* generateDivision(const ir_insn* i);
+    llvm::Value* generateComparison(const ir_insn* i);
+
+    cg_module* parent;
+
+    const ir_function* src;
+
+    llvm::Function* fn;
+
+    llvm::BasicBlock* trap;
+
+    llvm::IRBuilder<> ir;
+
+    std::unordered_map<const ir_value*, llvm::Value*> values;
+
+    //The first and last LLVM block of each IR block, by id. Checks that
+    //trap split a block in two.
+    std::vector<llvm::BasicBlock*> firsts;
+    std::vector<llvm::BasicBlock*> lasts;
+};
 
+cg_ir_function::cg_ir_function(cg_module& m, const ir_function& f) : parent(&m), src(&f), fn(), trap(), ir(*m.getContext()) {
+    fn = llvm::cast<llvm::Function>(parent->lookup(f.getDecl()));
+    for (const ir_param* p : f.getParams()) {
+        llvm::Argument* arg = fn->getArg(p->index);
+        arg->setName(parent->getName(p->var));
+        values.emplace(p, arg);
+    }
 }
 
+void cg_ir_function::define() {
+    const std::vector<ir_block*>& blocks = src->getBlocks();
+    std::uint32_t n = 0;
+    for (const ir_block* b : blocks) {
+        n = std::max(n, b->id + 1);
+    }
+    firsts.assign(n, nullptr);
+    lasts.assign(n, nullptr);
+    for (const ir_block* b : blocks) {
+        firsts[b->id] = llvm::BasicBlock::Create(*getContext(), b == blocks[0] ? "entry" : "", fn);
+    }
+
+    for (const ir_block* b : blocks) {
+        ir.SetInsertPoint(firsts[b->id]);
+        for (const ir_insn* i = b->first; i; i = i->next) {
+            llvm::Value* v = generateInsn(i);
+            if (i->ty) {
+                values.emplace(i, v);
+            }
+        }
+        lasts[b->id] = ir.GetInsertBlock();
+    }
 
-void cg_function::generateExprStmt(const expr_stmt* e) {
+    for (const ir_block* b : blocks) {
+        for (const ir_insn* i = b->first; i && i->op == ir_phi; i = i->next) {
+            llvm::PHINode* phi = llvm::cast<llvm::PHINode>(values.at(i));
+            for (std::uint32_t k = 0; k != i->num_ops; ++k) {
+                phi->addIncoming(getValue(i->ops[k]), lasts[b->preds[k]->id]);
+            }
+        }
+    }
 
+    //The trap block goes last, as it does for the AST lowering.
+    if (trap) {
+        trap->moveAfter(&fn->back());
+    }
 }
 
-void generate(const decl* d) {
-    assert(d->isProgram());
+//Constants of types without constant_values are null pointers.
+llvm::Value* cg_ir_function::getValue(const ir_value* v) {
+    switch (v->kind) {
+      case ir_value::constant_kind: {
+        const ir_constant* c = static_cast<const ir_constant*>(v);
+        if (c->ty->isPointer() || c->ty->isFunction()) {
+            return llvm::Constant::getNullValue(getType(c->ty));
+        }
+        return parent->parent->getValue(c->value);
+      }
+      case ir_value::global_kind:
+        return parent->lookup(static_cast<const ir_global*>(v)->var);
+      case ir_value::param_kind:
+      case ir_value::insn_kind:
+        return values.at(v);
+    }
+    throw std::logic_error("not a valid IR value");
+}
 
-    cg_context cg;
+llvm::Value* cg_ir_function::generateInsn(const ir_insn* i) {
+    auto op = [&](std::uint32_t n) { return getValue(i->ops[n]); };
+    switch (i->op) {
+      case ir_add:
+        return ir.CreateAdd(op(0), op(1));
+      case ir_sub:
+        return ir.CreateSub(op(0), op(1));
+      case ir_mul:
+        return ir.CreateMul(op(0), op(1));
+      case ir_div:
+      case ir_rem:
+        return generateDivision(i);
+      case ir_band:
+        return ir.CreateAnd(op(0), op(1));
+      case ir_bor:
+        return ir.CreateOr(op(0), op(1));
+      case ir_bxor:
+        return ir.CreateXor(op(0), op(1));
+      case ir_shl:
+        return ir.CreateShl(op(0), ir.CreateAnd(op(1), 31));
+      case ir_shr:
+        return ir.CreateAShr(op(0), ir.CreateAnd(op(1), 31));
+      case ir_fadd:
+        return ir.CreateFAdd(op(0), op(1));
+      case ir_fsub:
+        return ir.CreateFSub(op(0), op(1));
+      case ir_fmul:
+        return ir.CreateFMul(op(0), op(1));
+      case ir_fdiv:
+        return ir.CreateFDiv(op(0), op(1));
+      case ir_frem:
+        return ir.CreateFRem(op(0), op(1));
+      case ir_neg:
+        return ir.CreateNeg(op(0));
+      case ir_bnot:
+        return ir.CreateNot(op(0));
+      case ir_fneg:
+        return ir.CreateFNeg(op(0));
+      case ir_eq:
+      case ir_ne:
+      case ir_lt:
+      case ir_gt:
+      case ir_le:
+      case ir_ge:
+        return generateComparison(i);
+      case ir_tobool: {
+        llvm::Value* v = op(0);
+        if (v->getType()->isFloatingPointTy()) {
+            return ir.CreateFCmpUNE(v, llvm::ConstantFP::get(v->getType(), 0.0));
+        }
+        return ir.CreateIsNotNull(v);
+      }
+      case ir_tochar:
+        return ir.CreateTrunc(op(0), getType(i->ty));
+      case ir_toint:
+        if (i->ops[0]->ty->isBool()) {
+            return ir.CreateZExt(op(0), getType(i->ty));
+        }
+        return ir.CreateSExt(op(0), getType(i->ty));
+      case ir_itof:
+        return ir.CreateSIToFP(op(0), getType(i->ty));
+      case ir_ftoi:
+        return ir.CreateIntrinsic(llvm::Intrinsic::fptosi_sat, {getType(i->ty), getType(i->ops[0]->ty)}, {op(0)});
+      case ir_alloca:
+        return ir.CreateAlloca(getType(i->ty->getObjectType()), nullptr, i->var ? parent->getName(i->var) : "");
+      case ir_load:
+        return ir.CreateLoad(getType(i->ty), op(0));
+      case ir_store:
+        return ir.CreateStore(op(1), op(0));
+      case ir_call: {
+        const fn_type* t = static_cast<const fn_type*>(i->ops[0]->ty);
+        std::vector<llvm::Value*> args;
+        args.reserve(i->num_ops - 1);
+        for (std::uint32_t n = 1; n != i->num_ops; ++n) {
+            args.push_back(op(n));
+        }
+        return ir.CreateCall(parent->parent->getFunctionType(t), op(0), args);
+      }
+      case ir_phi:
+        return ir.CreatePHI(getType(i->ty), i->num_ops, i->var ? parent->getName(i->var) : "");
+      case ir_br:
+        return ir.CreateBr(firsts[i->targets[0]->id]);
+      case ir_condbr:
+        return ir.CreateCondBr(op(0), firsts[i->targets[0]->id], firsts[i->targets[1]->id]);
+      case ir_ret:
+        return ir.CreateRet(op(0));
+    }
+    throw std::logic_error("not a valid IR operation");
+}
 
-    cg_module mod(cg, static_cast<const prog_decl*>(d));
-    mod.generate();
-    
-    llvm::outs() << *mod.getModule();
+//A zero divisor traps, which splits the block.
+llvm::Value* cg_ir_function::generateDivision(const ir_insn* i) {
+    llvm::Value* lhs = getValue(i->ops[0]);
+    llvm::Value* rhs = getValue(i->ops[1]);
+    if (mayBeZero(rhs)) {
+        llvm::BasicBlock* ok = llvm::BasicBlock::Create(*getContext(), "div.ok", fn, ir.GetInsertBlock()->getNextNode());
+        ir.CreateCondBr(ir.CreateICmpEQ(rhs, llvm::ConstantInt::get(rhs->getType(), 0)), getTrapBlock(fn, trap), ok);
+        ir.SetInsertPoint(ok);
+    }
+    return createDivision(ir, i->op == ir_div, lhs, rhs);
+}
+
+llvm::Value* cg_ir_function::generateComparison(const ir_insn* i) {
+    return createComparison(ir, i->ops[0]->ty, i->op - ir_eq, getValue(i->ops[0]), getValue(i->ops[1]));
+}
+
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& ll, const ir_program& prog) {
+    assert(prog.getDecl()->getKind() == decl::prog_kind);
+
+    cg_context cxt(ll);
+    cg_module mod(cxt, static_cast<const prog_decl*>(prog.getDecl()));
+    for (const decl* d : mod.prog->getDeclarations()) {
+        mod.declareGlobal(d, true);
+    }
+    for (const auto& f : prog.getFunctions()) {
+        cg_ir_function fn(mod, *f);
+        fn.define();
+    }
+    verify(*mod.getModule());
+    return mod.release();
+}
+
+std::string getTierEntryName(std::uint32_t fn) {
+    return "mc.tier." + std::to_string(fn);
+}
+
+//An interpreter register.
+static llvm::Type* getSlotType(llvm::LLVMContext& ll) {
+    return llvm::Type::getIntNTy(ll, sizeof(bc_value) * 8);
+}
+
+static llvm::Constant* getAddress(llvm::LLVMContext& ll, const void* p, llvm::Type* t) {
+    llvm::Type* intptr = llvm::Type::getIntNTy(ll, sizeof(void*) * 8);
+    llvm::Constant* addr = llvm::ConstantInt::get(intptr, reinterpret_cast<std::uintptr_t>(p));
+    return llvm::ConstantExpr::getIntToPtr(addr, t);
+}
+
+//Registers hold bools and chars widened to int, at the start of the slot.
+static void storeSlot(llvm::IRBuilder<>& ir, llvm::Value* v, llvm::Value* slot) {
+    if (v->getType()->isIntegerTy(1)) {
+        v = ir.CreateZExt(v, ir.getInt32Ty());
+    } else if (v->getType()->isIntegerTy(8)) {
+        v = ir.CreateSExt(v, ir.getInt32Ty());
+    }
+    ir.CreateStore(v, ir.CreateBitCast(slot, v->getType()->getPointerTo()));
+}
+
+static llvm::Value* loadSlot(llvm::IRBuilder<>& ir, llvm::Type* t, llvm::Value* slot) {
+    llvm::Type* st = t->isIntegerTy() ? ir.getInt32Ty() : t;
+    llvm::Value* v = ir.CreateLoad(st, ir.CreateBitCast(slot, st->getPointerTo()));
+    if (t->isIntegerTy(1)) {
+        return ir.CreateICmpNE(v, ir.getInt32(0));
+    }
+    if (t->isIntegerTy(8)) {
+        return ir.CreateTrunc(v, t);
+    }
+    return v;
+}
+
+//Gives a function the body of a stub that passes its arguments to
+//'link.call' in a frame of its own.
+static void defineTierStub(llvm::Function* f, std::uint32_t index, const tier_link& link) {
+    llvm::LLVMContext& ll = f->getContext();
+    llvm::IRBuilder<> ir(llvm::BasicBlock::Create(ll, "entry", f));
+    llvm::Type* slot = getSlotType(ll);
+    unsigned n = std::max<unsigned>(f->arg_size(), 1);
+    llvm::Value* frame = ir.CreateAlloca(slot, ir.getInt32(n), "frame");
+    for (llvm::Argument& a : f->args()) {
+        storeSlot(ir, &a, ir.CreateConstGEP1_32(slot, frame, a.getArgNo()));
+    }
+
+    llvm::Type* ptr = ir.getInt8PtrTy();
+    llvm::FunctionType* t = llvm::FunctionType::get(ir.getVoidTy(), {ptr, ir.getInt32Ty(), slot->getPointerTo()}, false);
+    llvm::Constant* call = getAddress(ll, reinterpret_cast<const void*>(link.call), t->getPointerTo());
+    llvm::Constant* engine = getAddress(ll, link.engine, ptr);
+    ir.CreateCall(t, call, {engine, ir.getInt32(index), frame});
+    ir.CreateRet(loadSlot(ir, f->getReturnType(), frame));
+    f->setLinkage(llvm::Function::InternalLinkage);
+}
+
+//The entry point takes its arguments from, and leaves its result in, the
+//frame the interpreter set up for the call.
+static void defineTierEntry(llvm::Function* f, std::uint32_t index) {
+    llvm::LLVMContext& ll = f->getContext();
+    llvm::Type* slot = getSlotType(ll);
+    llvm::FunctionType* t = llvm::FunctionType::get(llvm::Type::getVoidTy(ll), {slot->getPointerTo()}, false);
+    llvm::Function* entry = llvm::Function::Create(t, llvm::Function::ExternalLinkage, getTierEntryName(index), f->getParent());
+
+    llvm::IRBuilder<> ir(llvm::BasicBlock::Create(ll, "entry", entry));
+    llvm::Value* frame = entry->getArg(0);
+    std::vector<llvm::Value*> args;
+    for (llvm::Argument& a : f->args()) {
+        args.push_back(loadSlot(ir, a.getType(), ir.CreateConstGEP1_32(slot, frame, a.getArgNo())));
+    }
+    storeSlot(ir, ir.CreateCall(f, args), frame);
+    ir.CreateRetVoid();
+}
+
+//Only direct calls are allowed; anything else would hand a native
+//function pointer to code that expects a function index.
+static void requireDirectCalls(const llvm::Function& f) {
+    for (const llvm::Use& u : f.uses()) {
+        auto* call = llvm::dyn_cast<llvm::CallInst>(u.getUser());
+        if (!call || call->getCalledOperand() != &f) {
+            throw std::runtime_error("'" + f.getName().str() + "' is used as a value");
+        }
+    }
+}
+
+std::unique_ptr<llvm::Module> generateTiered(llvm::LLVMContext& ll, const decl* d, const fn_decl* fn, const tier_link& link) {
+    assert(d->getKind() == decl::prog_kind);
+    const prog_decl* prog = static_cast<const prog_decl*>(d);
+
+    //Constants are always folded, so only variables need storage.
+    cg_context cxt(ll);
+    cg_module mod(cxt, prog);
+    for (const decl* d1 : prog->getDeclarations()) {
+        switch (d1->getKind()) {
+          case decl::var_kind: {
+            const bc_value* var = &link.globals[link.prog->getGlobalIndex(d1)];
+            llvm::Type* t = mod.getType(static_cast<const typed_decl*>(d1))->getPointerTo();
+            mod.declare(d1, getAddress(ll, var, t));
+            break;
+          }
+          case decl::fn_kind:
+            mod.declareFnDecl(static_cast<const fn_decl*>(d1));
+            break;
+          default:
+            break;
+        }
+    }
+    mod.generateFnDecl(fn);
+
+    for (const decl* d1 : prog->getDeclarations()) {
+        if (d1->getKind() != decl::fn_kind) {
+            continue;
+        }
+        llvm::Function* f = llvm::cast<llvm::Function>(mod.lookup(d1));
+        requireDirectCalls(*f);
+        if (d1 == fn) {
+            f->setLinkage(llvm::Function::InternalLinkage);
+        } else if (f->use_empty()) {
+            f->eraseFromParent();
+        } else {
+            defineTierStub(f, link.prog->getIndex(d1), link);
+        }
+    }
+    defineTierEntry(llvm::cast<llvm::Function>(mod.lookup(fn)), link.prog->getIndex(fn));
+    verify(*mod.getModule());
+    return mod.release();
+}
+
+//A rough measure of how long a function takes to lower and optimize.
+static std::size_t getWeight(const stmt* s) {
+    switch (s->getKind()) {
+      case stmt::block_kind: {
+        std::size_t n = 1;
+        for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+            n += getWeight(s1);
+        }
+        return n;
+      }
+      case stmt::when_kind:
+        return 1 + getWeight(static_cast<const when_stmt*>(s)->getBody());
+      case stmt::if_kind: {
+        const if_stmt* i = static_cast<const if_stmt*>(s);
+        return 1 + getWeight(i->getTrueBranch()) + (i->getFalseBranch() ? getWeight(i->getFalseBranch()) : 0);
+      }
+      case stmt::while_kind:
+        return 1 + getWeight(static_cast<const while_stmt*>(s)->getBody());
+      default:
+        return 1;
+    }
+}
+
+//Splits the functions into at most 'jobs' runs of consecutive functions
+//with about the same weight. Keeping neighbours together keeps their
+//callees in the same module more often.
+static std::vector<std::size_t> getPartitions(const std::vector<const fn_decl*>& fns, unsigned jobs) {
+    std::vector<std::size_t> weights;
+    std::size_t total = 0;
+    for (const fn_decl* fn : fns) {
+        weights.push_back(fn->getBody() ? getWeight(fn->getBody()) : 0);
+        total += weights.back();
+    }
+
+    std::vector<std::size_t> bounds{0};
+    std::size_t sum = 0;
+    for (std::size_t i = 0; i != fns.size(); ++i) {
+        sum += weights[i];
+        if (bounds.size() < jobs && sum * jobs >= total * bounds.size() && i + 1 != fns.size()) {
+            bounds.push_back(i + 1);
+        }
+    }
+    bounds.push_back(fns.size());
+    return bounds;
+}
+
+void generatePartitions(const decl* d, opt_level level, unsigned jobs, const std::string& cpu, const partition_fn& done) {
+    assert(d->getKind() == decl::prog_kind);
+    const prog_decl* prog = static_cast<const prog_decl*>(d);
+
+    std::vector<const fn_decl*> fns;
+    for (const decl* d1 : prog->getDeclarations()) {
+        if (d1->getKind() == decl::fn_kind) {
+            fns.push_back(static_cast<const fn_decl*>(d1));
+        }
+    }
+    std::vector<std::size_t> bounds = getPartitions(fns, jobs ? jobs : 1);
+    std::size_t parts = bounds.size() - 1;
+
+    //The AST is only read, so the workers share it. Everything LLVM is
+    //private to a worker.
+    std::vector<std::exception_ptr> errors(parts);
+    auto work = [&](std::size_t part) {
+        try {
+            llvm::LLVMContext ll;
+            std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine(cpu, level);
+            cg_context cxt(ll);
+            cg_module mod(cxt, prog);
+            setTarget(*mod.getModule(), *tm);
+            mod.generate(fns.data() + bounds[part], fns.data() + bounds[part + 1], part == 0);
+            verify(*mod.getModule());
+            optimize(*mod.getModule(), level, tm.get());
+            done(*mod.getModule(), *tm, part);
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t part = 1; part < parts; ++part) {
+        workers.emplace_back(work, part);
+    }
+    work(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    for (std::exception_ptr& e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+//Each part is handed over as bitcode, since modules in different contexts
+//cannot be linked directly.
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& ll, const decl* prog, opt_level level, unsigned jobs, const std::string& cpu) {
+    std::vector<llvm::SmallVector<char, 0>> code(jobs ? jobs : 1);
+    generatePartitions(prog, level, jobs, cpu, [&](llvm::Module& mod, llvm::TargetMachine&, unsigned part) {
+        llvm::raw_svector_ostream os(code[part]);
+        llvm::WriteBitcodeToFile(mod, os);
+    });
+
+    auto result = std::make_unique<llvm::Module>("a.ll", ll);
+    llvm::Linker linker(*result);
+    for (const llvm::SmallVector<char, 0>& buf : code) {
+        if (buf.empty()) {
+            continue;
+        }
+        llvm::MemoryBufferRef ref(llvm::StringRef(buf.data(), buf.size()), "a.ll");
+        llvm::Expected<std::unique_ptr<llvm::Module>> part = llvm::parseBitcodeFile(ref, ll);
+        if (!part) {
+            throw std::logic_error("could not read a partition: " + llvm::toString(part.takeError()));
+        }
+        if (linker.linkInModule(std::move(*part))) {
+            throw std::logic_error("could not link the partitions");
+        }
+    }
+    return result;
+}
+
+static llvm::OptimizationLevel getOptimizationLevel(opt_level level) {
+    switch (level) {
+      case opt_none:
+        return llvm::OptimizationLevel::O0;
+      case opt_less:
+        return llvm::OptimizationLevel::O1;
+      case opt_default:
+        return llvm::OptimizationLevel::O2;
+      case opt_aggressive:
+        return llvm::OptimizationLevel::O3;
+    }
+    throw std::logic_error("not a valid optimization level");
+}
+
+void optimize(llvm::Module& mod, opt_level level, llvm::TargetMachine* tm) {
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::PassBuilder pb(tm);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::OptimizationLevel ol = getOptimizationLevel(level);
+    llvm::ModulePassManager mpm;
+    if (level == opt_none) {
+        mpm = pb.buildO0DefaultPipeline(ol);
+    } else {
+        mpm = pb.buildPerModuleDefaultPipeline(ol);
+    }
+    mpm.run(mod, mam);
 }
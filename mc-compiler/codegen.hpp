@@ -1,5 +1,73 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
 class decl;
+class fn_decl;
+class bc_program;
+class ir_program;
+union bc_value;
+
+namespace llvm {
+  class LLVMContext;
+  class Module;
+  class TargetMachine;
+}
+
+// How hard the optimizer works, as selected by -O0 through -O3.
+enum opt_level {
+  opt_none,
+  opt_less,
+  opt_default,
+  opt_aggressive,
+};
+
+// Lowers a checked program to an LLVM module in 'cxt'.
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& cxt, const decl* prog);
+
+// Lowers a program in SSA form (see ir.hpp) instead. Each IR value is one
+// LLVM value, so the module needs no mem2reg to be in SSA form.
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& cxt, const ir_program& prog);
+
+// Runs LLVM's standard pipeline for 'level' over 'mod'. With a target
+// machine, the passes use its cost model and features.
+void optimize(llvm::Module& mod, opt_level level, llvm::TargetMachine* tm = nullptr);
+
+using partition_fn = std::function<void(llvm::Module& mod, llvm::TargetMachine& tm, unsigned part)>;
+
+// Splits the functions of 'prog' into up to 'jobs' parts and lowers and
+// optimizes each on its own thread, in its own context and module, for
+// 'cpu' as in makeTargetMachine. Each part declares what it uses from the
+// others; part 0 also defines the global variables. 'done' is called on
+// the worker with each finished part and its target machine. Functions
+// are only inlined within a part.
+void generatePartitions(const decl* prog, opt_level level, unsigned jobs, const std::string& cpu, const partition_fn& done);
+
+// Like generatePartitions, then links the parts into one module in 'cxt'.
+std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& cxt, const decl* prog, opt_level level, unsigned jobs, const std::string& cpu);
+
+// Called by native code to run function 'fn' with its arguments in
+// 'frame'. The result replaces the first argument.
+using tier_call_fn = void (*)(void* engine, std::uint32_t fn, bc_value* frame);
+
+// What a function lowered by generateTiered is linked against.
+struct tier_link {
+  const bc_program* prog;
+  bc_value* globals; //The interpreter's, indexed as in 'prog'
+  void* engine;
+  tier_call_fn call;
+};
+
+// The name of the entry point generateTiered defines for function 'fn'.
+std::string getTierEntryName(std::uint32_t fn);
 
-void generate(const decl* d);
+// Lowers 'fn' on its own, to take over from the interpreter. Its entry
+// point is a native_fn (see interp.hpp). It reads and writes the
+// interpreter's globals in place and calls every other function through
+// 'link.call', so it runs whatever tier the callee is in at the time.
+// Throws std::runtime_error if it uses a function as a value, since the
+// interpreter represents those differently.
+std::unique_ptr<llvm::Module> generateTiered(llvm::LLVMContext& cxt, const decl* prog, const fn_decl* fn, const tier_link& link);
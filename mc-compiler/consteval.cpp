@@ -0,0 +1,394 @@
+#include "consteval.hpp"
+#include "arith.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+
+#include <sstream>
+
+const_value const_evaluator::evaluate(const expr* e) {
+  m_steps = 0;
+  m_locals.clear();
+  m_frames.clear();
+  m_frames.push_back(0);
+  return eval(e);
+}
+
+void const_evaluator::step() {
+  if (++m_steps > m_limits.steps) {
+    throw const_eval_error("takes too many steps");
+  }
+}
+
+//Only the locals of the innermost call are visible.
+const_value* const_evaluator::findLocal(const decl* d) {
+  for (std::size_t i = m_locals.size(); i != m_frames.back(); --i) {
+    if (m_locals[i - 1].d == d) {
+      return &m_locals[i - 1].val;
+    }
+  }
+  return nullptr;
+}
+
+void const_evaluator::bind(const decl* d, const_value v) {
+  if ((m_locals.size() + 1) * sizeof(local) > m_limits.memory) {
+    throw const_eval_error("uses too much memory");
+  }
+  m_locals.push_back({d, v});
+}
+
+static const_value convert(conversion c, const_value v) {
+  switch (c) {
+    case conv_identity:
+    case conv_value:
+      return v;
+    case conv_bool:
+      switch (v.kind) {
+        case type::bool_kind:
+          return v;
+        case type::char_kind:
+          return const_value::makeBool(v.c != 0);
+        case type::int_kind:
+          return const_value::makeBool(v.i != 0);
+        case type::float_kind:
+          return const_value::makeBool(v.f != 0);
+        default:
+          break;
+      }
+      break;
+    case conv_char:
+      return const_value::makeChar(static_cast<char>(v.i));
+    case conv_int:
+      if (v.kind == type::bool_kind) {
+        return const_value::makeInt(v.b);
+      }
+      return const_value::makeInt(static_cast<signed char>(v.c));
+    case conv_ext:
+      return const_value::makeFloat(intToFloat(v.i));
+    case conv_trunc:
+      return const_value::makeInt(floatToInt(v.f));
+  }
+  throw const_eval_error("uses an unsupported conversion");
+}
+
+template<typename T>
+static bool compare(binop op, T a, T b) {
+  switch (op) {
+    case bo_eq:
+      return a == b;
+    case bo_ne:
+      return a != b;
+    case bo_lt:
+      return a < b;
+    case bo_gt:
+      return a > b;
+    case bo_le:
+      return a <= b;
+    case bo_ge:
+      return a >= b;
+    default:
+      throw std::logic_error("not a relational op");
+  }
+}
+
+//Division by zero traps at run time, so it cannot be constant.
+static std::int32_t requireDivisor(std::int32_t b) {
+  if (b == 0) {
+    throw const_eval_error("divides by zero");
+  }
+  return b;
+}
+
+static const_value applyBinary(binop op, const_value a, const_value b) {
+  if (bo_eq <= op && op <= bo_ge) {
+    switch (a.kind) {
+      case type::bool_kind:
+        return const_value::makeBool(compare(op, a.b, b.b));
+      case type::char_kind:
+        return const_value::makeBool(compare(op, a.c, b.c));
+      case type::int_kind:
+        return const_value::makeBool(compare(op, a.i, b.i));
+      case type::float_kind:
+        return const_value::makeBool(compare(op, a.f, b.f));
+      default:
+        throw const_eval_error("uses an unsupported comparison");
+    }
+  }
+
+  if (a.kind == type::float_kind) {
+    switch (op) {
+      case bo_add:
+        return const_value::makeFloat(a.f + b.f);
+      case bo_sub:
+        return const_value::makeFloat(a.f - b.f);
+      case bo_mul:
+        return const_value::makeFloat(a.f * b.f);
+      case bo_quo:
+        return const_value::makeFloat(a.f / b.f);
+      case bo_rem:
+        return const_value::makeFloat(remFloat(a.f, b.f));
+      default:
+        throw const_eval_error("uses an unsupported float operation");
+    }
+  }
+
+  switch (op) {
+    case bo_add:
+      return const_value::makeInt(addInt(a.i, b.i));
+    case bo_sub:
+      return const_value::makeInt(subInt(a.i, b.i));
+    case bo_mul:
+      return const_value::makeInt(mulInt(a.i, b.i));
+    case bo_quo:
+      return const_value::makeInt(divInt(a.i, requireDivisor(b.i)));
+    case bo_rem:
+      return const_value::makeInt(remInt(a.i, requireDivisor(b.i)));
+    case bo_and:
+      return const_value::makeInt(a.i & b.i);
+    case bo_ior:
+      return const_value::makeInt(a.i | b.i);
+    case bo_xor:
+      return const_value::makeInt(a.i ^ b.i);
+    case bo_shl:
+      return const_value::makeInt(shlInt(a.i, b.i));
+    case bo_shr:
+      return const_value::makeInt(shrInt(a.i, b.i));
+    default:
+      throw const_eval_error("uses an unsupported int operation");
+  }
+}
+
+const_value const_evaluator::eval(const expr* e) {
+  step();
+  switch (e->getKind()) {
+    case expr::bool_kind:
+      return const_value::makeBool(static_cast<const bool_expr*>(e)->val);
+    case expr::int_kind:
+      return const_value::makeInt(static_cast<const int_expr*>(e)->val);
+    case expr::float_kind:
+      return const_value::makeFloat(static_cast<const float_expr*>(e)->val);
+
+    case expr::id_kind: {
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      if (const_value* v = findLocal(d)) {
+        return *v;
+      }
+      //Constants outside the evaluation, including locals of the function
+      //being checked, can be read once they have a value. Only globals
+      //ever get a value among variables.
+      if (d->getKind() == decl::const_kind || d->getKind() == decl::value_kind ||
+          (m_globals && d->getKind() == decl::var_kind)) {
+        const object_decl* obj = static_cast<const object_decl*>(d);
+        if (obj->hasValue()) {
+          return obj->getValue();
+        }
+      }
+      std::stringstream ss;
+      ss << "reads '" << *d->getName() << "', which is not a constant";
+      throw const_eval_error(ss.str());
+    }
+
+    case expr::unop_kind: {
+      const unop_expr* u = static_cast<const unop_expr*>(e);
+      const_value v = eval(u->m_arg);
+      switch (u->m_op) {
+        case uo_pos:
+          return v;
+        case uo_neg:
+          return v.kind == type::float_kind ? const_value::makeFloat(-v.f) : const_value::makeInt(negInt(v.i));
+        case uo_cmp:
+          return const_value::makeInt(~v.i);
+        case uo_not:
+          return const_value::makeBool(!v.b);
+        default:
+          throw const_eval_error("uses an unsupported unary operation");
+      }
+    }
+
+    case expr::binop_kind: {
+      const binop_expr* b = static_cast<const binop_expr*>(e);
+      const_value lhs = eval(b->m_lhs);
+      if (b->m_op == bo_land) {
+        return lhs.b ? eval(b->m_rhs) : lhs;
+      }
+      if (b->m_op == bo_lor) {
+        return lhs.b ? lhs : eval(b->m_rhs);
+      }
+      return applyBinary(b->m_op, lhs, eval(b->m_rhs));
+    }
+
+    case expr::call_kind:
+      return evalCall(e);
+
+    case expr::cast_kind:
+      return eval(static_cast<const cast_expr*>(e)->m_src);
+
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      return eval(c->m_cond).b ? eval(c->m_true) : eval(c->m_false);
+    }
+
+    case expr::conv_kind: {
+      const conv_expr* c = static_cast<const conv_expr*>(e);
+      return convert(c->m_conv, eval(c->m_src));
+    }
+
+    //An assignment yields the object it assigned to.
+    case expr::assign_kind:
+      return *evalRef(e);
+
+    default:
+      throw const_eval_error("uses an unsupported expression");
+  }
+}
+
+//Evaluates an expression that designates an object. Only the locals of
+//the function being run can be written.
+const_value* const_evaluator::evalRef(const expr* e) {
+  step();
+  switch (e->getKind()) {
+    case expr::id_kind: {
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      if (const_value* v = findLocal(d)) {
+        return v;
+      }
+      std::stringstream ss;
+      ss << "modifies '" << *d->getName() << "', which is not local";
+      throw const_eval_error(ss.str());
+    }
+    case expr::assign_kind: {
+      const assign_expr* a = static_cast<const assign_expr*>(e);
+      const_value v = eval(a->m_rhs);
+      const_value* obj = evalRef(a->m_lhs);
+      *obj = v;
+      return obj;
+    }
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      return eval(c->m_cond).b ? evalRef(c->m_true) : evalRef(c->m_false);
+    }
+    default:
+      throw const_eval_error("uses an unsupported reference");
+  }
+}
+
+const_value const_evaluator::evalCall(const expr* e) {
+  const call_expr* c = static_cast<const call_expr*>(e);
+  if (c->m_base->getKind() != expr::id_kind) {
+    throw const_eval_error("uses an unsupported call");
+  }
+  const decl* d = static_cast<const id_expr*>(c->m_base)->ref;
+  const fn_decl* fn = static_cast<const fn_decl*>(d);
+  if (!fn->getBody()) {
+    std::stringstream ss;
+    ss << "calls '" << *fn->getName() << "' before its definition is complete";
+    throw const_eval_error(ss.str());
+  }
+  if (m_frames.size() > m_limits.depth) {
+    throw const_eval_error("recurses too deeply");
+  }
+
+  //Arguments are evaluated in the caller's frame.
+  small_vector<const_value, 4> args;
+  for (const expr* a : c->m_args) {
+    args.push_back(eval(a));
+  }
+
+  std::size_t base = m_locals.size();
+  m_frames.push_back(base);
+  const decl_list& parms = fn->getParameters();
+  for (std::size_t i = 0; i != parms.size(); ++i) {
+    bind(parms[i], args[i]);
+  }
+
+  const_value ret;
+  flow f = exec(fn->getBody(), ret);
+  m_locals.resize(base);
+  m_frames.pop_back();
+  if (f != return_flow) {
+    std::stringstream ss;
+    ss << "calls '" << *fn->getName() << "', which ends without returning a value";
+    throw const_eval_error(ss.str());
+  }
+  return ret;
+}
+
+const_evaluator::flow const_evaluator::exec(const stmt* s, const_value& ret) {
+  step();
+  switch (s->getKind()) {
+    case stmt::block_kind: {
+      std::size_t mark = m_locals.size();
+      flow f = next_flow;
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        f = exec(s1, ret);
+        if (f != next_flow) {
+          break;
+        }
+      }
+      m_locals.resize(mark);
+      return f;
+    }
+
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      return eval(w->getCondition()).b ? exec(w->getBody(), ret) : next_flow;
+    }
+
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      if (eval(i->getCondition()).b) {
+        return exec(i->getTrueBranch(), ret);
+      }
+      return i->getFalseBranch() ? exec(i->getFalseBranch(), ret) : next_flow;
+    }
+
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      while (eval(w->getCondition()).b) {
+        flow f = exec(w->getBody(), ret);
+        if (f == break_flow) {
+          break;
+        }
+        if (f == return_flow) {
+          return f;
+        }
+      }
+      return next_flow;
+    }
+
+    case stmt::break_kind:
+      return break_flow;
+
+    case stmt::cont_kind:
+      return continue_flow;
+
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      if (e) {
+        ret = eval(e);
+      }
+      return return_flow;
+    }
+
+    case stmt::decl_kind: {
+      const decl* d = static_cast<const decl_stmt*>(s)->m_decl;
+      const expr* init = static_cast<const object_decl*>(d)->getInit();
+      if (!init) {
+        throw const_eval_error("declares an uninitialized local");
+      }
+      bind(d, eval(init));
+      return next_flow;
+    }
+
+    case stmt::expr_kind: {
+      const expr* e = static_cast<const expr_stmt*>(s)->m_expr;
+      if (e->getType() && e->getType()->isReference()) {
+        evalRef(e);
+      } else {
+        eval(e);
+      }
+      return next_flow;
+    }
+  }
+  throw const_eval_error("uses an unsupported statement");
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+class expr;
+class stmt;
+class decl;
+
+struct const_eval_error : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+// Bounds on a single evaluation.
+struct eval_limits {
+  std::size_t steps = 1000000;
+  std::size_t depth = 256;
+  std::size_t memory = 1 << 20; //Bytes of live locals.
+  std::size_t optional_steps = 10000; //Steps for an initializer that need not be constant.
+};
+
+// Runs MC expressions at compile time. An expression is constant if it
+// only reads literals, constants and values, and calls functions that are
+// themselves free of side effects: their bodies may use locals, loops and
+// recursion, but may not touch a global variable. The initializer of a
+// global may also read the global variables before it, since no code has
+// run yet that could change them. Evaluation is bounded
+// by a number of steps, a call depth and the bytes of locals live at
+// once; running out of any is reported like any other reason the
+// expression is not constant, by throwing const_eval_error.
+class const_evaluator {
+  public:
+    //If 'globals' is set, global variables that already have a value
+    //can be read.
+    explicit const_evaluator(eval_limits lim = eval_limits(), bool globals = false) : m_limits(lim), m_globals(globals), m_steps(0) {}
+
+    const_value evaluate(const expr* e);
+
+  private:
+    enum flow {
+      next_flow,
+      break_flow,
+      continue_flow,
+      return_flow,
+    };
+
+    struct local {
+      const decl* d;
+      const_value val;
+    };
+
+    const_value eval(const expr* e);
+    const_value* evalRef(const expr* e);
+    const_value evalCall(const expr* e);
+    flow exec(const stmt* s, const_value& ret);
+
+    const_value* findLocal(const decl* d);
+    void bind(const decl* d, const_value v);
+    void step();
+
+    eval_limits m_limits;
+    bool m_globals;
+    std::size_t m_steps;
+
+    //The locals of every active call, innermost last, and where each
+    //call's locals begin.
+    std::vector<local> m_locals;
+    std::vector<std::size_t> m_frames;
+};
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "small_vector.hpp"
 #include "symbol.hpp"
+#include "value.hpp"
 
-#include <vector>
+#include <utility>
 
 class type;
 class fn_type;
@@ -24,8 +26,6 @@ class decl {
       decl(kind k, symbol sym) : m_kind(k), m_name(sym) {}
 
     public:
-      virtual ~decl() = default;
-
       kind getKind() const {
         return m_kind;
       }
@@ -46,13 +46,13 @@ class decl {
 };
 
 
-using decl_list = std::vector<decl*>;
+using decl_list = small_vector<decl*, 4>;
 
 struct prog_decl : decl {
 
-  prog_decl(const decl_list& ds) : decl(prog_kind, nullptr), m_decls(ds) {}
+  prog_decl(decl_list&& ds) : decl(prog_kind, nullptr), m_decls(std::move(ds)) {}
 
-  const decl_list& getDelcarations() const { 
+  const decl_list& getDeclarations() const { 
     return  m_decls;
   }
 
@@ -84,7 +84,7 @@ struct typed_decl : decl {
 struct object_decl : typed_decl {
 
   protected:
-    object_decl (kind k, symbol sym, type* t, expr* e) : typed_decl(k, sym, t), m_init(e) {}
+    object_decl (kind k, symbol sym, type* t, expr* e) : typed_decl(k, sym, t), m_init(e), m_has_value(false) {}
 
   public:
     expr* getInit() const { 
@@ -95,8 +95,25 @@ struct object_decl : typed_decl {
       m_init = e;
     }
 
+    //True if the initializer was evaluated at compile time. Globals
+    //always have a value; local constants have one when they can.
+    bool hasValue() const {
+      return m_has_value;
+    }
+
+    const const_value& getValue() const {
+      return m_value;
+    }
+
+    void setValue(const_value v) {
+      m_value = v;
+      m_has_value = true;
+    }
+
   protected:
     expr* m_init;
+    bool m_has_value;
+    const_value m_value;
 };
 
 
@@ -117,7 +134,7 @@ struct parm_decl : object_decl {
 };
 
 struct fn_decl: typed_decl {
-  fn_decl(symbol sym, type* t, const decl_list& parms, stmt* s = nullptr) : typed_decl(fn_kind, sym, t), m_parms(parms), m_body(s) {}
+  fn_decl(symbol sym, type* t, decl_list&& parms, stmt* s = nullptr) : typed_decl(fn_kind, sym, t), m_parms(std::move(parms)), m_body(s) {}
 
   const decl_list& getParameters() const {
     return m_parms;
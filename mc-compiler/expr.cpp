@@ -7,7 +7,7 @@ return  m_type->getObjectType();
 }
 
 bool expr::hasType(const type* t) const {
-return  m_type->isBool();
+return  isSameAs(m_type, t);
 }
 
 bool expr::isBool() const {
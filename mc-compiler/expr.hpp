@@ -1,8 +1,9 @@
 #pragma once
 
+#include "small_vector.hpp"
 #include "token.hpp"
 
-#include <vector>
+#include <utility>
 
 class type;
 class decl;
@@ -33,8 +34,6 @@ class expr {
     expr (kind k, type* t) : m_kind(k), m_type(t) {}
 
   public:
-    virtual ~expr() = default;
-
     kind getKind() const {
       return m_kind;
     }
@@ -59,7 +58,7 @@ class expr {
     type* m_type;
 };
 
-using expr_list = std::vector<expr*>;
+using expr_list = small_vector<expr*, 4>;
 
 
 struct bool_expr : expr {
@@ -98,7 +97,7 @@ enum unop {
 };
 
 struct unop_expr : expr {
-  unop_expr(unop op, expr* e1) : expr(unop_kind), m_op(op), m_arg(e1) {}
+  unop_expr(type* t, unop op, expr* e1) : expr(unop_kind, t), m_op(op), m_arg(e1) {}
 
   unop m_op;
   expr* m_arg;
@@ -135,18 +134,18 @@ struct binop_expr : expr {
 };
 
 struct postfix_expr : expr {
-  postfix_expr(kind k, type* t, expr*e, const expr_list& args) : expr(k), m_base(e), m_args(args) {}
+  postfix_expr(kind k, type* t, expr*e, expr_list&& args) : expr(k, t), m_base(e), m_args(std::move(args)) {}
 
   expr* m_base;
   expr_list m_args;
 };
 
 struct call_expr : postfix_expr {
-    call_expr(type* t, expr* e, const expr_list& args) : postfix_expr(call_kind, t, e, args) {}
+    call_expr(type* t, expr* e, expr_list&& args) : postfix_expr(call_kind, t, e, std::move(args)) {}
 };
 
 struct index_expr : postfix_expr {
-  index_expr(type* t, expr* e, const expr_list& args) : postfix_expr(index_kind, t, e, args) {}
+  index_expr(type* t, expr* e, expr_list&& args) : postfix_expr(index_kind, t, e, std::move(args)) {}
 };
 
 struct cast_expr : expr {
@@ -157,7 +156,7 @@ struct cast_expr : expr {
 };
 
 struct assign_expr : expr {
-  assign_expr(type* t, expr* e1, expr* e2) : expr(assign_kind), m_lhs(e1), m_rhs(e2) {}
+  assign_expr(type* t, expr* e1, expr* e2) : expr(assign_kind, t), m_lhs(e1), m_rhs(e2) {}
 
   expr* m_lhs;
   expr* m_rhs;
@@ -1,12 +1,99 @@
 #include "file.hpp"
 
-#include <iterator>
-#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
 
-file::file(const std::string& path) : m_path(path) {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-  std::ifstream ifs(m_path);
-  std::istreambuf_iterator<char> first{ifs};
-  std::istreambuf_iterator<char> last{};
-  m_text = std::string(first, last);
+static std::runtime_error makeError(const std::string& path, const char* what) {
+  std::stringstream ss;
+  ss << path << ": " << what << ": " << std::strerror(errno);
+  return std::runtime_error(ss.str());
+}
+
+file::file(const std::string& path) : m_path(path), m_map(nullptr), m_map_size(0) {
+  int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw makeError(m_path, "cannot open");
+  }
+
+  try {
+    if (!map(fd)) {
+      read(fd);
+    }
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+
+  //The mapping stays valid after the descriptor is closed.
+  ::close(fd);
+}
+
+file::~file() {
+  if (m_map) {
+    ::munmap(m_map, m_map_size);
+  }
+}
+
+//Map regular files directly. Returns false when the input has to be read
+//instead (pipes, terminals, and so on).
+bool file::map(int fd) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    throw makeError(m_path, "cannot stat");
+  }
+  if (!S_ISREG(st.st_mode)) {
+    return false;
+  }
+
+  //Zero-length mappings are invalid, but there is nothing to read either.
+  if (st.st_size == 0) {
+    m_text = {};
+    return true;
+  }
+
+  std::size_t size = st.st_size;
+  void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+
+  //The lexer makes a single forward pass.
+  ::madvise(p, size, MADV_SEQUENTIAL);
+
+  m_map = p;
+  m_map_size = size;
+  m_text = std::string_view(static_cast<const char*>(p), size);
+  return true;
+}
+
+//Read the whole input in large blocks.
+void file::read(int fd) {
+  std::size_t len = 0;
+  m_buf.resize(64 * 1024);
+  while (true) {
+    if (len == m_buf.size()) {
+      m_buf.resize(m_buf.size() * 2);
+    }
+
+    ssize_t n = ::read(fd, &m_buf[len], m_buf.size() - len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw makeError(m_path, "cannot read");
+    }
+    if (n == 0) {
+      break;
+    }
+    len += n;
+  }
+  m_buf.resize(len);
+  m_text = m_buf;
 }
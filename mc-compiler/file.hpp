@@ -1,23 +1,41 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
+// A source file. Regular files are mapped read-only into memory so that
+// the text is never copied; anything that cannot be mapped (pipes,
+// character devices) is read in bulk into an owned buffer.
 class file {
   public:
     file(const std::string& path);
+    ~file();
+
+    file(const file&) = delete;
+    file& operator=(const file&) = delete;
 
     const std::string& getPath() const;
-    const std::string& getText() const;
+    std::string_view getText() const;
 
   private:
+    bool map(int fd);
+    void read(int fd);
+
     std::string m_path;
-    std::string m_text;
+    std::string_view m_text;
+
+    // Non-null when m_text refers to a mapping.
+    void* m_map;
+    std::size_t m_map_size;
+
+    // Backing storage when the input could not be mapped.
+    std::string m_buf;
 };
 
 inline const std::string& file::getPath() const {
   return m_path;
 }
 
-inline const std::string& file::getText() const {
+inline std::string_view file::getText() const {
   return m_text;
 }
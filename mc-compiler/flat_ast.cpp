@@ -0,0 +1,225 @@
+#include "flat_ast.hpp"
+
+#include <stdexcept>
+
+flat_ast::flat_ast(const decl* prog) {
+  const prog_decl* p = static_cast<const prog_decl*>(prog);
+  std::vector<index> ids;
+  for (const decl* d : p->getDeclarations()) {
+    ids.push_back(addDeclaration(d));
+  }
+  m_prog = addList(ids);
+
+  //The arrays are final now; give back what growth left over.
+  m_decl_ids = {};
+  m_type_ids = {};
+  m_exprs.shrink_to_fit();
+  m_expr_types.shrink_to_fit();
+  m_stmts.shrink_to_fit();
+  m_decls.shrink_to_fit();
+  m_pool.shrink_to_fit();
+  m_stmt_lists.shrink_to_fit();
+  m_decl_names.shrink_to_fit();
+  m_decl_nodes.shrink_to_fit();
+  m_floats.shrink_to_fit();
+  m_pairs.shrink_to_fit();
+  m_triples.shrink_to_fit();
+  m_lists.shrink_to_fit();
+}
+
+flat_ast::index flat_ast::addType(const type* t) {
+  auto [i, fresh] = m_type_ids.emplace(t, m_types.size());
+  if (fresh) {
+    m_types.push_back(t);
+  }
+  return i->second;
+}
+
+flat_ast::span flat_ast::addList(const std::vector<index>& ids) {
+  span s{static_cast<index>(m_pool.size()), static_cast<index>(ids.size())};
+  m_pool.insert(m_pool.end(), ids.begin(), ids.end());
+  return s;
+}
+
+static std::uint8_t typeKindOf(const type* t) {
+  return t ? static_cast<std::uint8_t>(t->getKind()) : flat_ast::no_type;
+}
+
+//Operands are added before the expressions that use them, so the array
+//is in evaluation order.
+flat_ast::index flat_ast::addExpression(const expr* e) {
+  node n{static_cast<std::uint8_t>(e->getKind()), typeKindOf(e->getType()), 0, 0};
+  switch (e->getKind()) {
+    case expr::bool_kind:
+      n.data = static_cast<const bool_expr*>(e)->val;
+      break;
+    case expr::int_kind:
+      n.data = static_cast<std::uint32_t>(static_cast<const int_expr*>(e)->val);
+      break;
+    case expr::float_kind:
+      n.data = m_floats.size();
+      m_floats.push_back(static_cast<const float_expr*>(e)->val);
+      break;
+    case expr::id_kind:
+      n.data = m_decl_ids.at(static_cast<const id_expr*>(e)->ref);
+      break;
+    case expr::unop_kind: {
+      const unop_expr* u = static_cast<const unop_expr*>(e);
+      n.op = u->m_op;
+      n.data = addExpression(u->m_arg);
+      break;
+    }
+    case expr::binop_kind: {
+      const binop_expr* b = static_cast<const binop_expr*>(e);
+      n.op = b->m_op;
+      index lhs = addExpression(b->m_lhs);
+      index rhs = addExpression(b->m_rhs);
+      n.data = m_pairs.size();
+      m_pairs.push_back({lhs, rhs});
+      break;
+    }
+    case expr::call_kind:
+    case expr::index_kind: {
+      const postfix_expr* pe = static_cast<const postfix_expr*>(e);
+      index base = addExpression(pe->m_base);
+      std::vector<index> args;
+      for (const expr* a : pe->m_args) {
+        args.push_back(addExpression(a));
+      }
+      n.data = m_lists.size();
+      m_lists.push_back({base, addList(args)});
+      break;
+    }
+    case expr::cast_kind:
+      n.data = addExpression(static_cast<const cast_expr*>(e)->m_src);
+      break;
+    case expr::assign_kind: {
+      const assign_expr* a = static_cast<const assign_expr*>(e);
+      index lhs = addExpression(a->m_lhs);
+      index rhs = addExpression(a->m_rhs);
+      n.data = m_pairs.size();
+      m_pairs.push_back({lhs, rhs});
+      break;
+    }
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      index a = addExpression(c->m_cond);
+      index b = addExpression(c->m_true);
+      index d = addExpression(c->m_false);
+      n.data = m_triples.size();
+      m_triples.push_back({a, b, d});
+      break;
+    }
+    case expr::conv_kind: {
+      const conv_expr* c = static_cast<const conv_expr*>(e);
+      n.op = c->m_conv;
+      n.data = addExpression(c->m_src);
+      break;
+    }
+    case expr::ptr_kind:
+      throw std::logic_error("unexpected expression");
+  }
+  m_exprs.push_back(n);
+  m_expr_types.push_back(addType(e->getType()));
+  return m_exprs.size() - 1;
+}
+
+flat_ast::index flat_ast::addStatement(const stmt* s) {
+  node n{static_cast<std::uint8_t>(s->getKind()), no_type, 0, 0};
+  switch (s->getKind()) {
+    case stmt::block_kind: {
+      std::vector<index> ids;
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        ids.push_back(addStatement(s1));
+      }
+      n.data = m_stmt_lists.size();
+      m_stmt_lists.push_back(addList(ids));
+      break;
+    }
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      index c = addExpression(w->getCondition());
+      index b = addStatement(w->getBody());
+      n.data = m_triples.size();
+      m_triples.push_back({c, b, none});
+      break;
+    }
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      index c = addExpression(i->getCondition());
+      index t = addStatement(i->getTrueBranch());
+      index f = i->getFalseBranch() ? addStatement(i->getFalseBranch()) : none;
+      n.data = m_triples.size();
+      m_triples.push_back({c, t, f});
+      break;
+    }
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      index c = addExpression(w->getCondition());
+      index b = addStatement(w->getBody());
+      n.data = m_triples.size();
+      m_triples.push_back({c, b, none});
+      break;
+    }
+    case stmt::break_kind:
+    case stmt::cont_kind:
+      break;
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      n.data = e ? addExpression(e) : none;
+      break;
+    }
+    case stmt::decl_kind:
+      n.data = addDeclaration(static_cast<const decl_stmt*>(s)->m_decl);
+      break;
+    case stmt::expr_kind:
+      n.data = addExpression(static_cast<const expr_stmt*>(s)->m_expr);
+      break;
+  }
+  m_stmts.push_back(n);
+  return m_stmts.size() - 1;
+}
+
+//A declaration gets its index before its initializer or body is added,
+//so that a function can refer to itself.
+flat_ast::index flat_ast::addDeclaration(const decl* d) {
+  if (d->getKind() == decl::prog_kind) {
+    throw std::logic_error("nested program");
+  }
+
+  const typed_decl* td = static_cast<const typed_decl*>(d);
+  index id = m_decls.size();
+  m_decls.push_back({static_cast<std::uint8_t>(d->getKind()), typeKindOf(td->getType()), 0, none});
+  m_decl_names.push_back(d->getName());
+  m_decl_nodes.push_back(d);
+  m_decl_ids.emplace(d, id);
+
+  std::uint32_t data;
+  if (d->getKind() == decl::fn_kind) {
+    const fn_decl* fn = static_cast<const fn_decl*>(d);
+    std::vector<index> parms;
+    for (const decl* p : fn->getParameters()) {
+      parms.push_back(addDeclaration(p));
+    }
+    span ps = addList(parms);
+    index body = fn->getBody() ? addStatement(fn->getBody()) : none;
+    data = m_lists.size();
+    m_lists.push_back({body, ps});
+  } else {
+    const expr* init = static_cast<const object_decl*>(d)->getInit();
+    data = init ? addExpression(init) : none;
+  }
+  m_decls[id].data = data;
+  return id;
+}
+
+template<typename T>
+static std::size_t getBytes(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+std::size_t flat_ast::getMemoryUsage() const {
+  return getBytes(m_exprs) + getBytes(m_expr_types) + getBytes(m_types) + getBytes(m_stmts) + getBytes(m_stmt_lists) +
+         getBytes(m_decls) + getBytes(m_decl_names) + getBytes(m_decl_nodes) + getBytes(m_floats) +
+         getBytes(m_pairs) + getBytes(m_triples) + getBytes(m_lists) + getBytes(m_pool);
+}
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// A compact copy of a checked program. Instead of a tree of heap nodes,
+// every expression, statement and declaration is a small fixed-size
+// record addressed by a 32-bit index, stored contiguously with the other
+// nodes of its category. Each record holds its kind, the kind of its type
+// and an operator inline; what else a node needs lives in an array for
+// its kind, and lists of children are ranges of a shared index pool.
+//
+// Passes that only look at kinds and operands (folding, checks, codegen)
+// can walk it without chasing pointers, and a whole category can be
+// scanned as a flat array. The full type and the original node remain
+// available through side arrays.
+class flat_ast {
+  public:
+    using index = std::uint32_t;
+
+    //The absent child, e.g. the else branch of an if without one.
+    static constexpr index none = ~index(0);
+
+    //The type kind of an expression that has no type.
+    static constexpr std::uint8_t no_type = 0xff;
+
+    // A contiguous run of indices in the pool.
+    class range {
+      public:
+        range(const index* first, const index* last) : m_first(first), m_last(last) {}
+
+        const index* begin() const {
+          return m_first;
+        }
+
+        const index* end() const {
+          return m_last;
+        }
+
+        std::size_t size() const {
+          return m_last - m_first;
+        }
+
+        index operator[](std::size_t n) const {
+          return m_first[n];
+        }
+
+      private:
+        const index* m_first;
+        const index* m_last;
+    };
+
+    explicit flat_ast(const decl* prog);
+
+    flat_ast(const flat_ast&) = delete;
+    flat_ast& operator=(const flat_ast&) = delete;
+
+    // The top-level declarations, in order.
+    range getDeclarations() const {
+      return getRange(m_prog);
+    }
+
+    //Expressions
+    std::size_t getNumExpressions() const {
+      return m_exprs.size();
+    }
+
+    expr::kind getKind(index e) const {
+      return static_cast<expr::kind>(m_exprs[e].kind);
+    }
+
+    // The kind of the expression's type, or no_type.
+    std::uint8_t getTypeKind(index e) const {
+      return m_exprs[e].type;
+    }
+
+    const type* getType(index e) const {
+      return m_types[m_expr_types[e]];
+    }
+
+    bool getBool(index e) const {
+      return m_exprs[e].data;
+    }
+
+    std::int32_t getInt(index e) const {
+      return static_cast<std::int32_t>(m_exprs[e].data);
+    }
+
+    double getFloat(index e) const {
+      return m_floats[m_exprs[e].data];
+    }
+
+    // The declaration an id expression refers to.
+    index getReference(index e) const {
+      return m_exprs[e].data;
+    }
+
+    unop getUnaryOp(index e) const {
+      return static_cast<unop>(m_exprs[e].op);
+    }
+
+    binop getBinaryOp(index e) const {
+      return static_cast<binop>(m_exprs[e].op);
+    }
+
+    conversion getConversion(index e) const {
+      return static_cast<conversion>(m_exprs[e].op);
+    }
+
+    // The operand of a unary, cast or conversion expression.
+    index getOperand(index e) const {
+      return m_exprs[e].data;
+    }
+
+    // The operands of binary and assignment expressions.
+    index getLhs(index e) const {
+      return m_pairs[m_exprs[e].data].first;
+    }
+
+    index getRhs(index e) const {
+      return m_pairs[m_exprs[e].data].second;
+    }
+
+    // The parts of a conditional expression.
+    index getCondition(index e) const {
+      return m_triples[m_exprs[e].data].a;
+    }
+
+    index getTrueValue(index e) const {
+      return m_triples[m_exprs[e].data].b;
+    }
+
+    index getFalseValue(index e) const {
+      return m_triples[m_exprs[e].data].c;
+    }
+
+    // The callee of a call or the base of an index expression, and its
+    // arguments.
+    index getBase(index e) const {
+      return m_lists[m_exprs[e].data].head;
+    }
+
+    range getArguments(index e) const {
+      return getRange(m_lists[m_exprs[e].data].list);
+    }
+
+    //Statements
+    std::size_t getNumStatements() const {
+      return m_stmts.size();
+    }
+
+    stmt::kind getStatementKind(index s) const {
+      return static_cast<stmt::kind>(m_stmts[s].kind);
+    }
+
+    range getStatements(index s) const {
+      return getRange(m_stmt_lists[m_stmts[s].data]);
+    }
+
+    // The condition of an if, while or when statement.
+    index getStatementCondition(index s) const {
+      return m_triples[m_stmts[s].data].a;
+    }
+
+    index getBody(index s) const {
+      return m_triples[m_stmts[s].data].b;
+    }
+
+    index getTrueBranch(index s) const {
+      return m_triples[m_stmts[s].data].b;
+    }
+
+    index getFalseBranch(index s) const {
+      return m_triples[m_stmts[s].data].c;
+    }
+
+    // The expression of an expression or return statement; none for a
+    // bare return.
+    index getStatementExpression(index s) const {
+      return m_stmts[s].data;
+    }
+
+    index getStatementDeclaration(index s) const {
+      return m_stmts[s].data;
+    }
+
+    //Declarations
+    std::size_t getNumDeclarations() const {
+      return m_decls.size();
+    }
+
+    decl::kind getDeclarationKind(index d) const {
+      return static_cast<decl::kind>(m_decls[d].kind);
+    }
+
+    std::uint8_t getDeclarationTypeKind(index d) const {
+      return m_decls[d].type;
+    }
+
+    symbol getName(index d) const {
+      return m_decl_names[d];
+    }
+
+    const decl* getDeclaration(index d) const {
+      return m_decl_nodes[d];
+    }
+
+    // The initializer of an object declaration, or none.
+    index getInit(index d) const {
+      return m_decls[d].data;
+    }
+
+    range getParameters(index d) const {
+      return getRange(m_lists[m_decls[d].data].list);
+    }
+
+    // The body of a function definition, or none.
+    index getFunctionBody(index d) const {
+      return m_lists[m_decls[d].data].head;
+    }
+
+    //Traversal
+
+    // Calls 'fn' with each direct subexpression of 'e', left to right.
+    template<typename F>
+    void forEachChild(index e, F fn) const;
+
+    // Calls 'fn' with every expression in the tree rooted at 'e', each
+    // after its operands.
+    template<typename F>
+    void forEachPostorder(index e, F fn) const;
+
+    // The number of bytes held by all of the arrays.
+    std::size_t getMemoryUsage() const;
+
+  private:
+    //The record common to every node.
+    struct node {
+      std::uint8_t kind;
+      std::uint8_t type;
+      std::uint8_t op;
+      std::uint32_t data; //An immediate, a child, or an index for the kind.
+    };
+
+    struct pair {
+      index first;
+      index second;
+    };
+
+    struct triple {
+      index a;
+      index b;
+      index c;
+    };
+
+    //A run of the pool.
+    struct span {
+      index first;
+      index size;
+    };
+
+    //A node with one distinguished child and a list of others.
+    struct headed_list {
+      index head;
+      span list;
+    };
+
+    range getRange(span s) const {
+      return range(m_pool.data() + s.first, m_pool.data() + s.first + s.size);
+    }
+
+    index addExpression(const expr* e);
+    index addStatement(const stmt* s);
+    index addDeclaration(const decl* d);
+    span addList(const std::vector<index>& ids);
+    index addType(const type* t);
+
+    std::vector<node> m_exprs;
+    std::vector<index> m_expr_types;
+
+    //Types are canonical, so a program only has a handful.
+    std::vector<const type*> m_types;
+
+    std::vector<node> m_stmts;
+    std::vector<span> m_stmt_lists;
+
+    std::vector<node> m_decls;
+    std::vector<symbol> m_decl_names;
+    std::vector<const decl*> m_decl_nodes;
+
+    std::vector<double> m_floats;
+    std::vector<pair> m_pairs;
+    std::vector<triple> m_triples;
+    std::vector<headed_list> m_lists;
+    std::vector<index> m_pool;
+
+    span m_prog;
+
+    //Only used while building.
+    std::unordered_map<const decl*, index> m_decl_ids;
+    std::unordered_map<const type*, index> m_type_ids;
+};
+
+template<typename F>
+void flat_ast::forEachChild(index e, F fn) const {
+  switch (getKind(e)) {
+    case expr::bool_kind:
+    case expr::int_kind:
+    case expr::float_kind:
+    case expr::id_kind:
+    case expr::ptr_kind:
+      return;
+    case expr::unop_kind:
+    case expr::cast_kind:
+    case expr::conv_kind:
+      fn(getOperand(e));
+      return;
+    case expr::binop_kind:
+    case expr::assign_kind:
+      fn(getLhs(e));
+      fn(getRhs(e));
+      return;
+    case expr::cond_kind:
+      fn(getCondition(e));
+      fn(getTrueValue(e));
+      fn(getFalseValue(e));
+      return;
+    case expr::call_kind:
+    case expr::index_kind:
+      fn(getBase(e));
+      for (index a : getArguments(e)) {
+        fn(a);
+      }
+      return;
+  }
+}
+
+template<typename F>
+void flat_ast::forEachPostorder(index e, F fn) const {
+  forEachChild(e, [&](index c) {
+    forEachPostorder(c, fn);
+  });
+  fn(e);
+}
@@ -0,0 +1,331 @@
+#include "interp.hpp"
+#include "arith.hpp"
+#include "decl.hpp"
+#include "type.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+//Deeper than any program that does not recurse without end.
+static constexpr std::size_t max_depth = std::size_t(1) << 20;
+
+interpreter::interpreter(const bc_program& prog, std::size_t stack_size)
+  : m_prog(prog), m_globals(prog.getGlobals()),
+    m_stack(new bc_value[stack_size]), m_stack_end(m_stack.get() + stack_size),
+    m_profiles(prog.getFunctions().size()), m_native(new std::atomic<native_fn>[prog.getFunctions().size()]),
+    m_threshold(std::numeric_limits<std::uint32_t>::max()) {
+  for (std::size_t i = 0; i != prog.getFunctions().size(); ++i) {
+    m_native[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+void interpreter::setHotHandler(std::uint32_t threshold, std::function<void(std::uint32_t)> hot) {
+  m_threshold = threshold;
+  m_hot = std::move(hot);
+}
+
+//Counts stop mattering once a function has crossed the threshold, so
+//the handler runs exactly once.
+void interpreter::heat(std::uint32_t fn) {
+  const bc_profile& p = m_profiles[fn];
+  if (p.calls + p.loops == m_threshold && m_hot) {
+    m_hot(fn);
+  }
+}
+
+//The frame of a call made from outside the interpreter, above every
+//frame that is running.
+bc_value* interpreter::getFrame(std::size_t size) {
+  bc_value* frame = m_stack.get();
+  if (!m_calls.empty()) {
+    const activation& top = m_calls.back();
+    frame = top.frame + m_prog.getFunction(top.fn).frame_size;
+  }
+  if (frame + size > m_stack_end) {
+    throw std::runtime_error("stack overflow");
+  }
+  return frame;
+}
+
+bc_value interpreter::call(std::uint32_t fn, const std::vector<bc_value>& args) {
+  if (args.size() != m_prog.getFunction(fn).params) {
+    throw std::logic_error("wrong number of arguments");
+  }
+  return enter(fn, args.data());
+}
+
+void interpreter::call(std::uint32_t fn, bc_value* frame) {
+  frame[0] = enter(fn, frame);
+}
+
+bc_value interpreter::enter(std::uint32_t fn, const bc_value* args) {
+  const bc_function& f = m_prog.getFunction(fn);
+  bc_value* frame = getFrame(f.frame_size);
+  for (std::size_t i = 0; i != f.params; ++i) {
+    frame[i] = args[i];
+  }
+
+  ++m_profiles[fn].calls;
+  heat(fn);
+  std::size_t depth = m_calls.size();
+  m_calls.push_back({fn, f.code.data(), frame});
+  try {
+    return run(depth);
+  } catch (...) {
+    m_calls.resize(depth);
+    throw;
+  }
+}
+
+int interpreter::runMain() {
+  std::int32_t n = m_prog.findFunction("main");
+  if (n < 0) {
+    throw std::runtime_error("the program has no main function");
+  }
+  const fn_decl* main = m_prog.getFunction(n).decl;
+  if (!main->getParameters().empty() || main->getReturnType()->getKind() != type::int_kind) {
+    throw std::runtime_error("main must take no arguments and return int");
+  }
+  return enter(n, nullptr).i;
+}
+
+static std::int32_t requireDivisor(std::int32_t b) {
+  if (b == 0) {
+    throw std::runtime_error("division by zero");
+  }
+  return b;
+}
+
+//Runs the activation on top of the call stack until the one at 'depth'
+//returns. Calls between bytecode functions push an activation and carry
+//on in the same loop.
+//
+//With GCC and Clang every instruction jumps straight to the next one's
+//handler through a table of label addresses, which predicts better than
+//the single indirect jump of a switch.
+bc_value interpreter::run(std::size_t depth) {
+  const bc_function* fn = &m_prog.getFunction(m_calls.back().fn);
+  const bc_insn* pc = m_calls.back().pc;
+  bc_value* r = m_calls.back().frame;
+  bc_value* g = m_globals.data();
+  bc_insn i = *pc;
+  std::uint32_t callee;
+
+#ifdef __GNUC__
+  static void* const labels[] = {
+#define MC_BYTECODE_LABEL(name) &&op_##name,
+    MC_BYTECODE_OPS(MC_BYTECODE_LABEL)
+#undef MC_BYTECODE_LABEL
+  };
+#define MC_CASE(name) op_##name:
+#define MC_NEXT i = *pc++; goto *labels[i.op]
+  MC_NEXT;
+#else
+#define MC_CASE(name) case bc_##name:
+#define MC_NEXT goto dispatch
+dispatch:
+  i = *pc++;
+  switch (i.op) {
+#endif
+
+#define MC_INT_BINARY(name, e) \
+  MC_CASE(name) { \
+    std::int32_t a = r[i.b()].i; \
+    std::int32_t b = r[i.c()].i; \
+    r[i.a].i = (e); \
+    MC_NEXT; \
+  }
+#define MC_FLOAT_BINARY(name, e) \
+  MC_CASE(name) { \
+    float a = r[i.b()].f; \
+    float b = r[i.c()].f; \
+    r[i.a].f = (e); \
+    MC_NEXT; \
+  }
+#define MC_FLOAT_COMPARE(name, e) \
+  MC_CASE(name) { \
+    float a = r[i.b()].f; \
+    float b = r[i.c()].f; \
+    r[i.a].i = (e); \
+    MC_NEXT; \
+  }
+
+  MC_CASE(mov) {
+    r[i.a] = r[i.b()];
+    MC_NEXT;
+  }
+  MC_CASE(ldi) {
+    r[i.a].i = i.imm();
+    MC_NEXT;
+  }
+  MC_CASE(ldg) {
+    r[i.a] = g[i.imm()];
+    MC_NEXT;
+  }
+  MC_CASE(stg) {
+    g[i.imm()] = r[i.a];
+    MC_NEXT;
+  }
+  MC_CASE(addr) {
+    r[i.a].ref = &r[i.b()];
+    MC_NEXT;
+  }
+  MC_CASE(addrg) {
+    r[i.a].ref = &g[i.imm()];
+    MC_NEXT;
+  }
+  MC_CASE(load) {
+    r[i.a] = *r[i.b()].ref;
+    MC_NEXT;
+  }
+  MC_CASE(store) {
+    *r[i.a].ref = r[i.b()];
+    MC_NEXT;
+  }
+
+  MC_INT_BINARY(add, addInt(a, b))
+  MC_INT_BINARY(sub, subInt(a, b))
+  MC_INT_BINARY(mul, mulInt(a, b))
+  MC_INT_BINARY(div, divInt(a, requireDivisor(b)))
+  MC_INT_BINARY(rem, remInt(a, requireDivisor(b)))
+  MC_INT_BINARY(band, a & b)
+  MC_INT_BINARY(bor, a | b)
+  MC_INT_BINARY(bxor, a ^ b)
+  MC_INT_BINARY(shl, shlInt(a, b))
+  MC_INT_BINARY(shr, shrInt(a, b))
+
+  MC_CASE(neg) {
+    r[i.a].i = negInt(r[i.b()].i);
+    MC_NEXT;
+  }
+  MC_CASE(bnot) {
+    r[i.a].i = ~r[i.b()].i;
+    MC_NEXT;
+  }
+  MC_CASE(lnot) {
+    r[i.a].i = !r[i.b()].i;
+    MC_NEXT;
+  }
+
+  MC_FLOAT_BINARY(fadd, a + b)
+  MC_FLOAT_BINARY(fsub, a - b)
+  MC_FLOAT_BINARY(fmul, a * b)
+  MC_FLOAT_BINARY(fdiv, a / b)
+  MC_FLOAT_BINARY(frem, remFloat(a, b))
+  MC_CASE(fneg) {
+    r[i.a].f = -r[i.b()].f;
+    MC_NEXT;
+  }
+
+  MC_INT_BINARY(eq, a == b)
+  MC_INT_BINARY(ne, a != b)
+  MC_INT_BINARY(lt, a < b)
+  MC_INT_BINARY(gt, a > b)
+  MC_INT_BINARY(le, a <= b)
+  MC_INT_BINARY(ge, a >= b)
+
+  MC_FLOAT_COMPARE(feq, a == b)
+  MC_FLOAT_COMPARE(fne, a != b)
+  MC_FLOAT_COMPARE(flt, a < b)
+  MC_FLOAT_COMPARE(fgt, a > b)
+  MC_FLOAT_COMPARE(fle, a <= b)
+  MC_FLOAT_COMPARE(fge, a >= b)
+
+  MC_CASE(itof) {
+    r[i.a].f = intToFloat(r[i.b()].i);
+    MC_NEXT;
+  }
+  MC_CASE(ftoi) {
+    r[i.a].i = floatToInt(r[i.b()].f);
+    MC_NEXT;
+  }
+  MC_CASE(itoc) {
+    r[i.a].i = static_cast<signed char>(r[i.b()].i);
+    MC_NEXT;
+  }
+  MC_CASE(itob) {
+    r[i.a].i = r[i.b()].i != 0;
+    MC_NEXT;
+  }
+  MC_CASE(ftob) {
+    r[i.a].i = r[i.b()].f != 0;
+    MC_NEXT;
+  }
+
+  MC_CASE(jmp) {
+    if (i.imm() < 0) {
+      ++m_profiles[m_calls.back().fn].loops;
+      heat(m_calls.back().fn);
+    }
+    pc += i.imm();
+    MC_NEXT;
+  }
+  MC_CASE(jt) {
+    if (r[i.a].i) {
+      pc += i.imm();
+    }
+    MC_NEXT;
+  }
+  MC_CASE(jf) {
+    if (!r[i.a].i) {
+      pc += i.imm();
+    }
+    MC_NEXT;
+  }
+
+  //The callee's frame starts at the first argument. Native code gets the
+  //same frame, above which calls back into the interpreter start.
+  MC_CASE(call) {
+    callee = i.imm();
+    goto call;
+  }
+  MC_CASE(calli) {
+    callee = r[i.b()].i;
+  }
+  call: {
+    if (m_calls.size() == max_depth) {
+      throw std::runtime_error("stack overflow");
+    }
+    m_calls.back().pc = pc;
+    ++m_profiles[callee].calls;
+    heat(callee);
+    if (native_fn code = m_native[callee].load(std::memory_order_acquire)) {
+      code(r + i.a);
+      MC_NEXT;
+    }
+    fn = &m_prog.getFunction(callee);
+    r += i.a;
+    if (r + fn->frame_size > m_stack_end) {
+      throw std::runtime_error("stack overflow");
+    }
+    m_calls.push_back({callee, nullptr, r});
+    pc = fn->code.data();
+    MC_NEXT;
+  }
+
+  //The result goes in the callee's first register, where the caller
+  //expects it.
+  MC_CASE(ret) {
+    r[0] = r[i.a];
+    bc_value result = r[0];
+    m_calls.pop_back();
+    if (m_calls.size() == depth) {
+      return result;
+    }
+    const activation& caller = m_calls.back();
+    fn = &m_prog.getFunction(caller.fn);
+    pc = caller.pc;
+    r = caller.frame;
+    MC_NEXT;
+  }
+
+#ifndef __GNUC__
+  }
+#endif
+#undef MC_FLOAT_COMPARE
+#undef MC_FLOAT_BINARY
+#undef MC_INT_BINARY
+#undef MC_NEXT
+#undef MC_CASE
+  throw std::logic_error("not a valid instruction");
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "bytecode.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Native code for a function, called with its arguments in 'frame'. The
+// result replaces the first argument.
+using native_fn = void (*)(bc_value* frame);
+
+// How often the interpreter has called a function, whichever tier ran
+// it, and how many loop iterations it ran in the interpreter.
+struct bc_profile {
+  std::uint32_t calls = 0;
+  std::uint32_t loops = 0; //Backward jumps taken
+};
+
+// Runs bytecode. Every call shares one register stack, so MC recursion
+// does not use the C++ stack, and running out of it is reported instead
+// of crashing.
+class interpreter {
+  public:
+    explicit interpreter(const bc_program& prog, std::size_t stack_size = std::size_t(1) << 20);
+
+    // Calls function 'fn' with 'args' and returns its result. Throws
+    // std::runtime_error if the program divides by zero or runs out of
+    // stack.
+    bc_value call(std::uint32_t fn, const std::vector<bc_value>& args);
+
+    // Like call, with the arguments in 'frame' and the result written over
+    // the first of them. This is how native code calls back in.
+    void call(std::uint32_t fn, bc_value* frame);
+
+    // Calls 'def main() -> int' and returns what it returns.
+    int runMain();
+
+    // The current values of the globals, which native code shares.
+    bc_value* getGlobals() {
+      return m_globals.data();
+    }
+
+    const bc_profile& getProfile(std::uint32_t fn) const {
+      return m_profiles[fn];
+    }
+
+    // Calls 'hot' on the interpreter's thread, once per function, when its
+    // calls and loops add up to 'threshold'.
+    void setHotHandler(std::uint32_t threshold, std::function<void(std::uint32_t)> hot);
+
+    // Makes calls to 'fn' run 'code' from now on. This may be called from
+    // any thread; calls already running finish in the interpreter.
+    void setNative(std::uint32_t fn, native_fn code) {
+      m_native[fn].store(code, std::memory_order_release);
+    }
+
+    native_fn getNative(std::uint32_t fn) const {
+      return m_native[fn].load(std::memory_order_acquire);
+    }
+
+  private:
+    //A function that is running; pc is only saved while it calls.
+    struct activation {
+      std::uint32_t fn;
+      const bc_insn* pc;
+      bc_value* frame;
+    };
+
+    bc_value* getFrame(std::size_t size);
+    bc_value enter(std::uint32_t fn, const bc_value* args);
+    bc_value run(std::size_t depth);
+    void heat(std::uint32_t fn);
+
+    const bc_program& m_prog;
+    std::vector<bc_value> m_globals;
+    //Left uninitialized, so only the pages a program touches are ever
+    //mapped.
+    std::unique_ptr<bc_value[]> m_stack;
+    bc_value* m_stack_end;
+    std::vector<activation> m_calls;
+
+    std::vector<bc_profile> m_profiles;
+    std::unique_ptr<std::atomic<native_fn>[]> m_native;
+    std::uint32_t m_threshold;
+    std::function<void(std::uint32_t)> m_hot;
+};
@@ -0,0 +1,609 @@
+#include "ir.hpp"
+#include "decl.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+const char* toString(ir_op op) {
+  static const char* const names[] = {
+#define MC_IR_NAME(name) #name,
+    MC_IR_OPS(MC_IR_NAME)
+#undef MC_IR_NAME
+  };
+  return names[op];
+}
+
+//Functions are small, so their arenas grow in small steps.
+ir_function::ir_function(const fn_decl* fn) : m_decl(fn), m_mem(4 * 1024), m_next_block(0) {}
+
+ir_function::~ir_function() {
+  for (auto i = m_finalizers.rbegin(); i != m_finalizers.rend(); ++i) {
+    i->destroy(i->node);
+  }
+}
+
+ir_param* ir_function::addParam(const type* t, const decl* d) {
+  ir_param* p = make<ir_param>(t, d, static_cast<std::uint32_t>(m_params.size()));
+  m_params.push_back(p);
+  return p;
+}
+
+ir_constant* ir_function::getConstant(const type* t, const_value v) {
+  return make<ir_constant>(t, v);
+}
+
+//There is one value per global, whatever refers to it.
+ir_global* ir_function::getGlobal(const type* t, const decl* d) {
+  ir_global*& g = m_globals[d];
+  if (!g) {
+    g = make<ir_global>(t, d);
+  }
+  return g;
+}
+
+ir_block* ir_function::makeBlock() {
+  return make<ir_block>(m_next_block++);
+}
+
+void ir_function::addBlock(ir_block* b) {
+  m_blocks.push_back(b);
+}
+
+ir_insn* ir_function::makeInsn(ir_op op, const type* t, std::uint32_t n) {
+  ir_insn* i = make<ir_insn>(op, t);
+  i->ops = makeOperands(n);
+  i->num_ops = n;
+  return i;
+}
+
+ir_value** ir_function::makeOperands(std::uint32_t n) {
+  if (n == 0) {
+    return nullptr;
+  }
+  void* mem = m_mem.allocate(n * sizeof(ir_value*), alignof(ir_value*));
+  return static_cast<ir_value**>(mem);
+}
+
+void ir_function::insertAfter(ir_block* b, ir_insn* pos, ir_insn* i) {
+  ir_insn* next = pos ? pos->next : b->first;
+  i->block = b;
+  i->prev = pos;
+  i->next = next;
+  (pos ? pos->next : b->first) = i;
+  (next ? next->prev : b->last) = i;
+}
+
+void ir_function::append(ir_block* b, ir_insn* i) {
+  insertAfter(b, b->last, i);
+}
+
+void ir_function::remove(ir_insn* i) {
+  ir_block* b = i->block;
+  (i->prev ? i->prev->next : b->first) = i->next;
+  (i->next ? i->next->prev : b->last) = i->prev;
+  i->block = nullptr;
+  i->prev = nullptr;
+  i->next = nullptr;
+}
+
+//Instructions that produce nothing are not numbered.
+void ir_function::renumber() {
+  std::uint32_t n = 0;
+  for (ir_param* p : m_params) {
+    p->id = n++;
+  }
+  std::uint32_t id = 0;
+  for (ir_block* b : m_blocks) {
+    b->id = id++;
+    for (ir_insn* i = b->first; i; i = i->next) {
+      if (i->ty) {
+        i->id = n++;
+      }
+    }
+  }
+  m_next_block = id;
+}
+
+
+static void printType(std::ostream& os, const type* t) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+      os << "bool";
+      return;
+    case type::char_kind:
+      os << "char";
+      return;
+    case type::int_kind:
+      os << "int";
+      return;
+    case type::float_kind:
+      os << "float";
+      return;
+    case type::ptr_kind:
+      os << '*';
+      return printType(os, static_cast<const ptr_type*>(t)->getElementType());
+    case type::ref_kind:
+      os << "ref ";
+      return printType(os, static_cast<const ref_type*>(t)->getObjectType());
+    case type::fn_kind: {
+      const fn_type* f = static_cast<const fn_type*>(t);
+      os << "fn(";
+      const char* sep = "";
+      for (const type* p : f->getParameterTypes()) {
+        os << sep;
+        printType(os, p);
+        sep = ", ";
+      }
+      os << ") -> ";
+      return printType(os, f->getReturnType());
+    }
+  }
+}
+
+//Floats are printed with enough digits to read back exactly, and always
+//look like floats.
+static void printConstant(std::ostream& os, const ir_constant* c) {
+  const const_value& v = c->value;
+  switch (c->ty->getKind()) {
+    case type::bool_kind:
+      os << (v.b ? "true" : "false");
+      return;
+    case type::char_kind:
+      os << static_cast<int>(v.c);
+      return;
+    case type::int_kind:
+      os << v.i;
+      return;
+    case type::float_kind: {
+      char buf[32];
+      std::snprintf(buf, sizeof buf, "%.9g", v.f);
+      std::string s = buf;
+      if (s.find_first_of(".einn") == std::string::npos) {
+        s += ".0";
+      }
+      os << s;
+      return;
+    }
+    default:
+      os << "null";
+      return;
+  }
+}
+
+static void printValue(std::ostream& os, const ir_value* v) {
+  switch (v->kind) {
+    case ir_value::constant_kind:
+      return printConstant(os, static_cast<const ir_constant*>(v));
+    case ir_value::global_kind:
+      os << '@' << static_cast<const ir_global*>(v)->var->getName()->str();
+      return;
+    case ir_value::param_kind:
+    case ir_value::insn_kind:
+      os << '%' << v->id;
+      return;
+  }
+}
+
+static void printInsn(std::ostream& os, const ir_insn* i) {
+  os << "  ";
+  if (i->ty) {
+    os << '%' << i->id << " = ";
+  }
+  os << toString(i->op);
+  if (i->ty) {
+    os << ' ';
+    printType(os, i->ty);
+  }
+  switch (i->op) {
+    case ir_phi:
+      for (std::uint32_t n = 0; n != i->num_ops; ++n) {
+        os << (n ? ", [" : " [");
+        printValue(os, i->ops[n]);
+        os << ", b" << i->block->preds[n]->id << ']';
+      }
+      break;
+    case ir_call:
+      os << ' ';
+      printValue(os, i->ops[0]);
+      os << '(';
+      for (std::uint32_t n = 1; n != i->num_ops; ++n) {
+        os << (n != 1 ? ", " : "");
+        printValue(os, i->ops[n]);
+      }
+      os << ')';
+      break;
+    default:
+      for (std::uint32_t n = 0; n != i->num_ops; ++n) {
+        os << (n ? ", " : " ");
+        printValue(os, i->ops[n]);
+      }
+      break;
+  }
+  if (i->op == ir_br || i->op == ir_condbr) {
+    os << (i->num_ops ? ", b" : " b") << i->targets[0]->id;
+    if (i->op == ir_condbr) {
+      os << ", b" << i->targets[1]->id;
+    }
+  }
+  if (i->var) {
+    os << "  ; " << i->var->getName()->str();
+  }
+  os << '\n';
+}
+
+void ir_function::print(std::ostream& os) const {
+  os << "fn " << m_decl->getName()->str() << '(';
+  for (const ir_param* p : m_params) {
+    os << (p->index ? ", " : "");
+    printType(os, p->ty);
+    os << " %" << p->id;
+  }
+  os << ") -> ";
+  printType(os, m_decl->getReturnType());
+  os << " {\n";
+  for (const ir_block* b : m_blocks) {
+    os << 'b' << b->id << ':';
+    for (std::size_t n = 0; n != b->preds.size(); ++n) {
+      os << (n ? ", b" : "  ; preds: b") << b->preds[n]->id;
+    }
+    os << '\n';
+    for (const ir_insn* i = b->first; i; i = i->next) {
+      printInsn(os, i);
+    }
+  }
+  os << "}\n";
+}
+
+
+static bool isIntegral(const type* t) {
+  return t && (t->isBool() || t->isChar() || t->isInt());
+}
+
+static bool isFloat(const type* t) {
+  return t && t->getKind() == type::float_kind;
+}
+
+static bool isReferenceTo(const type* r, const type* t) {
+  return r && r->isReference() && static_cast<const ref_type*>(r)->getObjectType() == t;
+}
+
+//Null if the operands and result of 'i' have the types its operation
+//needs, otherwise what is wrong with them.
+static const char* checkTypes(const fn_decl* fn, const ir_insn* i) {
+  const type* t = i->ty;
+  auto type_of = [i](std::uint32_t n) { return i->ops[n]->ty; };
+  switch (i->op) {
+    case ir_add:
+    case ir_sub:
+    case ir_mul:
+    case ir_div:
+    case ir_rem:
+    case ir_band:
+    case ir_bor:
+    case ir_bxor:
+    case ir_shl:
+    case ir_shr:
+      if (i->num_ops != 2 || !isIntegral(t) || type_of(0) != t || type_of(1) != t) {
+        return "integer operation with operands of the wrong types";
+      }
+      return nullptr;
+    case ir_fadd:
+    case ir_fsub:
+    case ir_fmul:
+    case ir_fdiv:
+    case ir_frem:
+      if (i->num_ops != 2 || !isFloat(t) || type_of(0) != t || type_of(1) != t) {
+        return "float operation with operands of the wrong types";
+      }
+      return nullptr;
+    case ir_neg:
+    case ir_bnot:
+      if (i->num_ops != 1 || !isIntegral(t) || type_of(0) != t) {
+        return "integer operation with an operand of the wrong type";
+      }
+      return nullptr;
+    case ir_fneg:
+      if (i->num_ops != 1 || !isFloat(t) || type_of(0) != t) {
+        return "float operation with an operand of the wrong type";
+      }
+      return nullptr;
+    case ir_eq:
+    case ir_ne:
+    case ir_lt:
+    case ir_gt:
+    case ir_le:
+    case ir_ge:
+      if (i->num_ops != 2 || !t || !t->isBool() || type_of(0) != type_of(1) || type_of(0)->isReference()) {
+        return "comparison of values of different types";
+      }
+      return nullptr;
+    case ir_tobool:
+      if (i->num_ops != 1 || !t || !t->isBool() || type_of(0)->isReference()) {
+        return "tobool of something that is not a value";
+      }
+      return nullptr;
+    case ir_tochar:
+      if (i->num_ops != 1 || !t || !t->isChar() || !type_of(0)->isInt()) {
+        return "tochar of something other than an int";
+      }
+      return nullptr;
+    case ir_toint:
+      if (i->num_ops != 1 || !t || !t->isInt() || !(type_of(0)->isBool() || type_of(0)->isChar())) {
+        return "toint of something other than a bool or char";
+      }
+      return nullptr;
+    case ir_itof:
+      if (i->num_ops != 1 || !isFloat(t) || !type_of(0)->isInt()) {
+        return "itof of something other than an int";
+      }
+      return nullptr;
+    case ir_ftoi:
+      if (i->num_ops != 1 || !t || !t->isInt() || !isFloat(type_of(0))) {
+        return "ftoi of something other than a float";
+      }
+      return nullptr;
+    case ir_alloca:
+      if (i->num_ops != 0 || !t || !t->isReference()) {
+        return "alloca that does not produce an address";
+      }
+      return nullptr;
+    case ir_load:
+      if (i->num_ops != 1 || !isReferenceTo(type_of(0), t)) {
+        return "load from an address of the wrong type";
+      }
+      return nullptr;
+    case ir_store:
+      if (i->num_ops != 2 || t || !isReferenceTo(type_of(0), type_of(1))) {
+        return "store to an address of the wrong type";
+      }
+      return nullptr;
+    case ir_call: {
+      if (i->num_ops == 0 || !type_of(0)->isFunction()) {
+        return "call of something that is not a function";
+      }
+      const fn_type* f = static_cast<const fn_type*>(type_of(0));
+      const type_list& parms = f->getParameterTypes();
+      if (i->num_ops != parms.size() + 1 || t != f->getReturnType()) {
+        return "call with the wrong number of arguments or result type";
+      }
+      for (std::size_t n = 0; n != parms.size(); ++n) {
+        if (type_of(n + 1) != parms[n]) {
+          return "call with an argument of the wrong type";
+        }
+      }
+      return nullptr;
+    }
+    case ir_phi:
+      for (std::uint32_t n = 0; n != i->num_ops; ++n) {
+        if (type_of(n) != t) {
+          return "phi with an operand of the wrong type";
+        }
+      }
+      return t ? nullptr : "phi without a type";
+    case ir_br:
+      if (i->num_ops != 0 || t || !i->targets[0]) {
+        return "malformed br";
+      }
+      return nullptr;
+    case ir_condbr:
+      if (i->num_ops != 1 || t || !type_of(0)->isBool() || !i->targets[0] || !i->targets[1]) {
+        return "condbr on something other than a bool";
+      }
+      return nullptr;
+    case ir_ret:
+      if (i->num_ops != 1 || t || type_of(0) != fn->getReturnType()) {
+        return "ret of a value of the wrong type";
+      }
+      return nullptr;
+  }
+  return "unknown operation";
+}
+
+//Dominators are found with the iterative algorithm of Cooper, Harvey and
+//Kennedy over a reverse postorder of the blocks.
+void ir_function::verify() const {
+  auto fail = [this](const ir_block* b, const std::string& msg) {
+    std::stringstream ss;
+    ss << "invalid IR in '" << m_decl->getName()->str() << "', b" << b->id << ": " << msg;
+    throw std::logic_error(ss.str());
+  };
+
+  if (m_blocks.empty()) {
+    throw std::logic_error("invalid IR in '" + std::string(m_decl->getName()->str()) + "': no blocks");
+  }
+  std::unordered_map<const ir_block*, std::size_t> index;
+  for (std::size_t n = 0; n != m_blocks.size(); ++n) {
+    index.emplace(m_blocks[n], n);
+  }
+  if (!m_blocks[0]->preds.empty()) {
+    fail(m_blocks[0], "the entry block has predecessors");
+  }
+
+  //Each block is a run of phis, then other instructions, then exactly
+  //one terminator. Its successors list it as a predecessor as often as
+  //it branches to them.
+  std::unordered_map<const ir_insn*, std::size_t> position;
+  std::vector<std::vector<std::size_t>> succs(m_blocks.size());
+  for (std::size_t n = 0; n != m_blocks.size(); ++n) {
+    const ir_block* b = m_blocks[n];
+    const ir_insn* term = b->getTerminator();
+    if (!term) {
+      fail(b, "the block does not end in a terminator");
+    }
+    bool body = false;
+    std::size_t pos = 0;
+    for (const ir_insn* i = b->first; i; i = i->next) {
+      if (i->block != b || (i->next ? i->next->prev : b->last) != i) {
+        fail(b, "the instruction list is not linked correctly");
+      }
+      if (isTerminator(i->op) && i != term) {
+        fail(b, "a terminator in the middle of the block");
+      }
+      if (i->op == ir_phi) {
+        if (body) {
+          fail(b, "a phi after other instructions");
+        }
+        if (i->num_ops != b->preds.size()) {
+          fail(b, "a phi without one operand per predecessor");
+        }
+      } else {
+        body = true;
+      }
+      for (std::uint32_t k = 0; k != i->num_ops; ++k) {
+        if (!i->ops[k] || !i->ops[k]->ty) {
+          fail(b, "an operand that is missing or produces nothing");
+        }
+      }
+      if (const char* msg = checkTypes(m_decl, i)) {
+        fail(b, msg);
+      }
+      position.emplace(i, pos++);
+    }
+    for (std::size_t t = 0; t != (term->op == ir_condbr ? 2u : term->op == ir_br ? 1u : 0u); ++t) {
+      auto iter = index.find(term->targets[t]);
+      if (iter == index.end()) {
+        fail(b, "a branch to a block that is not in the function");
+      }
+      succs[n].push_back(iter->second);
+    }
+  }
+  for (std::size_t n = 0; n != m_blocks.size(); ++n) {
+    const ir_block* b = m_blocks[n];
+    for (const ir_block* p : b->preds) {
+      auto iter = index.find(p);
+      if (iter == index.end()) {
+        fail(b, "a predecessor that is not in the function");
+      }
+      const std::vector<std::size_t>& s = succs[iter->second];
+      std::size_t edges = std::count(s.begin(), s.end(), n);
+      if (edges != static_cast<std::size_t>(std::count(b->preds.begin(), b->preds.end(), p))) {
+        fail(b, "predecessors that do not match the branches");
+      }
+    }
+    for (std::size_t s : succs[n]) {
+      const std::vector<ir_block*>& preds = m_blocks[s]->preds;
+      if (std::find(preds.begin(), preds.end(), b) == preds.end()) {
+        fail(b, "a successor that does not list the block as a predecessor");
+      }
+    }
+  }
+
+  //Postorder numbers from a depth-first search of the entry.
+  std::vector<std::size_t> order;
+  std::vector<std::size_t> post(m_blocks.size(), SIZE_MAX);
+  std::vector<std::pair<std::size_t, std::size_t>> stack = {{0, 0}};
+  std::vector<bool> seen(m_blocks.size(), false);
+  seen[0] = true;
+  while (!stack.empty()) {
+    auto& [n, next] = stack.back();
+    if (next != succs[n].size()) {
+      std::size_t s = succs[n][next++];
+      if (!seen[s]) {
+        seen[s] = true;
+        stack.push_back({s, 0});
+      }
+      continue;
+    }
+    post[n] = order.size();
+    order.push_back(n);
+    stack.pop_back();
+  }
+  for (std::size_t n = 0; n != m_blocks.size(); ++n) {
+    if (!seen[n]) {
+      fail(m_blocks[n], "the block is unreachable");
+    }
+  }
+
+  std::vector<std::size_t> idom(m_blocks.size(), SIZE_MAX);
+  idom[0] = 0;
+  auto intersect = [&](std::size_t a, std::size_t b) {
+    while (a != b) {
+      while (post[a] < post[b]) {
+        a = idom[a];
+      }
+      while (post[b] < post[a]) {
+        b = idom[b];
+      }
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto r = order.rbegin(); r != order.rend(); ++r) {
+      if (*r == 0) {
+        continue;
+      }
+      std::size_t d = SIZE_MAX;
+      for (const ir_block* p : m_blocks[*r]->preds) {
+        std::size_t pn = index.at(p);
+        if (idom[pn] != SIZE_MAX) {
+          d = d == SIZE_MAX ? pn : intersect(pn, d);
+        }
+      }
+      if (idom[*r] != d) {
+        idom[*r] = d;
+        changed = true;
+      }
+    }
+  }
+  auto dominates = [&](std::size_t a, std::size_t b) {
+    for (;;) {
+      if (a == b) {
+        return true;
+      }
+      if (b == 0) {
+        return false;
+      }
+      b = idom[b];
+    }
+  };
+
+  //A phi uses its operand at the end of the matching predecessor.
+  for (std::size_t n = 0; n != m_blocks.size(); ++n) {
+    const ir_block* b = m_blocks[n];
+    for (const ir_insn* i = b->first; i; i = i->next) {
+      for (std::uint32_t k = 0; k != i->num_ops; ++k) {
+        const ir_value* v = i->ops[k];
+        if (v->kind == ir_value::param_kind) {
+          const ir_param* p = static_cast<const ir_param*>(v);
+          if (p->index >= m_params.size() || m_params[p->index] != p) {
+            fail(b, "a parameter of another function");
+          }
+        }
+        if (v->kind != ir_value::insn_kind) {
+          continue;
+        }
+        const ir_insn* def = static_cast<const ir_insn*>(v);
+        auto iter = index.find(def->block);
+        if (!def->block || iter == index.end() || !position.count(def)) {
+          fail(b, "a use of an instruction that is not in the function");
+        }
+        std::size_t use = i->op == ir_phi ? index.at(b->preds[k]) : n;
+        bool ok = i->op != ir_phi && iter->second == n ? position.at(def) < position.at(i) : dominates(iter->second, use);
+        if (!ok) {
+          fail(b, "a use that its definition does not dominate");
+        }
+      }
+    }
+  }
+}
+
+
+void ir_program::print(std::ostream& os) const {
+  for (std::size_t n = 0; n != m_fns.size(); ++n) {
+    os << (n ? "\n" : "");
+    m_fns[n]->print(os);
+  }
+}
+
+void ir_program::verify() const {
+  for (const auto& fn : m_fns) {
+    fn->verify();
+  }
+}
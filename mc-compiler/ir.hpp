@@ -0,0 +1,225 @@
+#pragma once
+
+#include "arena.hpp"
+#include "value.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class decl;
+class fn_decl;
+class type;
+
+// A mid-level IR in SSA form: functions are graphs of basic blocks whose
+// instructions compute typed values, with phis where control flow joins.
+// Values are typed with MC's own types; an address has the reference type
+// of the object it designates. Every operation has MC's semantics, so
+// div and rem trap on a zero divisor and ftoi saturates.
+#define MC_IR_OPS(X) \
+  X(add) X(sub) X(mul) X(div) X(rem) \
+  X(band) X(bor) X(bxor) X(shl) X(shr) \
+  X(fadd) X(fsub) X(fmul) X(fdiv) X(frem) \
+  X(neg) X(bnot) X(fneg)  /*bnot is also a bool's not*/ \
+  X(eq) X(ne) X(lt) X(gt) X(le) X(ge) /*Signed for chars and ints*/ \
+  X(tobool)  /*x != 0*/ \
+  X(tochar)  /*Truncates an int*/ \
+  X(toint)   /*Extends a bool or char*/ \
+  X(itof) X(ftoi) \
+  X(alloca)  /*The address of a new local object*/ \
+  X(load)    /*load addr*/ \
+  X(store)   /*store addr, value*/ \
+  X(call)    /*call fn, args...*/ \
+  X(phi)     /*One operand per predecessor, in order*/ \
+  X(br)      /*br target*/ \
+  X(condbr)  /*condbr cond, true target, false target*/ \
+  X(ret)     /*ret value*/
+
+enum ir_op : std::uint8_t {
+#define MC_IR_ENUM(name) ir_##name,
+  MC_IR_OPS(MC_IR_ENUM)
+#undef MC_IR_ENUM
+};
+
+const char* toString(ir_op op);
+
+inline bool isTerminator(ir_op op) {
+  return op == ir_br || op == ir_condbr || op == ir_ret;
+}
+
+struct ir_block;
+
+// Something an instruction can use. 'ty' is null for instructions that
+// produce nothing. Ids number the parameters and instructions of a
+// function for printing.
+struct ir_value {
+  enum value_kind {
+    constant_kind,
+    param_kind,
+    global_kind, //A global variable's address, or a function
+    insn_kind,
+  };
+
+  ir_value(value_kind k, const type* t) : kind(k), ty(t), id(0) {}
+
+  value_kind kind;
+  const type* ty;
+  std::uint32_t id;
+};
+
+struct ir_constant : ir_value {
+  ir_constant(const type* t, const_value v) : ir_value(constant_kind, t), value(v) {}
+
+  const_value value;
+};
+
+struct ir_param : ir_value {
+  ir_param(const type* t, const decl* d, std::uint32_t n) : ir_value(param_kind, t), var(d), index(n) {}
+
+  const decl* var;
+  std::uint32_t index;
+};
+
+struct ir_global : ir_value {
+  ir_global(const type* t, const decl* d) : ir_value(global_kind, t), var(d) {}
+
+  const decl* var;
+};
+
+// Instructions are linked into their block in order. 'var' names the
+// local an alloca or phi stands for, if any.
+struct ir_insn : ir_value {
+  ir_insn(ir_op op, const type* t) : ir_value(insn_kind, t), op(op), block(), prev(), next(), ops(), num_ops(0), targets(), var(), replacement() {}
+
+  ir_op op;
+  ir_block* block;
+  ir_insn* prev;
+  ir_insn* next;
+  ir_value** ops;
+  std::uint32_t num_ops;
+  ir_block* targets[2];
+  const decl* var;
+  ir_value* replacement; //Set on a phi found to be redundant while building
+};
+
+struct ir_block {
+  explicit ir_block(std::uint32_t n) : id(n), first(), last() {}
+
+  ir_insn* getTerminator() const {
+    return last && isTerminator(last->op) ? last : nullptr;
+  }
+
+  std::uint32_t id;
+  ir_insn* first;
+  ir_insn* last;
+  std::vector<ir_block*> preds;
+};
+
+// A function and everything in it, allocated from its own arena.
+class ir_function {
+  public:
+    explicit ir_function(const fn_decl* fn);
+    ~ir_function();
+
+    ir_function(const ir_function&) = delete;
+    ir_function& operator=(const ir_function&) = delete;
+
+    const fn_decl* getDecl() const {
+      return m_decl;
+    }
+
+    const std::vector<ir_param*>& getParams() const {
+      return m_params;
+    }
+
+    // The blocks in layout order. The first is the entry.
+    const std::vector<ir_block*>& getBlocks() const {
+      return m_blocks;
+    }
+
+    ir_param* addParam(const type* t, const decl* d);
+    ir_constant* getConstant(const type* t, const_value v);
+    ir_global* getGlobal(const type* t, const decl* d);
+
+    // A block that is not yet part of the layout.
+    ir_block* makeBlock();
+    void addBlock(ir_block* b);
+
+    // An instruction with room for 'n' operands.
+    ir_insn* makeInsn(ir_op op, const type* t, std::uint32_t n);
+    ir_value** makeOperands(std::uint32_t n);
+
+    // Links 'i' into 'b' after 'pos', or first if 'pos' is null.
+    void insertAfter(ir_block* b, ir_insn* pos, ir_insn* i);
+    void append(ir_block* b, ir_insn* i);
+    void remove(ir_insn* i);
+
+    // Numbers the blocks, parameters and instructions in order.
+    void renumber();
+
+    void print(std::ostream& os) const;
+
+    // Throws std::logic_error describing the first problem found: a block
+    // without exactly one terminator at its end, a phi out of place or
+    // with the wrong number of operands, predecessors that disagree with
+    // the branches, operands of the wrong type, unreachable blocks, or a
+    // value used where its definition does not dominate.
+    void verify() const;
+
+  private:
+    template<typename T, typename... Args>
+    T* make(Args&&... args);
+
+    struct finalizer {
+      void* node;
+      void (*destroy)(void*);
+    };
+
+    const fn_decl* m_decl;
+    arena m_mem;
+    std::vector<finalizer> m_finalizers;
+    std::vector<ir_param*> m_params;
+    std::vector<ir_block*> m_blocks;
+    std::unordered_map<const decl*, ir_global*> m_globals;
+    std::uint32_t m_next_block;
+};
+
+template<typename T, typename... Args>
+inline T* ir_function::make(Args&&... args) {
+  void* mem = m_mem.allocate(sizeof(T), alignof(T));
+  T* n = new (mem) T(std::forward<Args>(args)...);
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    m_finalizers.push_back({n, [](void* p) { static_cast<T*>(p)->~T(); }});
+  }
+  return n;
+}
+
+// Every function of a checked program with a body, in SSA form.
+class ir_program {
+  public:
+    // Builds each function with on-the-fly SSA construction: locals
+    // become SSA values directly, and only those whose address is used,
+    // through a conditional reference, get an alloca. Throws if the
+    // program uses something the IR does not support.
+    explicit ir_program(const decl* prog);
+
+    const decl* getDecl() const {
+      return m_prog;
+    }
+
+    const std::vector<std::unique_ptr<ir_function>>& getFunctions() const {
+      return m_fns;
+    }
+
+    void print(std::ostream& os) const;
+    void verify() const;
+
+  private:
+    const decl* m_prog;
+    std::vector<std::unique_ptr<ir_function>> m_fns;
+};
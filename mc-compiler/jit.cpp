@@ -0,0 +1,89 @@
+#include "jit.hpp"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+template<typename T>
+static T check(llvm::Expected<T> x) {
+    if (!x) {
+        throw std::runtime_error("jit: " + llvm::toString(x.takeError()));
+    }
+    return std::move(*x);
+}
+
+static void check(llvm::Error err) {
+    if (err) {
+        throw std::runtime_error("jit: " + llvm::toString(std::move(err)));
+    }
+}
+
+//The entry point has to be 'def main() -> int'.
+static void requireMain(const llvm::Module& mod) {
+    const llvm::Function* fn = mod.getFunction("main");
+    if (!fn || fn->isDeclaration()) {
+        throw std::runtime_error("the program has no main function");
+    }
+    const llvm::FunctionType* t = fn->getFunctionType();
+    if (t->getNumParams() != 0 || !t->getReturnType()->isIntegerTy(32)) {
+        throw std::runtime_error("main must take no arguments and return int");
+    }
+}
+
+//The first error the session reported. A function that fails to compile
+//lazily is only noticed when it is called, long after the report.
+static std::string session_error;
+
+//Called in place of a function that could not be compiled; there is no
+//way back into the caller, so this ends the run like any other error.
+static void failLazyCompile() {
+    std::cerr << "error: jit: " << (session_error.empty() ? "a function could not be compiled" : session_error) << '\n';
+    std::exit(1);
+}
+
+int runMain(std::unique_ptr<llvm::LLVMContext> cxt, std::unique_ptr<llvm::Module> mod) {
+    //Owns both from here on, and destroys the module before its context.
+    llvm::orc::ThreadSafeModule tsm(std::move(mod), std::move(cxt));
+    requireMain(*tsm.getModuleUnlocked());
+
+    static std::once_flag init;
+    std::call_once(init, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    //The lazy JIT replaces each function with a stub that compiles it on
+    //its first call.
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit = check(llvm::orc::LLLazyJITBuilder()
+        .setLazyCompileFailureAddr(llvm::pointerToJITTargetAddress(&failLazyCompile))
+        .create());
+    jit->getExecutionSession().setErrorReporter([](llvm::Error err) {
+        std::string msg = llvm::toString(std::move(err));
+        if (session_error.empty()) {
+            session_error = msg;
+        }
+    });
+
+    //Library functions the generated code calls, such as fmodf for float
+    //remainders, come from the running process.
+    const llvm::DataLayout& dl = jit->getDataLayout();
+    jit->getMainJITDylib().addGenerator(check(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(dl.getGlobalPrefix())));
+    tsm.getModuleUnlocked()->setDataLayout(dl);
+    check(jit->addLazyIRModule(std::move(tsm)));
+
+    llvm::JITEvaluatedSymbol sym = check(jit->lookup("main"));
+    auto main = reinterpret_cast<int (*)()>(static_cast<std::uintptr_t>(sym.getAddress()));
+    return main();
+}
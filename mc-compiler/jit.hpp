@@ -0,0 +1,14 @@
+#pragma once
+
+#include <memory>
+
+namespace llvm {
+  class LLVMContext;
+  class Module;
+}
+
+// Runs the program in 'mod' in this process and returns what its main
+// function returns. Functions are compiled to machine code the first
+// time they are called, so only the code that runs is ever compiled.
+// The module and its context are consumed.
+int runMain(std::unique_ptr<llvm::LLVMContext> cxt, std::unique_ptr<llvm::Module> mod);
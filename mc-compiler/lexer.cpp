@@ -1,9 +1,12 @@
 #include "lexer.hpp"
 #include "file.hpp"
+#include "scan.hpp"
+#include "chars.hpp"
 
-#include <cctype>
 #include <cassert>
+#include <charconv>
 #include <sstream>
+#include <string_view>
 #include <iostream>
 
 
@@ -15,72 +18,124 @@ static const char* getEndOfInput(const file& f) {
     return f.getText().data() + f.getText().size();
 }
 
-static bool isSpace(char c) {
-    return c == ' ' || c == '\t';
-}
-
-static bool isNewline(char c) {
-    return c == '\n';
+static bool isBinDigit(char c) {
+    return hasCharClass(c, cc_bin_digit);
 }
 
-static bool isNondigit(char c) {
-    return std::isalpha(c) || c == '_';
+static bool isHexDigit(char c) {
+  return hasCharClass(c, cc_hex_digit);
 }
 
-static bool isDigit(char c) {
-    return std::isdigit(c);
+static bool isCharChar(char c) {
+    return c != '\n' && c != '\'';
 }
 
-static bool isAlphanumeric(char c) {
-    return std::isalnum(c);
+static bool isStringChar(char c) {
+    return c != '\n' && c != '"';
 }
 
-static bool isBinDigit(char c) {
-    return c == '0' || c == '1';
+//The reserved words. This includes words that have no real meaning other
+//than to indicate a specific statement, words that control logic, literal
+//words (T/F) and those that define an object type.
+struct reserved_word {
+    std::string_view spelling;
+    token_name name;
+    int value; //The boolean or type specifier, if any.
+};
+
+static constexpr reserved_word reserved_words[] = {
+    {"def", kw_def, 0},
+    {"if", kw_if, 0},
+    {"else", kw_else, 0},
+    {"var", kw_var, 0},
+    {"let", kw_let, 0},
+    {"true", tok_boolean, true},
+    {"false", tok_boolean, false},
+    {"char", tok_type_specifier, ts_char},
+    {"int", tok_type_specifier, ts_int},
+    {"bool", tok_type_specifier, ts_bool},
+    {"float", tok_type_specifier, ts_float},
+    {"as", kw_as, 0},
+    {"break", kw_break, 0},
+    {"continue", kw_continue, 0},
+    {"return", kw_return, 0},
+    {"while", kw_while, 0},
+};
+
+static constexpr std::size_t min_reserved_length = 2;
+static constexpr std::size_t max_reserved_length = 8;
+
+//Hashes the length and the first and last characters of a word. The
+//multipliers were chosen so that no two reserved words collide.
+static constexpr unsigned hashReservedWord(const char* str, std::size_t len) {
+    return (len + static_cast<unsigned char>(str[0]) * 6 + static_cast<unsigned char>(str[len - 1]) * 3) & 31;
+}
+
+//Maps each hash value to an index in reserved_words, or -1. A collision
+//is not a constant expression, so it fails the build.
+static constexpr std::array<signed char, 32> makeReservedWordTable() {
+    std::array<signed char, 32> t{};
+    for (signed char& i : t) {
+        i = -1;
+    }
+    for (std::size_t i = 0; i != std::size(reserved_words); ++i) {
+        std::string_view str = reserved_words[i].spelling;
+        unsigned h = hashReservedWord(str.data(), str.size());
+        if (t[h] != -1) {
+            throw "reserved word hash collision";
+        }
+        t[h] = i;
+    }
+    return t;
 }
 
-static bool isHexDigit(char c) {
-  return std::isxdigit(c);
-}
+static constexpr std::array<signed char, 32> reserved_word_table = makeReservedWordTable();
 
-static bool isCharChar(char c) {
-    return c != '\n' && c != '\'';
+//Returns the reserved word spelled by [str, str + len), or null.
+static const reserved_word* findReservedWord(const char* str, std::size_t len) {
+    if (len < min_reserved_length || max_reserved_length < len) {
+        return nullptr;
+    }
+    int i = reserved_word_table[hashReservedWord(str, len)];
+    if (i < 0 || reserved_words[i].spelling != std::string_view(str, len)) {
+        return nullptr;
+    }
+    return &reserved_words[i];
 }
 
-static bool isStringChar(char c) {
-    return c != '\n' && c != '"';
+static token makeReservedToken(const reserved_word& rw, location loc) {
+    switch (rw.name) {
+      case tok_boolean:
+        return {static_cast<bool>(rw.value), loc};
+      case tok_type_specifier:
+        return {static_cast<type_spec>(rw.value), loc};
+      default:
+        return {rw.name, loc};
+    }
 }
 
-lexer::lexer(symbol_table& syms, const file& f) : 
+lexer::lexer(symbol_table& syms, const file& f) :
   symbols(syms),
   m_first(getStartOfInput(f)),
   m_last(getEndOfInput(f)),
-  m_curr_loc(f, 0, 0) {
-    
-    //Add the reserved words to the unordered map to watch for
-    //This includes words that have no real meaning other than to indicate a specific statement,
-    //Words that control logic
-    //Literal words (T/F)
-    //And those that define an object type
-    m_res_words.insert({
-        {symbols.get("def"), kw_def},
-        {symbols.get("if"), kw_if},
-        {symbols.get("else"), kw_else},
-        {symbols.get("var"), kw_var},
-        {symbols.get("let"), kw_let},
-        {symbols.get("true"), true},
-        {symbols.get("false"), false},
-        {symbols.get("char"), ts_char},
-        {symbols.get("int"), ts_int},
-        {symbols.get("bool"), ts_bool},
-        {symbols.get("float"), ts_float},
-        {symbols.get("as"), kw_as},
-        {symbols.get("break"), kw_break},
-        {symbols.get("continue"), kw_continue},
-        {symbols.get("return"), kw_return},
-        {symbols.get("while"), kw_while},
-        });
+  m_curr_loc(f, 0, 0) {}
+
+//Converts the digits in [first, last) in place.
+long long lexer::parseInteger(const char* first, const char* last, int base) const {
+    long long val;
+    std::from_chars_result r = std::from_chars(first, last, val, base);
+    if (r.ec == std::errc::result_out_of_range) {
+        std::stringstream ss;
+        ss << m_tok_loc << ": integer literal is out of range";
+        throw std::runtime_error(ss.str());
     }
+    if (r.ec != std::errc() || r.ptr != last) {
+        std::stringstream ss;
+        ss << m_tok_loc << ": invalid integer literal";
+        throw std::runtime_error(ss.str());
+    }
+    return val;
+}
 
 token lexer::lexHexNum() {
     accept(2);
@@ -89,8 +144,7 @@ token lexer::lexHexNum() {
         accept();
     }
 
-    std::string str(start, m_first);
-    return {hexadecimal, std::strtoll(str.c_str(), nullptr, 16), m_tok_loc};
+    return {hexadecimal, parseInteger(start, m_first, 16), m_tok_loc};
 }
 
 token lexer::lexBinNum() {
@@ -101,8 +155,7 @@ token lexer::lexBinNum() {
         accept();
     }
 
-    std::string str(start, m_first);
-    return {binary, std::strtoll(str.c_str(), nullptr, 2), m_tok_loc};
+    return {binary, parseInteger(start, m_first, 2), m_tok_loc};
 }
 
 token lexer::lexPunc(token_name n) {
@@ -130,13 +183,16 @@ token lexer::lexBitwiseOp(int len, bitwise_op op) {
     return {op, m_tok_loc};
 }
 
+token lexer::lexLogicalOp(int len, logical_op op) {
+    accept(len);
+    return {op, m_tok_loc};
+}
+
 token lexer::lexConditionalOp() {
     accept();
     return {tok_conditional_operator, m_tok_loc};
 }
 
-//isSpace Counts if there is either a space or tab
-
 
 bool lexer::eof() const {
   //Check if first char is same as last
@@ -164,6 +220,13 @@ char lexer::accept() {
     return c;
 }
 
+//Move to 'p', which must not be past a newline.
+void lexer::advance(const char* p) {
+    assert(m_first <= p && p <= m_last);
+    m_curr_loc.column += p - m_first;
+    m_first = p;
+}
+
 void lexer::accept(int n) {
     while (n) {
     accept();
@@ -172,139 +235,201 @@ void lexer::accept(int n) {
 }
 
 char lexer::ignore() {
-  accept();
-}
+  return accept();
+}
+
+
+//Operator attributes for the characters that start single-character
+//punctuators and operators.
+static constexpr std::array<token_name, 256> makePunctuatorTable() {
+    std::array<token_name, 256> t{};
+    t['['] = tok_left_bracket;
+    t['('] = tok_left_paren;
+    t['{'] = tok_left_brace;
+    t[']'] = tok_right_bracket;
+    t[')'] = tok_right_paren;
+    t['}'] = tok_right_brace;
+    t[','] = tok_comma;
+    t[';'] = tok_semicolon;
+    t[':'] = tok_colon;
+    return t;
+}
+
+static constexpr std::array<arithmetic_op, 256> makeArithmeticTable() {
+    std::array<arithmetic_op, 256> t{};
+    t['+'] = op_add;
+    t['*'] = op_mul;
+    t['/'] = op_div;
+    t['%'] = op_mod;
+    return t;
+}
+
+static constexpr std::array<bitwise_op, 256> makeBitwiseTable() {
+    std::array<bitwise_op, 256> t{};
+    t['&'] = op_and;
+    t['|'] = op_ior;
+    t['^'] = op_xor;
+    t['~'] = op_not;
+    return t;
+}
+
+static constexpr std::array<token_name, 256> punctuators = makePunctuatorTable();
+static constexpr std::array<arithmetic_op, 256> arithmetic_ops = makeArithmeticTable();
+static constexpr std::array<bitwise_op, 256> bitwise_ops = makeBitwiseTable();
+
+//Each possible first byte of a token selects the handler that lexes it.
+//Handlers that only skip input return the eof token.
+constexpr lexer::dispatch_table lexer::makeDispatchTable() {
+    dispatch_table t{};
+    for (handler& h : t) {
+        h = &lexer::lexInvalid;
+    }
 
+    t[' '] = &lexer::skipSpace;
+    t['\t'] = &lexer::skipSpace;
+    t['\n'] = &lexer::skipNewline;
+    t['#'] = &lexer::skipComment;
+
+    for (char c : {'[', '(', '{', ']', ')', '}', ',', ';', ':'}) {
+        t[c] = &lexer::lexPunctuator;
+    }
+    for (char c : {'+', '*', '/', '%'}) {
+        t[c] = &lexer::lexArithmetic;
+    }
+    for (char c : {'^', '~'}) {
+        t[c] = &lexer::lexBitwise;
+    }
+
+    t['<'] = &lexer::lexLess;
+    t['>'] = &lexer::lexGreater;
+    t['='] = &lexer::lexEqual;
+    t['-'] = &lexer::lexMinus;
+    t['&'] = &lexer::lexAmpersand;
+    t['|'] = &lexer::lexBar;
+    t['!'] = &lexer::lexBang;
+    t['?'] = &lexer::lexConditionalOp;
+    t['\''] = &lexer::lexChar;
+    t['"'] = &lexer::lexString;
+
+    for (int c = 0; c != 256; ++c) {
+        if (char_classes[c] & cc_nondigit) {
+            t[c] = &lexer::lexWord;
+        } else if (char_classes[c] & cc_digit) {
+            t[c] = &lexer::lexNumber;
+        }
+    }
+    return t;
+}
 
 token lexer::scan() {
+    static constexpr dispatch_table dispatch = makeDispatchTable();
+
     while (!eof()) {
-    
       m_tok_loc = m_curr_loc;
-      switch(*m_first) {
-        //Skip all spaces
-        case ' ':
-        case '\t':
-            skipSpace();
-            continue;
-
-        case '\n':
-            skipNewline();
-            continue;
-        case '#':
-            skipComment();
-            continue;
-
-        case '[':
-            return lexPunc(tok_left_bracket);
-        case '(':
-            return lexPunc(tok_left_paren);
-        case '{':
-            return lexPunc(tok_left_brace);
-        case ']':
-            return lexPunc(tok_right_bracket);
-        case ')':
-            return lexPunc(tok_right_paren);
-        case '}':
-            return lexPunc(tok_right_brace);
-        case ',':
-            return lexPunc(tok_comma);
-        case ';':
-            return lexPunc(tok_semicolon);
-        case ':':
-            return lexPunc(tok_colon);
-
-        //There are several cases for < (<<, <=, <)
-        case '<':
-            if (peek(1) == '<') {
-            return lexBitwiseOp(2, op_shl);
-            } else if (peek(1) == '=') {
-            return lexRelationalOp(2, op_le);
-            } else {
-                return lexRelationalOp(1, op_lt);
-            }
-        case '>':
-            if (peek(1) == '>') {
-            return lexBitwiseOp(2, op_shr);
-            } else if (peek(1) == '=') {
-            return lexRelationalOp(2, op_ge);
-            } else {
-                return lexRelationalOp(1, op_gt);
-            }
-        
-        //Must be either assignment (=) or rel eq (==).
-        case '=':
-            if (peek(1) == '=') {
-            return lexRelationalOp(2, op_eq);
-            } else {
-            return lexAssignmentOp();}
-
-        case '+':
-            return lexArithmeticOp(op_add);
-        case '-':
-            //Check for arrow op too
-            if (peek(1) == '>') {
-              return lexArrowOp();
-            }
-            return lexArithmeticOp(op_sub);
-        case '*':
-            return lexArithmeticOp(op_mul);
-        case '/':
-            return lexArithmeticOp(op_div);
-        case '%':
-            return lexArithmeticOp(op_mod);
-
-        case '&':
-            return lexBitwiseOp(1, op_and);
-        case '|':
-            return lexBitwiseOp(1, op_ior);
-        case '^':
-            return lexBitwiseOp(1, op_xor);
-        case '~':
-            return lexBitwiseOp(1, op_not);
-
-        case '?':
-            return lexConditionalOp();
-        case '\'':
-            return lexChar();
-        case '"':
-            return lexString();
-
-        default: {
-            if (isNondigit(*m_first)) {
-            return lexWord();
-            } else if (isDigit(*m_first)) {
-            return lexNumber();
-            }
-            std::stringstream ss;
-            ss << "invalid char '" << *m_first << '\'';
-            throw std::runtime_error(ss.str());
-        }
+      handler h = dispatch[static_cast<unsigned char>(*m_first)];
+      if (token tok = (this->*h)()) {
+        return tok;
       }
     }
     return {};
 }
 
-void lexer::skipSpace() {
-   assert(isSpace(*m_first));
-   ignore();
-   while (!eof() && isSpace(*m_first)) {
-    ignore();
-   }
+token lexer::lexPunctuator() {
+    return lexPunc(punctuators[static_cast<unsigned char>(*m_first)]);
+}
+
+token lexer::lexArithmetic() {
+    return lexArithmeticOp(arithmetic_ops[static_cast<unsigned char>(*m_first)]);
+}
+
+token lexer::lexBitwise() {
+    return lexBitwiseOp(1, bitwise_ops[static_cast<unsigned char>(*m_first)]);
 }
 
-void lexer::skipNewline() {
+//There are several cases for < (<<, <=, <)
+token lexer::lexLess() {
+    if (peek(1) == '<') {
+        return lexBitwiseOp(2, op_shl);
+    } else if (peek(1) == '=') {
+        return lexRelationalOp(2, op_le);
+    } else {
+        return lexRelationalOp(1, op_lt);
+    }
+}
+
+token lexer::lexGreater() {
+    if (peek(1) == '>') {
+        return lexBitwiseOp(2, op_shr);
+    } else if (peek(1) == '=') {
+        return lexRelationalOp(2, op_ge);
+    } else {
+        return lexRelationalOp(1, op_gt);
+    }
+}
+
+//Must be either assignment (=) or rel eq (==).
+token lexer::lexEqual() {
+    if (peek(1) == '=') {
+        return lexRelationalOp(2, op_eq);
+    } else {
+        return lexAssignmentOp();
+    }
+}
+
+//Check for arrow op too
+token lexer::lexMinus() {
+    if (peek(1) == '>') {
+        return lexArrowOp();
+    }
+    return lexArithmeticOp(op_sub);
+}
+
+token lexer::lexAmpersand() {
+    if (peek(1) == '&') {
+        return lexLogicalOp(2, logical_and);
+    }
+    return lexBitwiseOp(1, op_and);
+}
+
+token lexer::lexBar() {
+    if (peek(1) == '|') {
+        return lexLogicalOp(2, logical_or);
+    }
+    return lexBitwiseOp(1, op_ior);
+}
+
+//Either logical not (!) or rel ne (!=).
+token lexer::lexBang() {
+    if (peek(1) == '=') {
+        return lexRelationalOp(2, op_ne);
+    }
+    return lexLogicalOp(1, logical_not);
+}
+
+token lexer::lexInvalid() {
+    std::stringstream ss;
+    ss << "invalid char '" << *m_first << '\'';
+    throw std::runtime_error(ss.str());
+}
+
+token lexer::skipSpace() {
+   assert(hasCharClass(*m_first, cc_space));
+   advance(scanSpace(m_first + 1, m_last));
+   return {};
+}
+
+token lexer::skipNewline() {
     assert(*m_first == '\n');
     m_curr_loc.line += 1;
     m_curr_loc.column = 0;
     ++m_first;
+    return {};
 }
 
-void lexer::skipComment() {
+token lexer::skipComment() {
     assert(*m_first == '#');
-    ignore();
-    while (!eof() && !isNewline(*m_first)) {
-        ignore();
-    }
+    advance(scanLine(m_first + 1, m_last));
+    return {};
 }
 
 token lexer::lexChar() {
@@ -347,60 +472,63 @@ token lexer::lexString() {
     assert(*m_first == '"');
     accept();
 
-    if (eof()) {
-        throw std::runtime_error("char literal is not terminated"); 
+    //Most literals have no escapes. Those are interned straight from the
+    //source text.
+    const char* start = m_first;
+    const char* p = start;
+    while (p != m_last && isStringChar(*p) && *p != '\\') {
+        ++p;
+    }
+    advance(p);
+    if (!eof() && *m_first == '"') {
+        accept();
+        return {string_attr{symbols.get(std::string_view(start, p - start))}, m_tok_loc};
     }
 
-    std::string str;
-    str.reserve(32);
-    while (*m_first != '"') {
-      char c;
-      
+    //Otherwise, decode into a buffer that is reused across literals.
+    m_buf.assign(start, p);
+    while (true) {
+      if (eof()) {
+        throw std::runtime_error("string literal is not terminated");
+      }
+      if (*m_first == '"') {
+        break;
+      }
+
       if (*m_first == '\\') {
-        c = scanEscSeq();
-      } else if (isStringChar(*m_first)) { 
-        c = accept();
-      } else if (*m_first == '\n') {
+        m_buf += scanEscSeq();
+      } else if (isStringChar(*m_first)) {
+        m_buf += accept();
+      } else {
         throw std::runtime_error("multi-line string is not valid");
       }
-      str += c;
     }
     accept();
-    return {string_attr{symbols.get(str)}, m_tok_loc};
-} 
+    return {string_attr{symbols.get(m_buf)}, m_tok_loc};
+}
 
 token lexer::lexWord() {
   //Make sure it is a word 
-  assert(isNondigit(*m_first));
+  assert(hasCharClass(*m_first, cc_nondigit));
 
   const char* start = m_first;
 
-  //Accept the first word
-  accept();
+  //Accept the first character and the rest of the identifier
+  advance(scanIdentifier(m_first + 1, m_last));
 
-  //While the next word exists and is alphanumeric, accept it
-  while (!eof() && isAlphanumeric(*m_first)) {
-  accept();
+  //Check if the word is a reserved word before interning it
+  if (const reserved_word* rw = findReservedWord(start, m_first - start)) {
+    return makeReservedToken(*rw, m_tok_loc);
   }
 
-  std::string str(start, m_first);
-  //Parse the word as a symbol
-  symbol sym = symbols.get(str);
-
-  //Check if the symbol is a reserved word, 
-  auto iter = m_res_words.find(sym);
-  if (iter != m_res_words.end()) {
-    const token& tok = iter->second;
-    return {tok.getName(), tok.getAttribute(), m_tok_loc};
-  } else {
-    //Otherwise, it must be an identifier
-    return {sym, m_tok_loc}; 
-  }
+  //Otherwise, it must be an identifier
+  symbol sym = symbols.get(std::string_view(start, m_first - start));
+  return {sym, m_tok_loc};
 }
 
   token lexer::lexNumber() {
     //Make sure the first char is a digit
-    assert(isdigit(*m_first)); 
+    assert(hasCharClass(*m_first, cc_digit));
     const char* start = m_first;
 
     //Detect if it is binary or hexadecimal
@@ -419,22 +547,24 @@ token lexer::lexWord() {
     }
 
     //Otherwise, it must be decimal
-    accept();
-    while(!eof() && isDigit(*m_first)) {
-        accept();
-    }
+    advance(scanDigits(m_first + 1, m_last));
 
     if (peek() != '.') {
-      std::string str(start, m_first);
-      return {decimal, std::atoi(str.c_str()), m_tok_loc};
+      return {decimal, parseInteger(start, m_first, 10), m_tok_loc};
     }
 
     accept();
-    while(!eof() && isDigit(*m_first)) {
-        accept();
-        std::string str(start, m_first);
-        return {std:atof(str.c_str()), m_tok_loc};
+    advance(scanDigits(m_first, m_last));
+
+    double val;
+    std::from_chars_result r = std::from_chars(start, m_first, val);
+    if (r.ec == std::errc::result_out_of_range) {
+      std::stringstream ss;
+      ss << m_tok_loc << ": floating point literal is out of range";
+      throw std::runtime_error(ss.str());
     }
+    assert(r.ec == std::errc() && r.ptr == m_first);
+    return {val, m_tok_loc};
   }
 
 
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "token.hpp"
-#include <unordered_map>
+
+#include <array>
 
 class file;
 
@@ -24,16 +25,35 @@ class lexer {
   private:
     char accept();
     void accept(int n);
+    void advance(const char* p);
     char ignore();
 
-    void skipSpace();
-    void skipNewline();
-    void skipComment();
+    using handler = token (lexer::*)();
+    using dispatch_table = std::array<handler, 256>;
+
+    static constexpr dispatch_table makeDispatchTable();
+
+    token skipSpace();
+    token skipNewline();
+    token skipComment();
+
+    token lexPunctuator();
+    token lexArithmetic();
+    token lexBitwise();
+    token lexLess();
+    token lexGreater();
+    token lexEqual();
+    token lexMinus();
+    token lexAmpersand();
+    token lexBar();
+    token lexBang();
+    token lexInvalid();
 
     token lexPunc(token_name n);
     token lexRelationalOp(int len, relation_op op);
     token lexArithmeticOp(arithmetic_op op);
     token lexBitwiseOp(int len, bitwise_op op);
+    token lexLogicalOp(int len, logical_op op);
     token lexArrowOp();
     token lexConditionalOp();
     token lexAssignmentOp();
@@ -45,6 +65,8 @@ class lexer {
     token lexString();
 
     char scanEscSeq();
+
+    long long parseInteger(const char* first, const char* last, int base) const;
     
 
     symbol_table& symbols;
@@ -56,8 +78,8 @@ class lexer {
 
     location m_tok_loc;
 
-    std::unordered_map<symbol, token> m_res_words;
-
+    //Scratch space for string literals with escape sequences.
+    std::string m_buf;
 };
 
 
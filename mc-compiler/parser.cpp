@@ -6,20 +6,15 @@
 #include<stdexcept>
 
 inline token_name parser::lookahead() {
-  assert(!m_tok.empty());
-  return m_tok.front().getName();
+  return peek().getName();
 }
 
 inline token_name parser::lookahead(int n) {
-    if (n < m_tok.size()) {
-        return m_tok[n].getName();
-    }
-    n = n - m_tok.size() + 1;
-    while (n != 0) {
-    fetch();
-    --n;
+    assert(0 <= n && n < static_cast<int>(max_lookahead));
+    while (static_cast<unsigned>(n) >= m_size) {
+        fetch();
     }
-    return m_tok.back().getName();
+    return m_tok[(m_first + n) % max_lookahead].getName();
 }
 
 token parser::match(token_name n) {
@@ -33,71 +28,14 @@ token parser::match(token_name n) {
 }
 
 
-token parser::matchIf(token_name n) {
+bool parser::matchIf(token_name n) {
     if (lookahead() == n) {
-        return accept();
+        accept();
+        return true;
     }
     else {
-        return {};
-    }
-}
-
-token parser::matchIfLogicalOr() {
-  if (lookahead() == tok_logical_operator) {
-    if (peek().getLogicalOp() == logical_or) {
-      return accept();
-    }
-  }
-  return {}; 
-}
-
-token parser::matchIfLogicalAnd() {
-  if (lookahead() == tok_logical_operator) {
-    if (peek().getLogicalOp() == logical_and) {
-      return accept();
-    }
-  }
-  return {};
-}
-
-token parser::matchIfBitwiseOr() {
-  if (lookahead() == tok_bitwise_operator) {
-    if (peek().getBitwiseOp() == op_ior) {
-      return accept();
+        return false;
     }
-  }
-  return {};
-}
-
-token parser::matchIfBitwiseXor() {
-  if (lookahead() == tok_bitwise_operator) {
-    if (peek().getBitwiseOp() == op_xor) {
-      return accept();
-    }
-  }
-  return {};
-}
-
-token parser::matchIfBitwiseAnd() {
-  if (lookahead() == tok_bitwise_operator) {
-    if (peek().getBitwiseOp() == op_and) {
-      return accept();
-    }
-  }
-  return {};
-}
-
-token parser::matchIfEquality() {
-    if (lookahead() == tok_relational_operator) {
-        switch (peek().getRelationOp()) {
-          default:
-            return {};
-          case op_eq:
-          case op_ne:
-            return accept();
-        }
-    }
-    return {};
 }
 
 type* parser::parseType() {
@@ -120,78 +58,26 @@ type* parser::parseBasicType() {
   }
 }
 
-token parser::matchIfRelational() {
-    if (lookahead() == tok_relational_operator) {
-        switch(peek().getRelationOp()) {
-            default:
-              return {};
-            case op_lt:
-            case op_gt:
-            case op_le:
-            case op_ge:
-              return accept();
-        }
-    }
-    return {};
-}
-
-token parser::matchIfShift() {
-    if (lookahead() == tok_bitwise_operator) {
-        switch (peek().getBitwiseOp()) {
-          default:
-            return {};
-          case op_shl:
-          case op_shr:
-            return accept();
-        }
-    }
-    return {};
-}
-
-token parser::matchIfAdditive() {
-    if (lookahead() == tok_arithmetic_operator) {
-        switch(peek().getArithmeticOp()) {
-            default:
-              return {};
-            case op_add:
-            case op_sub:
-              return accept();
-        }
-    }
-    return {};
-}
-
-token parser::matchIfMultiplicative() {
-    if (lookahead() == tok_arithmetic_operator) {
-        switch (peek().getArithmeticOp()) {
-          default:
-            return {};
-          case op_mul:
-          case op_div:
-          case op_mod:
-            return accept();
-        }
-    }
-    return {};
-}
-
 token parser::accept() {
     token tok = peek();
-      m_tok.pop_front();
-    if (m_tok.empty()) {
+    m_first = (m_first + 1) % max_lookahead;
+    --m_size;
+    if (m_size == 0) {
         fetch();
     }
     return tok;
 }
 
-token parser::peek() {
-    assert(!m_tok.empty());
-    return m_tok.front();
+inline const token& parser::peek() const {
+    assert(m_size != 0);
+    return m_tok[m_first];
 }
 
 
 void parser::fetch() {
-    m_tok.push_back(m_lex());
+    assert(m_size < max_lookahead);
+    m_tok[(m_first + m_size) % max_lookahead] = m_lex();
+    ++m_size;
 }
 
 expr* parser::parseExpression() {
@@ -208,7 +94,7 @@ expr* parser::parseAssignmentExpression() {
 }
 
 expr* parser::parseConditionalExpression() {
-  expr* e1 = parseLogicalOrExpression();
+  expr* e1 = parseBinaryExpression();
   if(matchIf(tok_conditional_operator)) {
     expr* e2 = parseExpression();
     match(tok_colon);
@@ -218,97 +104,117 @@ expr* parser::parseConditionalExpression() {
   return e1;
 }
 
-expr* parser::parseLogicalOrExpression() {
-    expr* e1 = parseLogicalAndExpression();
-    while (matchIfLogicalOr()) {
-    expr* e2 = parseLogicalAndExpression();
-    e1 = m_act.onLogicalOrExpression(e1, e2);
-    }
-    return e1;
-}
-
-expr* parser::parseLogicalAndExpression() {
-  expr* e1 = parseBitwiseOrExpression();
-  while (matchIfLogicalAnd()) {
-    expr* e2 = parseBitwiseOrExpression();
-    e1 = m_act.onLogicalAndExpression(e1, e2);
-  }
-  return e1;
-}
-
-expr* parser::parseBitwiseOrExpression() {
-  expr* e1 = parseBitwiseXorExpression();
-  while (matchIfBitwiseOr()) {
-    expr* e2 = parseBitwiseXorExpression();
-    e1 = m_act.onBitwiseOrExpression(e1, e2);
-  }
-  return e1;
-}
-
-expr* parser::parseBitwiseXorExpression() {
-    expr* e1 = parseBitwiseAndExpression();
-    while (matchIfBitwiseXor()) {
-      expr* e2 = parseBitwiseAndExpression();
-      e1 = m_act.onBitwiseXorExpression(e1, e2);
-    }
-    return e1;
-}
-
-expr* parser::parseBitwiseAndExpression() {
-  expr* e1  = parseEqualityExpression();
-  while (matchIfBitwiseAnd()) {
-    expr* e2 = parseEqualityExpression();
-    e1 = m_act.onBitwiseAndExpression(e1, e2);
-  }
-  return e1;
-}
-
-
-expr* parser::parseEqualityExpression() {
-  expr* e1 = parseRelationalExpression();
-  while (token tok = matchIfEquality()) {
-    expr* e2 = parseRelationalExpression();
-    e1 = m_act.onEqualityExpression(tok, e1, e2);
+//Binary operator precedence, from the loosest binding to the tightest.
+enum binary_prec {
+  prec_none,
+  prec_logical_or,
+  prec_logical_and,
+  prec_bitwise_or,
+  prec_bitwise_xor,
+  prec_bitwise_and,
+  prec_equality,
+  prec_relational,
+  prec_shift,
+  prec_additive,
+  prec_multiplicative,
+};
+
+//Binding power of each operator, indexed by its operator enum.
+static constexpr binary_prec logical_prec[] = {
+  prec_logical_and, //logical_and
+  prec_logical_or, //logical_or
+  prec_none, //logical_not
+};
+
+static constexpr binary_prec bitwise_prec[] = {
+  prec_bitwise_and, //op_and
+  prec_bitwise_or, //op_ior
+  prec_bitwise_xor, //op_xor
+  prec_shift, //op_shl
+  prec_shift, //op_shr
+  prec_none, //op_not
+};
+
+static constexpr binary_prec relational_prec[] = {
+  prec_equality, //op_eq
+  prec_equality, //op_ne
+  prec_relational, //op_lt
+  prec_relational, //op_gt
+  prec_relational, //op_le
+  prec_relational, //op_ge
+};
+
+static constexpr binary_prec arithmetic_prec[] = {
+  prec_additive, //op_add
+  prec_multiplicative, //op_mul
+  prec_multiplicative, //op_div
+  prec_multiplicative, //op_mod
+  prec_additive, //op_sub
+};
+
+//Returns the precedence of the lookahead as a binary operator, or
+//prec_none if it is not one.
+int parser::getBinaryPrecedence() const {
+  const token& tok = peek();
+  switch (tok.getName()) {
+    case tok_logical_operator:
+      return logical_prec[tok.getLogicalOp()];
+    case tok_bitwise_operator:
+      return bitwise_prec[tok.getBitwiseOp()];
+    case tok_relational_operator:
+      return relational_prec[tok.getRelationOp()];
+    case tok_arithmetic_operator:
+      return arithmetic_prec[tok.getArithmeticOp()];
+    default:
+      return prec_none;
   }
-  return e1;
 }
 
-expr* parser::parseRelationalExpression() {
-  expr* e1 = parseShiftExpression();
-  while (token tok = matchIfRelational()) {
-    expr* e2 = parseShiftExpression();
-    e1 = m_act.onRelationalExpression(tok, e1, e2);
+expr* parser::onBinaryExpression(int prec, const token& tok, expr* e1, expr* e2) {
+  switch (prec) {
+    case prec_logical_or:
+      return m_act.onLogicalOrExpression(e1, e2);
+    case prec_logical_and:
+      return m_act.onLogicalAndExpression(e1, e2);
+    case prec_bitwise_or:
+      return m_act.onBitwiseOrExpression(e1, e2);
+    case prec_bitwise_xor:
+      return m_act.onBitwiseXorExpression(e1, e2);
+    case prec_bitwise_and:
+      return m_act.onBitwiseAndExpression(e1, e2);
+    case prec_equality:
+      return m_act.onEqualityExpression(tok, e1, e2);
+    case prec_relational:
+      return m_act.onRelationalExpression(tok, e1, e2);
+    case prec_shift:
+      return m_act.onShiftExpression(tok, e1, e2);
+    case prec_additive:
+      return m_act.onAdditiveExpression(tok, e1, e2);
+    case prec_multiplicative:
+      return m_act.onMultiplicativeExpression(tok, e1, e2);
+    default:
+      throw std::logic_error("not a binary operator");
   }
-  return e1;
 }
 
-expr* parser::parseShiftExpression() {
-    expr* e1 = parseAdditiveExpression();
-    while (token tok = matchIfShift()) {
-        expr* e2 = parseAdditiveExpression();
-        e1 = m_act.onShiftExpression(tok, e1, e2);
+//Parses a sequence of cast expressions joined by binary operators that
+//bind at least as tightly as 'prec'. All binary operators are left
+//associative, so the right operand only takes operators that bind more
+//tightly than the one before it.
+expr* parser::parseBinaryExpression(int prec) {
+  expr* e1 = parseCastExpression();
+  while (true) {
+    int p = getBinaryPrecedence();
+    if (p < prec || p == prec_none) {
+      break;
     }
-    return e1;
-}
-
-expr* parser::parseAdditiveExpression() {
-  expr* e1 = parseMultiplicativeExpression();
-  while (token tok = matchIfAdditive()) {
-    expr* e2 = parseMultiplicativeExpression();
-    e1 = m_act.onAdditiveExpression(tok, e1, e2);
+    token tok = accept();
+    expr* e2 = parseBinaryExpression(p + 1);
+    e1 = onBinaryExpression(p, tok, e1, e2);
   }
   return e1;
 }
 
-expr* parser::parseMultiplicativeExpression() {
-    expr* e1 = parseCastExpression();
-    while (token tok = matchIfMultiplicative()) {
-        expr* e2 = parseCastExpression();
-        e1 = m_act.onMultiplicativeExpression(tok, e1, e2);
-    }
-    return e1;
-}
-
 expr* parser::parseCastExpression() {
   expr* e = parseUnaryExpression();
   if (matchIf(kw_as)) {
@@ -331,6 +237,7 @@ expr* parser::parseUnaryExpression() {
         default:
           break;
       }
+      break;
     case tok_bitwise_operator:
       switch (peek().getBitwiseOp()) {
         case op_not:
@@ -340,6 +247,7 @@ expr* parser::parseUnaryExpression() {
         default:
           break;
       }
+      break;
     case tok_logical_operator:
       if (peek().getLogicalOp() == logical_not) {
         op = accept();
@@ -391,18 +299,12 @@ expr* parser::parsePrimaryExpression() {
 
 expr_list parser::parseArgumentList() {
     expr_list args;
-    while (true) {
-        expr* arg = parseExpression();
-        if (matchIf(tok_comma)) {
-            continue;
-        }
-        if (lookahead() == tok_right_paren) {
-            break;
-        }
-        if (lookahead() == tok_right_brace) {
-            break;
-        }
+    if (lookahead() == tok_right_paren || lookahead() == tok_right_bracket) {
+        return args;
     }
+    do {
+        args.push_back(parseExpression());
+    } while (matchIf(tok_comma));
     return args;
 }
 
@@ -412,12 +314,12 @@ expr* parser::parsePostfixExpression() {
     if (matchIf(tok_left_paren)) {
         expr_list args = parseArgumentList();
         match(tok_right_paren);
-        e = m_act.onCallExpression(e, args);
+        e = m_act.onCallExpression(e, std::move(args));
     }
     else if (matchIf(tok_left_bracket)) {
         expr_list args = parseArgumentList();
         match(tok_right_bracket);
-        e = m_act.onIndexExpression(e, args);
+        e = m_act.onIndexExpression(e, std::move(args));
     }
     else {
         break;
@@ -463,7 +365,7 @@ stmt* parser::parseBlockStatement() {
     m_act.finishBlock();
     m_act.leaveScope();
     match(tok_right_brace);
-    return m_act.onBlockStatement(ss);
+    return m_act.onBlockStatement(std::move(ss));
 }
 
 stmt* parser::parseIfStatement() {
@@ -568,6 +470,8 @@ decl* parser::parseObjectDefinition() {
     return parseValueDefinition();
       case kw_var:
     return parseVariableDefinition();
+      case kw_let:
+    return parseConstantDefinition();
     }
 }
 
@@ -634,7 +538,7 @@ decl* parser::parseFunctionDefinition(){
   match(tok_arrow_operator);
   type* t = parseType();
 
-  decl* d = m_act.onFunctionDeclaration(id, parms, t);
+  decl* d = m_act.onFunctionDeclaration(id, std::move(parms), t);
 
   stmt* s = parseBlockStatement();
 
@@ -680,6 +584,6 @@ decl* parser::parseProgram() {
     m_act.enterGlobalScope();
     decl_list dl = parseDeclarationSeq();
     m_act.leaveScope();
-    return m_act.onProgram(dl);
+    return m_act.onProgram(std::move(dl));
 }
 
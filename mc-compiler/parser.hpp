@@ -4,7 +4,8 @@
 #include "semantics.hpp"
 
 
-#include <deque>
+#include "small_vector.hpp"
+
 #include <vector>
 
 class type;
@@ -13,14 +14,15 @@ class stmt;
 class decl;
 class prog;
 
-using type_list = std::vector<type*>;
-using expr_list = std::vector<expr*>;
-using stmt_list = std::vector<stmt*>;
-using decl_list = std::vector<decl*>;
+using type_list = small_vector<type*, 4>;
+using expr_list = small_vector<expr*, 4>;
+using stmt_list = small_vector<stmt*, 8>;
+using decl_list = small_vector<decl*, 4>;
 
 class parser {
   public:
-    parser(symbol_table& syms, const file& f);
+    //Nodes are allocated in 'ast', which must outlive them.
+    parser(symbol_table& syms, ast_context& ast, const file& f);
 
     //Types
     type* parseType();
@@ -30,16 +32,7 @@ class parser {
     expr* parseExpression();
     expr* parseAssignmentExpression();
     expr* parseConditionalExpression();
-    expr* parseLogicalOrExpression();
-    expr* parseLogicalAndExpression();
-    expr* parseBitwiseOrExpression();
-    expr* parseBitwiseAndExpression();
-    expr* parseBitwiseXorExpression();
-    expr* parseEqualityExpression();
-    expr* parseRelationalExpression();
-    expr* parseShiftExpression();
-    expr* parseAdditiveExpression();
-    expr* parseMultiplicativeExpression();
+    expr* parseBinaryExpression(int prec = 1);
     expr* parseCastExpression();
     expr* parseUnaryExpression();
     expr* parsePostfixExpression();
@@ -71,6 +64,10 @@ class parser {
      decl* parseParameter();
      decl* parseProgram();
 
+    semantics& getSemantics() {
+      return m_act;
+    }
+
      decl_list parseDeclarationSeq();
      decl_list parseParameterClause();
      decl_list parseParameterList();
@@ -79,27 +76,25 @@ private:
     token_name lookahead();
     token_name lookahead(int n);
     token match(token_name n);
-    token matchIf(token_name n);
-    token matchIfEquality();
-    token matchIfRelational();
-    token matchIfShift();
-    token matchIfAdditive();
-    token matchIfMultiplicative();
+    bool matchIf(token_name n);
+    int getBinaryPrecedence() const;
+    expr* onBinaryExpression(int prec, const token& tok, expr* e1, expr* e2);
     token accept();
-    token peek();
-    token matchIfLogicalOr();
-    token matchIfLogicalAnd();
-    token matchIfBitwiseOr();
-    token matchIfBitwiseXor();
-    token matchIfBitwiseAnd();
+    const token& peek() const;
     void fetch();
 
     lexer m_lex;
     semantics m_act;
 
-    std::deque<token> m_tok;
+    //Lookahead tokens, in a ring buffer. The grammar never looks further
+    //than 3 tokens ahead (see parseDeclaration); the size is a power of 2.
+    static constexpr unsigned max_lookahead = 4;
+
+    token m_tok[max_lookahead];
+    unsigned m_first;
+    unsigned m_size;
 };
 
-inline parser::parser(symbol_table& syms, const file& f) : m_lex(syms, f), m_tok() {
+inline parser::parser(symbol_table& syms, ast_context& ast, const file& f) : m_lex(syms, f), m_act(ast), m_first(0), m_size(0) {
   fetch();
 }
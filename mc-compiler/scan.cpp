@@ -0,0 +1,146 @@
+#include "scan.hpp"
+#include "chars.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Each character class provides a scalar test and, when vector support is
+// available, a bytewise match that yields 0xff in every lane that belongs
+// to the class. Range checks use signed compares, so bytes at or above 0x80
+// never match.
+
+#if defined(__SSE2__)
+inline __m128i inRange(__m128i v, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+#endif
+
+#if defined(__AVX2__)
+inline __m256i inRange(__m256i v, char lo, char hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+#endif
+
+struct space_class {
+  static bool test(char c) {
+    return hasCharClass(c, cc_space);
+  }
+
+#if defined(__SSE2__)
+  static __m128i match(__m128i v) {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+  }
+#endif
+
+#if defined(__AVX2__)
+  static __m256i match(__m256i v) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+  }
+#endif
+};
+
+struct digit_class {
+  static bool test(char c) {
+    return hasCharClass(c, cc_digit);
+  }
+
+#if defined(__SSE2__)
+  static __m128i match(__m128i v) {
+    return inRange(v, '0', '9');
+  }
+#endif
+
+#if defined(__AVX2__)
+  static __m256i match(__m256i v) {
+    return inRange(v, '0', '9');
+  }
+#endif
+};
+
+struct identifier_class {
+  static bool test(char c) {
+    return hasCharClass(c, cc_alphanumeric);
+  }
+
+#if defined(__SSE2__)
+  //Setting bit 5 maps upper case letters onto lower case ones.
+  static __m128i match(__m128i v) {
+    __m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(inRange(l, 'a', 'z'), inRange(v, '0', '9')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  }
+#endif
+
+#if defined(__AVX2__)
+  static __m256i match(__m256i v) {
+    __m256i l = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(inRange(l, 'a', 'z'), inRange(v, '0', '9')),
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+  }
+#endif
+};
+
+//Find the end of a run of characters in class C. The vector loops stop
+//at the first lane that does not match; whatever is left over at the end
+//of the input is handled one character at a time.
+template<typename C>
+const char* scanRun(const char* first, const char* last) {
+#if defined(__AVX2__)
+  while (last - first >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(C::match(v)));
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+    first += 32;
+  }
+#endif
+
+#if defined(__SSE2__)
+  while (last - first >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(C::match(v))) & 0xffff;
+    if (mask) {
+      return first + __builtin_ctz(mask);
+    }
+    first += 16;
+  }
+#endif
+
+  while (first != last && C::test(*first)) {
+    ++first;
+  }
+  return first;
+}
+
+} // namespace
+
+const char* scanSpace(const char* first, const char* last) {
+  return scanRun<space_class>(first, last);
+}
+
+//memchr is already vectorized by the C library.
+const char* scanLine(const char* first, const char* last) {
+  const void* p = std::memchr(first, '\n', last - first);
+  return p ? static_cast<const char*>(p) : last;
+}
+
+const char* scanIdentifier(const char* first, const char* last) {
+  return scanRun<identifier_class>(first, last);
+}
+
+const char* scanDigits(const char* first, const char* last) {
+  return scanRun<digit_class>(first, last);
+}
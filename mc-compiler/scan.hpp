@@ -0,0 +1,21 @@
+#pragma once
+
+// Run scanners used by the lexer. Each returns a pointer to the first
+// character in [first, last) that does not belong to the run, or last.
+// None of the runs can contain a newline, so callers can advance the
+// column by the length of the run in one step.
+//
+// Where the target supports it, these examine 16 (SSE2) or 32 (AVX2)
+// bytes at a time.
+
+// Spaces and horizontal tabs.
+const char* scanSpace(const char* first, const char* last);
+
+// Everything up to, but not including, the next newline.
+const char* scanLine(const char* first, const char* last);
+
+// Letters, digits and underscores.
+const char* scanIdentifier(const char* first, const char* last);
+
+// Decimal digits.
+const char* scanDigits(const char* first, const char* last);
@@ -1 +1,31 @@
 #include "scope.hpp"
+
+#include <algorithm>
+
+void scope_table::enter(kind k) {
+  m_levels.push_back({k, m_bindings.size()});
+}
+
+//Unwind the bindings made in the innermost scope, restoring whatever
+//they shadowed.
+void scope_table::leave() {
+  assert(!m_levels.empty());
+  std::size_t mark = m_levels.back().mark;
+  while (m_bindings.size() != mark) {
+    const binding& b = m_bindings.back();
+    m_heads[b.sym->id()] = b.shadowed;
+    m_bindings.pop_back();
+  }
+  m_levels.pop_back();
+}
+
+void scope_table::declare(symbol sym, decl* d) {
+  assert(!m_levels.empty());
+  assert(!lookupLocal(sym));
+  std::uint32_t id = sym->id();
+  if (id >= m_heads.size()) {
+    m_heads.resize(std::max<std::size_t>(id + 1, m_heads.size() * 2), -1);
+  }
+  m_bindings.push_back({sym, d, m_heads[id], static_cast<std::uint32_t>(m_levels.size())});
+  m_heads[id] = m_bindings.size() - 1;
+}
@@ -4,39 +4,70 @@
 
 
 #include <cassert>
-#include <unordered_map>
+#include <cstdint>
+#include <vector>
 
 
 class decl;
 
-struct scope : std::unordered_map<symbol, decl*> {
-  scope(scope* p = nullptr) : parent(p) {}
+// The bindings of every open scope, kept in one flat table. Each symbol
+// has a stack of bindings threaded through the log, innermost first, so a
+// lookup is a single index by symbol id no matter how deeply scopes nest.
+// Leaving a scope unwinds the log back to where the scope began. Once the
+// vectors have grown to the program's needs, nothing here allocates.
+class scope_table {
+  public:
+    enum kind {
+      global_kind,
+      parameter_kind,
+      block_kind,
+    };
 
-  virtual ~scope() = default;
+    void enter(kind k);
+    void leave();
 
-  decl* lookup(symbol sym) const {
-    auto iter = find(sym);
-    return iter == end() ? nullptr : iter->second;
-  }
+    bool empty() const {
+      return m_levels.empty();
+    }
 
+    // The kind of the scope 'n' levels out from the innermost one.
+    kind getKind(int n = 0) const {
+      assert(n < static_cast<int>(m_levels.size()));
+      return m_levels[m_levels.size() - 1 - n].k;
+    }
 
-  void declare(symbol sym, decl* d) {
-    assert(count(sym) == 0);
-    emplace(sym, d);
-  }
+    // The innermost visible declaration of 'sym'.
+    decl* lookup(symbol sym) const {
+      std::int32_t b = innermost(sym);
+      return b < 0 ? nullptr : m_bindings[b].d;
+    }
 
-  scope* parent;
-};
+    // The declaration of 'sym' in the innermost scope only.
+    decl* lookupLocal(symbol sym) const {
+      std::int32_t b = innermost(sym);
+      return b < 0 || m_bindings[b].depth != m_levels.size() ? nullptr : m_bindings[b].d;
+    }
 
+    void declare(symbol sym, decl* d);
 
-struct global_scope : scope {
-    using scope::scope;
-};
+  private:
+    std::int32_t innermost(symbol sym) const {
+      return sym->id() < m_heads.size() ? m_heads[sym->id()] : -1;
+    }
 
-struct parameter_scope : scope {
-    using scope::scope;
-};
+    struct binding {
+      symbol sym;
+      decl* d;
+      std::int32_t shadowed; //The binding this one hides, or -1.
+      std::uint32_t depth;
+    };
+
+    struct level {
+      kind k;
+      std::size_t mark; //The size of the log when the scope was entered.
+    };
 
-struct block_scope : scope {
-    using scope::scope;
+    std::vector<binding> m_bindings;
+    std::vector<std::int32_t> m_heads;
+    std::vector<level> m_levels;
 };
@@ -1,4 +1,7 @@
 #include "semantics.hpp"
+#include "arith.hpp"
+#include "ast.hpp"
+#include "consteval.hpp"
 #include "type.hpp"
 #include "expr.hpp"
 #include "stmt.hpp"
@@ -6,15 +9,18 @@
 #include "scope.hpp"
 
 
+#include <algorithm>
+#include <exception>
 #include <iostream>
 #include <sstream>
 
-semantics::semantics() : m_scope(nullptr),m_fn(nullptr), m_bool(new bool_type()), m_char(new char_type()), m_int(new int_type()), m_float(new float_type()) {}
+semantics::semantics(ast_context& ast) : m_ast(ast), m_types(ast), m_fn(nullptr), m_fold(true), m_bool(m_types.getBoolType()), m_char(m_types.getCharType()), m_int(m_types.getIntType()), m_float(m_types.getFloatType()) {}
 
 semantics::~semantics() {
 
-  assert(!m_scope);
-  assert(!m_fn);
+  //Scopes are left open when a diagnostic unwinds the parser.
+  assert(m_scopes.empty() || std::uncaught_exceptions());
+  assert(!m_fn || std::uncaught_exceptions());
 }
 
 type* semantics::onBasicType(token tok) {
@@ -39,48 +45,62 @@ expr* semantics::onAssignmentExpression(expr* e1, expr* e2) {
   type* t2 = e2->getType();
   requireSame(t1, t2);
 
-  return new assign_expr(e1->getType(), e1, e2);
+  return m_ast.make<assign_expr>(e1->getType(), e1, e2);
 }
 
 expr* semantics::onConditionalExpression(expr* e1, expr* e2, expr* e3) {
     e1 = requireBoolean(e1);
 
-    type* c = commonType(e1->getType(), e2->getType());
+    type* c = commonType(e2->getType(), e3->getType());
     e2 = convertToType(e2, c);
     e3 = convertToType(e3, c);
 
-    return new cond_expr(c, e1, e2, e3);
+    if (m_fold && e1->getKind() == expr::bool_kind) {
+        return static_cast<bool_expr*>(e1)->val ? e2 : e3;
+    }
+    return m_ast.make<cond_expr>(c, e1, e2, e3);
+}
+
+static bool isLiteral(const expr* e) {
+    switch (e->getKind()) {
+      case expr::bool_kind:
+      case expr::int_kind:
+      case expr::float_kind:
+        return true;
+      default:
+        return false;
+    }
 }
 
 expr* semantics::onLogicalOrExpression(expr* e1, expr* e2) {
     e1 = requireBoolean(e1);
     e2 = requireBoolean(e2);
-    return new binop_expr(m_bool, bo_lor, e1, e2);
+    return makeBinary(m_bool, bo_lor, e1, e2);
 }
 
 expr* semantics::onLogicalAndExpression(expr* e1, expr* e2) {
     e1 = requireBoolean(e1);
     e2 = requireBoolean(e2);
 
-    return new binop_expr(m_bool, bo_land, e1, e2);
+    return makeBinary(m_bool, bo_land, e1, e2);
 }
 
 expr* semantics::onBitwiseOrExpression(expr* e1, expr* e2) {
   e1 = requireInteger(e1);
   e2 = requireInteger(e2);
-  return new binop_expr(m_int, bo_ior, e1, e2);
+  return makeBinary(m_int, bo_ior, e1, e2);
 }
 
 expr* semantics::onBitwiseXorExpression(expr* e1, expr* e2) {
     e1 = requireInteger(e1);
     e2 = requireInteger(e2);
-    return new binop_expr(m_int, bo_xor, e1, e2);
+    return makeBinary(m_int, bo_xor, e1, e2);
 }
 
 expr* semantics::onBitwiseAndExpression(expr* e1, expr* e2) {
     e1 = requireInteger(e1);
     e2 = requireInteger(e2);
-    return new binop_expr(m_int, bo_and, e1, e2);
+    return makeBinary(m_int, bo_and, e1, e2);
 }
 
 static binop getRelationOp(relation_op op) {
@@ -106,7 +126,7 @@ expr* semantics::onEqualityExpression(token tok, expr* e1, expr* e2) {
     e1 = requireScalar(e1);
     e2 = requireScalar(e2);
     relation_op op = tok.getRelationOp();
-    return new binop_expr(m_bool, getRelationOp(op), e1, e2);
+    return makeBinary(m_bool, getRelationOp(op), e1, e2);
 }
 
 
@@ -115,7 +135,7 @@ expr* semantics::onRelationalExpression(token tok, expr* e1, expr* e2) {
     e1 = requireNumeric(e1);
     e2 = requireNumeric(e2);
     relation_op op = tok.getRelationOp();
-    return new binop_expr(m_bool, getRelationOp(op), e1, e2);
+    return makeBinary(m_bool, getRelationOp(op), e1, e2);
 }
 
 static binop getBitwiseOp(bitwise_op op) {
@@ -127,7 +147,7 @@ static binop getBitwiseOp(bitwise_op op) {
       case op_xor: 
         return bo_xor;
       case op_shl:
-        bo_shl;
+        return bo_shl;
       case op_shr:
         return bo_shr;
       default:
@@ -139,7 +159,7 @@ expr* semantics::onShiftExpression(token tok, expr* e1, expr* e2) {
     e1 = requireInteger(e1);
     e2 = requireInteger(e2);
     bitwise_op op = tok.getBitwiseOp();
-    return new binop_expr(m_int, getBitwiseOp(op), e1, e2);
+    return makeBinary(m_int, getBitwiseOp(op), e1, e2);
 }
 
 static binop getArithmeticOp(arithmetic_op op) {
@@ -163,7 +183,7 @@ expr* semantics::onAdditiveExpression(token tok, expr* e1, expr* e2) {
     type* t = requireSame(e1->getType(), e2->getType());
 
     arithmetic_op op = tok.getArithmeticOp();
-    return new binop_expr(t, getArithmeticOp(op), e1, e2);
+    return makeBinary(t, getArithmeticOp(op), e1, e2);
 }
 
 expr* semantics::onMultiplicativeExpression(token tok, expr* e1, expr* e2) {
@@ -172,11 +192,15 @@ expr* semantics::onMultiplicativeExpression(token tok, expr* e1, expr* e2) {
     type* t = requireSame(e1->getType(), e2->getType());
 
     arithmetic_op op = tok.getArithmeticOp();
-    return new binop_expr(t, getArithmeticOp(op), e1, e2);
+    return makeBinary(t, getArithmeticOp(op), e1, e2);
 }
 
 expr* semantics::onCastExpression(expr* e, type* t) {
-    return new cast_expr(convertToType(e, t), t);
+    e = convertToType(e, t);
+    if (m_fold && isLiteral(e)) {
+        return e;
+    }
+    return m_ast.make<cast_expr>(e, t);
 }
 
 static unop getUnaryOp(token tok) {
@@ -194,7 +218,7 @@ static unop getUnaryOp(token tok) {
         else
           throw std::logic_error("Not a valid op");
       case tok_logical_operator:
-        if (tok.getLogicalOp())
+        if (tok.getLogicalOp() == logical_not)
           return uo_not;
         else
           throw std::logic_error("not a valid op");
@@ -227,10 +251,10 @@ expr* semantics::onUnaryExpression(token tok, expr* e) {
       case uo_deref:
         throw std::logic_error("Features not implemented in this compiler verison");
     }
-    return new unop_expr(op, e);
+    return makeUnary(t, op, e);
 }
 
-expr* semantics::onCallExpression(expr* e, const expr_list& args) {
+expr* semantics::onCallExpression(expr* e, expr_list&& args) {
   e = requireFunction(e);
   fn_type* t = static_cast<fn_type*>(e->getType());
 
@@ -243,31 +267,30 @@ expr* semantics::onCallExpression(expr* e, const expr_list& args) {
   //Args just right, like goldilocks
   for (std::size_t i = 0; i != parms.size(); ++i) {
     type* p = parms[i];
-    expr* a = args[i];
+    expr* a = requireValue(args[i]);
     if (!a->hasType(p))
       throw std::runtime_error("arg does not match");
+    args[i] = a;
   }
 
-  return new call_expr(t->getReturnType(), e, args);
+  return m_ast.make<call_expr>(t->getReturnType(), e, std::move(args));
 }
 
-expr* semantics::onIndexExpression(expr* e, const expr_list& args) {
+expr* semantics::onIndexExpression(expr* e, expr_list&& args) {
     throw std::runtime_error("not implemented in this compiler version");
 }
 
 expr* semantics::onIntegerLiteral(token tok) {
-    int val = tok.getInteger();
-    return new int_expr(m_int, val);
+    //Literals wrap to 32 bits like any other int.
+    return makeInt(static_cast<std::int32_t>(tok.getInteger()));
 }
 
 expr* semantics::onBooleanLiteral(token tok) {
-    int val = tok.getInteger();
-    return new bool_expr(m_bool, val);
+    return makeBool(tok.getBoolean());
 }
 
 expr* semantics::onFloatLiteral(token tok) {
-    int val = tok.getInteger();
-    return new float_expr(m_float, val);
+    return makeFloat(static_cast<float>(tok.getFloatingPoint()));
 }
 
 expr* semantics::onIdExpression(token tok) {
@@ -280,22 +303,23 @@ expr* semantics::onIdExpression(token tok) {
       throw std::runtime_error(ss.str());
     }
     type * t;
-    typed_decl* td = dynamic_cast<typed_decl*>(d);
+    //Only typed declarations are ever bound in a scope.
+    typed_decl* td = static_cast<typed_decl*>(d);
     if (td->isVariable())
-      t = new ref_type(td->getType());
+      t = m_types.getReferenceType(td->getType());
     else
       t = td->getType();
 
-    return new id_expr(t, d);
+    return m_ast.make<id_expr>(t, d);
 }
 
-stmt* semantics::onBlockStatement(const stmt_list& ss) {
-    return new block_stmt(ss);
+stmt* semantics::onBlockStatement(stmt_list&& ss) {
+    return m_ast.make<block_stmt>(std::move(ss));
 }
 
 void semantics::startBlock() {
-    scope* parent = getCurrentScope()->parent;
-    if (dynamic_cast<global_scope*>(parent)) {
+    //The outermost block of a function declares its parameters.
+    if (m_scopes.getKind(1) == scope_table::global_kind) {
         fn_decl* fn = getCurrentFunction();
         for (decl* parm : fn->m_parms)
             declare(parm);
@@ -307,82 +331,110 @@ void semantics::finishBlock() {
 }
 
 stmt* semantics::onIfStatement(expr* e, stmt* s1, stmt* s2) {
-    return new if_stmt(e, s1, s2);
+    e = requireBoolean(e);
+    return m_ast.make<if_stmt>(e, s1, s2);
 }
 
 stmt* semantics::onWhileStatement(expr* e, stmt* s) {
-    return new while_stmt(e, s);
+    e = requireBoolean(e);
+    return m_ast.make<while_stmt>(e, s);
 }
 
 stmt* semantics::onBreakStatement() {
-    return new break_stmt();
+    return m_ast.make<break_stmt>();
 }
 
 stmt* semantics::onContinueStatement() {
-    return new cont_stmt();
+    return m_ast.make<cont_stmt>();
 }
 
 stmt* semantics::onReturnStatement(expr* e) {
-    return new ret_stmt(e);
+    e = convertToType(e, getCurrentFunction()->getReturnType());
+    return m_ast.make<ret_stmt>(e);
 }
 
 stmt* semantics::onDeclarationStatement(decl* d) {
-    return new decl_stmt(d);
+    return m_ast.make<decl_stmt>(d);
 }
 
 stmt* semantics::onExpressionStatement(expr* e) {
-    return new expr_stmt(e);
+    return m_ast.make<expr_stmt>(e);
 }
 
 
 void semantics::declare(decl* d) {
-    scope* s = getCurrentScope();
-    if (s->lookup(d->getName())) {
+    if (m_scopes.lookupLocal(d->getName())) {
         std::stringstream ss;
         ss << "There is a redecl of " << *d->getName();
         throw std::runtime_error(ss.str());
     }
-    s->declare(d->getName(), d);
+    m_scopes.declare(d->getName(), d);
 }
 
 decl* semantics::onVariableDeclaration(token n, type* t) {
-    decl* var = new var_decl(n.getIdentifier(), t);
+    decl* var = m_ast.make<var_decl>(n.getIdentifier(), t);
     declare(var);
     return var;
 }
 
 decl* semantics::onVariableDefinition(decl* d, expr* e) {
     var_decl* var = static_cast<var_decl*>(d);
-    var->setInit(e);
+    var->setInit(convertToType(e, var->getType()));
+    if (m_scopes.getKind() == scope_table::global_kind) {
+        evaluateInit(var, true);
+    }
     return var;
 }
 
 decl* semantics::onConstantDeclaration(token n, type* t) {
-    decl* var = new const_decl(n.getIdentifier(), t);
+    decl* var = m_ast.make<const_decl>(n.getIdentifier(), t);
     declare(var);
     return var;
 }
 
 decl* semantics::onConstantDefinition(decl* d, expr* e) {
     const_decl* var = static_cast<const_decl*>(d);
-    var->setInit(e);
+    var->setInit(convertToType(e, var->getType()));
+    evaluateInit(var, m_scopes.getKind() == scope_table::global_kind);
     return var;
 }
 
 decl* semantics::onValueDeclaration(token n, type* t) {
-    decl* val = new value_decl(n.getIdentifier(), t);
+    decl* val = m_ast.make<value_decl>(n.getIdentifier(), t);
     declare(val);
     return val;
 }
 
 decl* semantics::onValueDefinition(decl* d, expr* e) {
     value_decl* val = static_cast<value_decl*>(d);
-    val->setInit(e);
+    val->setInit(convertToType(e, val->getType()));
+    evaluateInit(val, m_scopes.getKind() == scope_table::global_kind);
     return val;
 }
 
+//Globals are laid out as constant data, so their initializers must be
+//constant. Local constants are evaluated when they can be, which lets
+//later constants use them; that is only worth a short evaluation, since
+//the code runs anyway.
+void semantics::evaluateInit(object_decl* d, bool required) {
+    eval_limits lim = m_eval_limits;
+    if (!required) {
+        lim.steps = std::min(lim.steps, lim.optional_steps);
+    }
+    try {
+        const_evaluator eval(lim, required);
+        d->setValue(eval.evaluate(d->getInit()));
+    } catch (const const_eval_error& err) {
+        if (required) {
+            std::stringstream ss;
+            ss << "the initializer of '" << *d->getName() << "' is not constant: it " << err.what();
+            throw std::runtime_error(ss.str());
+        }
+    }
+}
+
 decl* semantics::onParameterDeclaration(token n, type* t) {
-    decl* parm = new parm_decl(n.getIdentifier(), t);
+    decl* parm = m_ast.make<parm_decl>(n.getIdentifier(), t);
     declare(parm);
     return parm;
 }
@@ -395,9 +447,9 @@ static type_list getParameterTypes(const decl_list& parms) {
     return types;
 }
 
-decl* semantics::onFunctionDeclaration(token n, const decl_list& parms, type* ret) {
-    fn_type* ty = new fn_type(getParameterTypes(parms), ret);
-    fn_decl* fn = new fn_decl(n.getIdentifier(), ty, parms);
+decl* semantics::onFunctionDeclaration(token n, decl_list&& parms, type* ret) {
+    fn_type* ty = m_types.getFunctionType(getParameterTypes(parms), ret);
+    fn_decl* fn = m_ast.make<fn_decl>(n.getIdentifier(), ty, std::move(parms));
     fn->setType(ty);
     declare(fn);
 
@@ -418,38 +470,29 @@ decl* semantics::onFunctionDefinition(decl* d, stmt* s) {
 }
 
 
-decl* semantics::onProgram(const decl_list& dl) {
-    return new prog_decl(dl);
+decl* semantics::onProgram(decl_list&& dl) {
+    return m_ast.make<prog_decl>(std::move(dl));
 }
 
 void semantics::enterGlobalScope() {
-    assert(!m_scope);
-    m_scope = new global_scope();
+    assert(m_scopes.empty());
+    m_scopes.enter(scope_table::global_kind);
 }
 
 void semantics::enterParameterScope() {
-    m_scope = new parameter_scope(m_scope);
+    m_scopes.enter(scope_table::parameter_kind);
 }
 
 void semantics::enterBlockScope() {
-    m_scope = new block_scope(m_scope);
+    m_scopes.enter(scope_table::block_kind);
 }
 
 void semantics::leaveScope() {
-    scope* cur = m_scope;
-    m_scope = cur->parent;
-    delete cur;
+    m_scopes.leave();
 }
 
 decl* semantics::lookup(symbol n) {
-    scope* s = getCurrentScope();
-    while(s) {
-        if (decl* d = s->lookup(n)) {
-            return d;
-        }
-        s = s->parent;
-    }
-    return nullptr;
+    return m_scopes.lookup(n);
 }
 
 expr* semantics::requireReference(expr* e) {
@@ -538,7 +581,7 @@ type* semantics::commonType(type* t1, type* t2) {
 expr* semantics::convertToValue(expr* e) {
     type* t = e->getType();
     if (t->isReference()) {
-        return new conv_expr(e, conv_value, t->getObjectType());
+        return m_ast.make<conv_expr>(e, conv_value, t->getObjectType());
     }
     return e;
 }
@@ -555,7 +598,7 @@ expr* semantics::convertToBool(expr* e) {
         case type::float_kind:
         case type::ptr_kind:
         case type::fn_kind:
-          return new conv_expr(e, conv_bool, m_bool);
+          return makeConversion(e, conv_bool, m_bool);
         default:
           throw std::runtime_error("Cannot convert type to boolean");
     }
@@ -569,7 +612,7 @@ expr* semantics::convertToChar(expr* e) {
         case type::char_kind:
           return e;
         case type::int_kind:
-          return new conv_expr(e, conv_char, m_char);
+          return makeConversion(e, conv_char, m_char);
         default:
           throw std::runtime_error("Cant conv to a char");
     }
@@ -581,11 +624,11 @@ expr* semantics::convertToInt(expr* e) {
     switch (t->getKind()) {
         case type::bool_kind:
         case type::char_kind:
-          return new conv_expr(e, conv_int, m_int);
+          return makeConversion(e, conv_int, m_int);
         case type::int_kind:
           return e;
         case type::float_kind:
-          return new conv_expr(e, conv_trunc, m_int);
+          return makeConversion(e, conv_trunc, m_int);
         case type::ptr_kind:
         case type::fn_kind:
         default:
@@ -598,7 +641,7 @@ expr* semantics::convertToFloat(expr* e) {
     type* t= e->getType();
     switch(t->getKind()) {
         case type::int_kind:
-          return new conv_expr(e, conv_ext, m_float);
+          return makeConversion(e, conv_ext, m_float);
         case type::float_kind:
           return e;
         default:
@@ -629,3 +672,222 @@ expr* semantics::convertToType(expr* e, type* t) {
           throw std::runtime_error("Failed to convert to type specified");
     }
 }
+
+expr* semantics::makeBool(bool b) {
+    return m_ast.make<bool_expr>(m_bool, b);
+}
+
+expr* semantics::makeInt(std::int32_t n) {
+    return m_ast.make<int_expr>(m_int, n);
+}
+
+expr* semantics::makeFloat(float n) {
+    return m_ast.make<float_expr>(m_float, n);
+}
+
+expr* semantics::makeBinary(type* t, binop op, expr* e1, expr* e2) {
+    if (m_fold && isLiteral(e1) && isLiteral(e2)) {
+        if (expr* e = foldBinary(op, e1, e2)) {
+            return e;
+        }
+    }
+    return m_ast.make<binop_expr>(t, op, e1, e2);
+}
+
+expr* semantics::makeUnary(type* t, unop op, expr* e) {
+    if (m_fold && isLiteral(e)) {
+        if (expr* r = foldUnary(op, e)) {
+            return r;
+        }
+    }
+    return m_ast.make<unop_expr>(t, op, e);
+}
+
+expr* semantics::makeConversion(expr* e, conversion c, type* t) {
+    if (m_fold && isLiteral(e)) {
+        if (expr* r = foldConversion(e, c)) {
+            return r;
+        }
+    }
+    return m_ast.make<conv_expr>(e, c, t);
+}
+
+//Compares two values of the same type.
+template<typename T>
+static bool compare(binop op, T a, T b) {
+    switch (op) {
+      case bo_eq:
+        return a == b;
+      case bo_ne:
+        return a != b;
+      case bo_lt:
+        return a < b;
+      case bo_gt:
+        return a > b;
+      case bo_le:
+        return a <= b;
+      case bo_ge:
+        return a >= b;
+      default:
+        throw std::logic_error("not a relational op");
+    }
+}
+
+static bool isRelational(binop op) {
+    return bo_eq <= op && op <= bo_ge;
+}
+
+//Returns the literal that 'e1 op e2' evaluates to, or null if the
+//operands cannot be combined. A division by zero is left for run time:
+//the operand may never be evaluated, as in 'false && 1 / 0 == 1'.
+expr* semantics::foldBinary(binop op, expr* e1, expr* e2) {
+    if (e1->getKind() != e2->getKind()) {
+        return nullptr;
+    }
+
+    switch (e1->getKind()) {
+      case expr::int_kind: {
+        std::int32_t a = static_cast<int_expr*>(e1)->val;
+        std::int32_t b = static_cast<int_expr*>(e2)->val;
+        if (isRelational(op)) {
+            return makeBool(compare(op, a, b));
+        }
+        switch (op) {
+          case bo_add:
+            return makeInt(addInt(a, b));
+          case bo_sub:
+            return makeInt(subInt(a, b));
+          case bo_mul:
+            return makeInt(mulInt(a, b));
+          case bo_quo:
+          case bo_rem:
+            if (b == 0) {
+                return nullptr;
+            }
+            return makeInt(op == bo_quo ? divInt(a, b) : remInt(a, b));
+          case bo_and:
+            return makeInt(a & b);
+          case bo_ior:
+            return makeInt(a | b);
+          case bo_xor:
+            return makeInt(a ^ b);
+          case bo_shl:
+            return makeInt(shlInt(a, b));
+          case bo_shr:
+            return makeInt(shrInt(a, b));
+          default:
+            return nullptr;
+        }
+      }
+
+      case expr::float_kind: {
+        float a = static_cast<float_expr*>(e1)->val;
+        float b = static_cast<float_expr*>(e2)->val;
+        if (isRelational(op)) {
+            return makeBool(compare(op, a, b));
+        }
+        switch (op) {
+          case bo_add:
+            return makeFloat(a + b);
+          case bo_sub:
+            return makeFloat(a - b);
+          case bo_mul:
+            return makeFloat(a * b);
+          case bo_quo:
+            return makeFloat(a / b);
+          case bo_rem:
+            return makeFloat(remFloat(a, b));
+          default:
+            return nullptr;
+        }
+      }
+
+      case expr::bool_kind: {
+        bool a = static_cast<bool_expr*>(e1)->val;
+        bool b = static_cast<bool_expr*>(e2)->val;
+        if (isRelational(op)) {
+            return makeBool(compare(op, a, b));
+        }
+        switch (op) {
+          case bo_land:
+            return makeBool(a && b);
+          case bo_lor:
+            return makeBool(a || b);
+          default:
+            return nullptr;
+        }
+      }
+
+      default:
+        return nullptr;
+    }
+}
+
+expr* semantics::foldUnary(unop op, expr* e) {
+    switch (e->getKind()) {
+      case expr::int_kind: {
+        std::int32_t a = static_cast<int_expr*>(e)->val;
+        switch (op) {
+          case uo_pos:
+            return e;
+          case uo_neg:
+            return makeInt(negInt(a));
+          case uo_cmp:
+            return makeInt(~a);
+          default:
+            return nullptr;
+        }
+      }
+      case expr::float_kind: {
+        float a = static_cast<float_expr*>(e)->val;
+        switch (op) {
+          case uo_pos:
+            return e;
+          case uo_neg:
+            return makeFloat(-a);
+          default:
+            return nullptr;
+        }
+      }
+      case expr::bool_kind:
+        if (op == uo_not) {
+            return makeBool(!static_cast<bool_expr*>(e)->val);
+        }
+        return nullptr;
+      default:
+        return nullptr;
+    }
+}
+
+//There are no char literals, so conversions to char are never folded.
+expr* semantics::foldConversion(expr* e, conversion c) {
+    switch (c) {
+      case conv_identity:
+        return e;
+      case conv_bool:
+        if (e->getKind() == expr::int_kind) {
+            return makeBool(static_cast<int_expr*>(e)->val != 0);
+        }
+        if (e->getKind() == expr::float_kind) {
+            return makeBool(static_cast<float_expr*>(e)->val != 0);
+        }
+        return nullptr;
+      case conv_int:
+        if (e->getKind() == expr::bool_kind) {
+            return makeInt(static_cast<bool_expr*>(e)->val);
+        }
+        return nullptr;
+      case conv_ext:
+        if (e->getKind() == expr::int_kind) {
+            return makeFloat(intToFloat(static_cast<int_expr*>(e)->val));
+        }
+        return nullptr;
+      case conv_trunc:
+        if (e->getKind() == expr::float_kind) {
+            return makeInt(floatToInt(static_cast<float_expr*>(e)->val));
+        }
+        return nullptr;
+      default:
+        return nullptr;
+    }
+}
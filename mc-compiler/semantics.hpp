@@ -1,6 +1,13 @@
 #pragma once
 
+#include "consteval.hpp"
+#include "expr.hpp"
 #include "token.hpp"
+#include "scope.hpp"
+#include "type.hpp"
+
+#include "small_vector.hpp"
+
 #include <vector>
 
 class type;
@@ -8,17 +15,18 @@ class expr;
 class stmt;
 class decl;
 class fn_decl;
+class object_decl;
 
-using type_list = std::vector<type*>;
-using expr_list = std::vector<expr*>;
-using stmt_list = std::vector<stmt*>;
-using decl_list = std::vector<decl*>;
+using type_list = small_vector<type*, 4>;
+using expr_list = small_vector<expr*, 4>;
+using stmt_list = small_vector<stmt*, 8>;
+using decl_list = small_vector<decl*, 4>;
 
-class scope;
+class ast_context;
 
 class semantics {
   public:
-    semantics();
+    explicit semantics(ast_context& ast);
     ~semantics();
 
     type* onBasicType(token tok);
@@ -37,14 +45,14 @@ class semantics {
     expr* onMultiplicativeExpression(token tok, expr* e1, expr* e2);
     expr* onCastExpression(expr* e, type* t);
     expr* onUnaryExpression(token tok, expr* e);
-    expr* onCallExpression(expr* e, const expr_list& args);
-    expr* onIndexExpression(expr* e, const expr_list& args);
+    expr* onCallExpression(expr* e, expr_list&& args);
+    expr* onIndexExpression(expr* e, expr_list&& args);
     expr* onIdExpression(token tok);
     expr* onIntegerLiteral(token tok);
     expr* onBooleanLiteral(token tok);
     expr* onFloatLiteral(token tok);
 
-    stmt* onBlockStatement(const stmt_list& ss);
+    stmt* onBlockStatement(stmt_list&& ss);
     void startBlock();
     void finishBlock();
     stmt* onIfStatement(expr* e, stmt* s1, stmt* s2);
@@ -62,17 +70,21 @@ class semantics {
     decl* onValueDeclaration(token n, type* t);
     decl* onValueDefinition(decl*, expr* e);
     decl* onParameterDeclaration(token n, type* t);
-    decl* onFunctionDeclaration(token n, const decl_list& parms, type* ret);
+    decl* onFunctionDeclaration(token n, decl_list&& parms, type* ret);
     decl* onFunctionDefinition(decl* d, stmt* s);
 
-    decl* onProgram(const decl_list& dl);
+    decl* onProgram(decl_list&& dl);
 
     void enterGlobalScope();
     void enterParameterScope();
     void enterBlockScope();
     void leaveScope();
-    scope* getCurrentScope() const {
-      return m_scope;
+    type_context& getTypes() {
+      return m_types;
+    }
+
+    const scope_table& getScopes() const {
+      return m_scopes;
     }
 
     fn_decl* getCurrentFunction() const {
@@ -102,11 +114,46 @@ class semantics {
     expr* convertToFloat(expr* e);
     expr* convertToType(expr* e, type* t);
 
+    //Constant folding. Operations on literals are evaluated as they are
+    //built, so no node is made for them. It is on by default.
+    void setFolding(bool on) {
+      m_fold = on;
+    }
+
+    bool isFolding() const {
+      return m_fold;
+    }
+
+    //Bounds on the evaluation of each initializer.
+    void setEvaluationLimits(eval_limits lim) {
+      m_eval_limits = lim;
+    }
+
   private:
-    scope* m_scope;
+    expr* makeBinary(type* t, binop op, expr* e1, expr* e2);
+    expr* makeUnary(type* t, unop op, expr* e);
+    expr* makeConversion(expr* e, conversion c, type* t);
+
+    expr* foldBinary(binop op, expr* e1, expr* e2);
+    expr* foldUnary(unop op, expr* e);
+    expr* foldConversion(expr* e, conversion c);
+
+    void evaluateInit(object_decl* d, bool required);
+
+    expr* makeBool(bool b);
+    expr* makeInt(std::int32_t n);
+    expr* makeFloat(float n);
+
+    ast_context& m_ast;
+    type_context m_types;
+
+    scope_table m_scopes;
 
     fn_decl* m_fn;
 
+    bool m_fold;
+    eval_limits m_eval_limits;
+
     type* m_bool;
     type* m_char;
     type* m_int;
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+// A vector that keeps up to N elements inline and only goes to the heap
+// when it outgrows them. It is meant for the short lists of pointers that
+// make up the AST (arguments, parameters, statements), so elements must
+// be trivially copyable; growing and moving are plain memcpys.
+template<typename T, std::size_t N>
+class small_vector {
+    static_assert(std::is_trivially_copyable_v<T>, "small_vector holds trivially copyable types");
+
+  public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    small_vector() : m_data(inline_data()), m_size(0), m_capacity(N) {}
+
+    small_vector(std::initializer_list<T> list) : small_vector() {
+      assign(list.begin(), list.end());
+    }
+
+    small_vector(const small_vector& other) : small_vector() {
+      assign(other.begin(), other.end());
+    }
+
+    // Takes the heap buffer of 'other' if it has one, otherwise copies
+    // its inline elements.
+    small_vector(small_vector&& other) noexcept : small_vector() {
+      steal(other);
+    }
+
+    ~small_vector() {
+      release();
+    }
+
+    small_vector& operator=(const small_vector& other) {
+      if (this != &other) {
+        assign(other.begin(), other.end());
+      }
+      return *this;
+    }
+
+    small_vector& operator=(small_vector&& other) noexcept {
+      if (this != &other) {
+        release();
+        m_data = inline_data();
+        m_size = 0;
+        m_capacity = N;
+        steal(other);
+      }
+      return *this;
+    }
+
+    iterator begin() {
+      return m_data;
+    }
+
+    iterator end() {
+      return m_data + m_size;
+    }
+
+    const_iterator begin() const {
+      return m_data;
+    }
+
+    const_iterator end() const {
+      return m_data + m_size;
+    }
+
+    T* data() {
+      return m_data;
+    }
+
+    const T* data() const {
+      return m_data;
+    }
+
+    std::size_t size() const {
+      return m_size;
+    }
+
+    std::size_t capacity() const {
+      return m_capacity;
+    }
+
+    bool empty() const {
+      return m_size == 0;
+    }
+
+    // True when the elements are in the inline buffer.
+    bool isSmall() const {
+      return m_data == inline_data();
+    }
+
+    T& operator[](std::size_t n) {
+      assert(n < m_size);
+      return m_data[n];
+    }
+
+    const T& operator[](std::size_t n) const {
+      assert(n < m_size);
+      return m_data[n];
+    }
+
+    T& back() {
+      assert(m_size);
+      return m_data[m_size - 1];
+    }
+
+    const T& back() const {
+      assert(m_size);
+      return m_data[m_size - 1];
+    }
+
+    void push_back(const T& x) {
+      if (m_size == m_capacity) {
+        //'x' may be one of our own elements.
+        T copy = x;
+        grow(m_size + 1);
+        m_data[m_size++] = copy;
+        return;
+      }
+      m_data[m_size++] = x;
+    }
+
+    void pop_back() {
+      assert(m_size);
+      --m_size;
+    }
+
+    void clear() {
+      m_size = 0;
+    }
+
+    void reserve(std::size_t n) {
+      if (n > m_capacity) {
+        grow(n);
+      }
+    }
+
+    template<typename It>
+    void assign(It first, It last) {
+      clear();
+      insert(end(), first, last);
+    }
+
+    template<typename It>
+    iterator insert(iterator pos, It first, It last) {
+      std::size_t at = pos - m_data;
+      std::size_t n = std::distance(first, last);
+      reserve(m_size + n);
+      pos = m_data + at;
+      std::memmove(pos + n, pos, (m_size - at) * sizeof(T));
+      for (T* p = pos; first != last; ++first, ++p) {
+        *p = *first;
+      }
+      m_size += n;
+      return pos;
+    }
+
+  private:
+    T* inline_data() {
+      return reinterpret_cast<T*>(m_inline);
+    }
+
+    const T* inline_data() const {
+      return reinterpret_cast<const T*>(m_inline);
+    }
+
+    void grow(std::size_t min) {
+      std::size_t cap = std::size_t(m_capacity) * 2 > min ? std::size_t(m_capacity) * 2 : min;
+      T* p = static_cast<T*>(::operator new(cap * sizeof(T)));
+      std::memcpy(p, m_data, m_size * sizeof(T));
+      release();
+      m_data = p;
+      m_capacity = cap;
+    }
+
+    void release() {
+      if (!isSmall()) {
+        ::operator delete(m_data);
+      }
+    }
+
+    //Requires this vector to be empty and inline.
+    void steal(small_vector& other) {
+      if (other.isSmall()) {
+        std::memcpy(m_data, other.m_data, other.m_size * sizeof(T));
+      } else {
+        m_data = other.m_data;
+        m_capacity = other.m_capacity;
+      }
+      m_size = other.m_size;
+      other.m_data = other.inline_data();
+      other.m_size = 0;
+      other.m_capacity = N;
+    }
+
+    T* m_data;
+    std::uint32_t m_size;
+    std::uint32_t m_capacity;
+    alignas(T) unsigned char m_inline[N * sizeof(T)];
+};
+
+template<typename T, std::size_t N>
+bool operator==(const small_vector<T, N>& a, const small_vector<T, N>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i != a.size(); ++i) {
+    if (!(a[i] == b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename T, std::size_t N>
+bool operator!=(const small_vector<T, N>& a, const small_vector<T, N>& b) {
+  return !(a == b);
+}
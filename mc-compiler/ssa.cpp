@@ -0,0 +1,804 @@
+#include "ir.hpp"
+#include "decl.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Where an object lives: a local kept as SSA values, or an address to
+// load from and store to.
+struct place {
+  const decl* local;
+  ir_value* addr;
+};
+
+//The blocks that break and continue jump to.
+struct ir_loop {
+  ir_block* brk;
+  ir_block* cont;
+};
+
+//Builds a function in SSA form as it walks the body, after Braun et al.,
+//"Simple and Efficient Construction of Static Single Assignment Form".
+//Each block records the last value assigned to each local; reading a
+//local that a block did not assign looks through its predecessors, with
+//a phi where they join. A block is sealed once all its predecessors are
+//known, and phis placed in it before then get their operands at that
+//point. Phis that turn out to choose between one value and themselves
+//are replaced by that value.
+class ir_builder {
+  public:
+    explicit ir_builder(ir_function& fn);
+
+    void build();
+
+  private:
+    struct block_state {
+      std::unordered_map<const decl*, ir_value*> defs;
+      std::vector<ir_insn*> incomplete;
+      bool sealed = false;
+    };
+
+    void scan(const stmt* s);
+    void scan(const expr* e, bool direct);
+
+    ir_block* makeBlock();
+    void enterBlock(ir_block* b);
+    void sealBlock(ir_block* b);
+    void addEdge(ir_block* from, ir_block* to);
+    void jump(ir_block* target);
+    void branch(ir_value* c, ir_block* t, ir_block* f);
+
+    ir_insn* emitInsn(ir_op op, const type* t, std::uint32_t n);
+    ir_value* emit(ir_op op, const type* t, ir_value* a);
+    ir_value* emit(ir_op op, const type* t, ir_value* a, ir_value* b);
+    ir_value* makeJoin(const type* t, ir_block* end, ir_value* a, ir_value* b);
+    ir_value* makeAlloca(const decl* d, const type* t);
+    ir_value* getZero(const type* t);
+
+    ir_value* readVariable(const decl* d, ir_block* b);
+    ir_value* readVariableRecursive(const decl* d, ir_block* b);
+    void writeVariable(const decl* d, ir_block* b, ir_value* v);
+    ir_value* addPhiOperands(const decl* d, ir_insn* phi);
+    ir_value* tryRemoveTrivialPhi(ir_insn* phi);
+    void finish();
+
+    place declare(const decl* d);
+    ir_value* read(const place& p);
+    void write(const place& p, ir_value* v);
+
+    place buildPlace(const expr* e);
+    ir_value* buildExpr(const expr* e);
+    ir_value* buildUnary(const unop_expr* e);
+    ir_value* buildBinary(const binop_expr* e);
+    ir_value* buildLogical(const binop_expr* e);
+    ir_value* buildConditional(const cond_expr* e, bool value);
+    ir_value* buildCall(const call_expr* e);
+    ir_value* buildConversion(const conv_expr* e);
+
+    void buildStmt(const stmt* s);
+    void buildDecl(const decl* d);
+
+    ir_function& m_fn;
+    ir_block* m_entry;
+    ir_block* m_block; //Null after a jump, until the next reachable block
+    ir_insn* m_last_alloca;
+    std::vector<block_state> m_states; //By block id
+    std::vector<ir_loop> m_loops;
+
+    //The locals whose address is needed, with the type of that address.
+    std::unordered_map<const decl*, const type*> m_addressed;
+
+    //The locals declared so far, with their slot if they have one.
+    std::unordered_map<const decl*, ir_value*> m_locals;
+};
+
+ir_builder::ir_builder(ir_function& fn) : m_fn(fn), m_entry(), m_block(), m_last_alloca() {}
+
+//An address only escapes into the IR through a conditional reference,
+//as in (c ? x : y) = 1. Every other use of a local's name reads or
+//writes it in place.
+void ir_builder::scan(const expr* e, bool direct) {
+  switch (e->getKind()) {
+    case expr::id_kind: {
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      if (!direct && d->isVariable()) {
+        m_addressed.emplace(d, e->getType());
+      }
+      return;
+    }
+    case expr::unop_kind:
+      return scan(static_cast<const unop_expr*>(e)->m_arg, false);
+    case expr::binop_kind:
+      scan(static_cast<const binop_expr*>(e)->m_lhs, false);
+      return scan(static_cast<const binop_expr*>(e)->m_rhs, false);
+    case expr::call_kind:
+    case expr::index_kind: {
+      const postfix_expr* p = static_cast<const postfix_expr*>(e);
+      scan(p->m_base, false);
+      for (const expr* a : p->m_args) {
+        scan(a, false);
+      }
+      return;
+    }
+    case expr::cast_kind:
+      return scan(static_cast<const cast_expr*>(e)->m_src, direct);
+    case expr::assign_kind:
+      scan(static_cast<const assign_expr*>(e)->m_rhs, false);
+      return scan(static_cast<const assign_expr*>(e)->m_lhs, direct);
+    case expr::cond_kind: {
+      const cond_expr* c = static_cast<const cond_expr*>(e);
+      scan(c->m_cond, false);
+      scan(c->m_true, false);
+      return scan(c->m_false, false);
+    }
+    case expr::conv_kind: {
+      //Reading a conditional object reads one of its arms in place.
+      const conv_expr* c = static_cast<const conv_expr*>(e);
+      if (c->m_conv == conv_value && c->m_src->getKind() == expr::cond_kind) {
+        const cond_expr* src = static_cast<const cond_expr*>(c->m_src);
+        scan(src->m_cond, false);
+        scan(src->m_true, true);
+        return scan(src->m_false, true);
+      }
+      return scan(c->m_src, c->m_conv == conv_value || (c->m_conv == conv_identity && direct));
+    }
+    default:
+      return;
+  }
+}
+
+void ir_builder::scan(const stmt* s) {
+  switch (s->getKind()) {
+    case stmt::block_kind:
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        scan(s1);
+      }
+      return;
+    case stmt::when_kind:
+      scan(static_cast<const when_stmt*>(s)->getCondition(), true);
+      return scan(static_cast<const when_stmt*>(s)->getBody());
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      scan(i->getCondition(), true);
+      scan(i->getTrueBranch());
+      if (i->getFalseBranch()) {
+        scan(i->getFalseBranch());
+      }
+      return;
+    }
+    case stmt::while_kind:
+      scan(static_cast<const while_stmt*>(s)->getCondition(), true);
+      return scan(static_cast<const while_stmt*>(s)->getBody());
+    case stmt::ret_kind:
+      if (const expr* e = static_cast<const ret_stmt*>(s)->m_val) {
+        scan(e, true);
+      }
+      return;
+    case stmt::decl_kind:
+      if (const expr* e = static_cast<const object_decl*>(static_cast<const decl_stmt*>(s)->m_decl)->getInit()) {
+        scan(e, true);
+      }
+      return;
+    case stmt::expr_kind:
+      return scan(static_cast<const expr_stmt*>(s)->m_expr, true);
+    default:
+      return;
+  }
+}
+
+
+ir_block* ir_builder::makeBlock() {
+  m_states.emplace_back();
+  return m_fn.makeBlock();
+}
+
+//A block nothing branches to is never laid out, and what would have
+//gone in it is skipped.
+void ir_builder::enterBlock(ir_block* b) {
+  if (b != m_entry && b->preds.empty()) {
+    m_block = nullptr;
+    return;
+  }
+  m_fn.addBlock(b);
+  m_block = b;
+}
+
+void ir_builder::sealBlock(ir_block* b) {
+  block_state& s = m_states[b->id];
+  for (ir_insn* phi : s.incomplete) {
+    addPhiOperands(phi->var, phi);
+  }
+  s.incomplete.clear();
+  s.sealed = true;
+}
+
+void ir_builder::addEdge(ir_block* from, ir_block* to) {
+  if (m_states[to->id].sealed) {
+    throw std::logic_error("branch to a sealed block");
+  }
+  to->preds.push_back(from);
+}
+
+void ir_builder::jump(ir_block* target) {
+  if (m_block) {
+    ir_insn* i = emitInsn(ir_br, nullptr, 0);
+    i->targets[0] = target;
+    addEdge(m_block, target);
+  }
+  m_block = nullptr;
+}
+
+void ir_builder::branch(ir_value* c, ir_block* t, ir_block* f) {
+  ir_insn* i = emitInsn(ir_condbr, nullptr, 1);
+  i->ops[0] = c;
+  i->targets[0] = t;
+  i->targets[1] = f;
+  addEdge(m_block, t);
+  addEdge(m_block, f);
+  m_block = nullptr;
+}
+
+ir_insn* ir_builder::emitInsn(ir_op op, const type* t, std::uint32_t n) {
+  ir_insn* i = m_fn.makeInsn(op, t, n);
+  m_fn.append(m_block, i);
+  return i;
+}
+
+ir_value* ir_builder::emit(ir_op op, const type* t, ir_value* a) {
+  ir_insn* i = emitInsn(op, t, 1);
+  i->ops[0] = a;
+  return i;
+}
+
+ir_value* ir_builder::emit(ir_op op, const type* t, ir_value* a, ir_value* b) {
+  ir_insn* i = emitInsn(op, t, 2);
+  i->ops[0] = a;
+  i->ops[1] = b;
+  return i;
+}
+
+//Enters 'end', sealed, with a phi of 'a' from its first predecessor and
+//'b' from its second.
+ir_value* ir_builder::makeJoin(const type* t, ir_block* end, ir_value* a, ir_value* b) {
+  sealBlock(end);
+  enterBlock(end);
+  ir_insn* phi = emitInsn(ir_phi, t, 2);
+  phi->ops[0] = a;
+  phi->ops[1] = b;
+  return phi;
+}
+
+//Slots go at the top of the entry block, in the order they are made.
+ir_value* ir_builder::makeAlloca(const decl* d, const type* t) {
+  ir_insn* i = m_fn.makeInsn(ir_alloca, t, 0);
+  i->var = d;
+  m_fn.insertAfter(m_entry, m_last_alloca, i);
+  m_last_alloca = i;
+  return i;
+}
+
+//Values of other types are null pointers.
+ir_value* ir_builder::getZero(const type* t) {
+  switch (t->getKind()) {
+    case type::bool_kind:
+      return m_fn.getConstant(t, const_value::makeBool(false));
+    case type::char_kind:
+      return m_fn.getConstant(t, const_value::makeChar(0));
+    case type::float_kind:
+      return m_fn.getConstant(t, const_value::makeFloat(0));
+    default:
+      return m_fn.getConstant(t, const_value::makeInt(0));
+  }
+}
+
+
+static ir_value* resolve(ir_value* v) {
+  while (v->kind == ir_value::insn_kind && static_cast<ir_insn*>(v)->replacement) {
+    v = static_cast<ir_insn*>(v)->replacement;
+  }
+  return v;
+}
+
+ir_value* ir_builder::readVariable(const decl* d, ir_block* b) {
+  block_state& s = m_states[b->id];
+  auto iter = s.defs.find(d);
+  if (iter != s.defs.end()) {
+    return iter->second = resolve(iter->second);
+  }
+  return readVariableRecursive(d, b);
+}
+
+//A local read before anything is assigned to it on some path is zero
+//there; the front end only lets that happen in code that cannot run.
+ir_value* ir_builder::readVariableRecursive(const decl* d, ir_block* b) {
+  const type* t = static_cast<const typed_decl*>(d)->getType();
+  ir_value* v;
+  if (!m_states[b->id].sealed) {
+    ir_insn* phi = m_fn.makeInsn(ir_phi, t, 0);
+    phi->var = d;
+    m_fn.insertAfter(b, nullptr, phi);
+    m_states[b->id].incomplete.push_back(phi);
+    v = phi;
+  } else if (b->preds.size() == 1) {
+    v = readVariable(d, b->preds[0]);
+  } else if (b->preds.empty()) {
+    v = getZero(t);
+  } else {
+    ir_insn* phi = m_fn.makeInsn(ir_phi, t, 0);
+    phi->var = d;
+    m_fn.insertAfter(b, nullptr, phi);
+    writeVariable(d, b, phi);
+    v = addPhiOperands(d, phi);
+  }
+  writeVariable(d, b, v);
+  return v;
+}
+
+void ir_builder::writeVariable(const decl* d, ir_block* b, ir_value* v) {
+  m_states[b->id].defs[d] = v;
+}
+
+ir_value* ir_builder::addPhiOperands(const decl* d, ir_insn* phi) {
+  ir_block* b = phi->block;
+  std::uint32_t n = static_cast<std::uint32_t>(b->preds.size());
+  phi->ops = m_fn.makeOperands(n);
+  phi->num_ops = n;
+  for (std::uint32_t k = 0; k != n; ++k) {
+    phi->ops[k] = readVariable(d, b->preds[k]);
+  }
+  return tryRemoveTrivialPhi(phi);
+}
+
+//A phi whose operands are all one value, or the phi itself, is that
+//value. Phis that used this one may become trivial in turn; finish
+//catches those.
+ir_value* ir_builder::tryRemoveTrivialPhi(ir_insn* phi) {
+  ir_value* same = nullptr;
+  for (std::uint32_t k = 0; k != phi->num_ops; ++k) {
+    ir_value* op = resolve(phi->ops[k]);
+    if (op == same || op == phi) {
+      continue;
+    }
+    if (same) {
+      return phi;
+    }
+    same = op;
+  }
+  phi->replacement = same ? same : getZero(phi->ty);
+  return phi->replacement;
+}
+
+//Settles the remaining trivial phis, points every use at what replaced
+//them and unlinks them.
+void ir_builder::finish() {
+  const std::vector<ir_block*>& blocks = m_fn.getBlocks();
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (ir_block* b : blocks) {
+      for (ir_insn* i = b->first; i && i->op == ir_phi; i = i->next) {
+        if (!i->replacement && tryRemoveTrivialPhi(i) != i) {
+          changed = true;
+        }
+      }
+    }
+  }
+  for (ir_block* b : blocks) {
+    for (ir_insn* i = b->first; i;) {
+      ir_insn* next = i->next;
+      if (i->op == ir_phi && i->replacement) {
+        m_fn.remove(i);
+      } else {
+        for (std::uint32_t k = 0; k != i->num_ops; ++k) {
+          i->ops[k] = resolve(i->ops[k]);
+        }
+      }
+      i = next;
+    }
+  }
+  m_fn.renumber();
+}
+
+
+//Parameters are assigned on entry, like any other local.
+void ir_builder::build() {
+  const fn_decl* fn = m_fn.getDecl();
+  scan(fn->getBody());
+
+  m_entry = makeBlock();
+  enterBlock(m_entry);
+  sealBlock(m_entry);
+  for (const decl* d : fn->getParameters()) {
+    ir_param* p = m_fn.addParam(static_cast<const parm_decl*>(d)->getType(), d);
+    write(declare(d), p);
+  }
+
+  buildStmt(fn->getBody());
+
+  //A function that runs off its end returns zero.
+  if (m_block) {
+    emit(ir_ret, nullptr, getZero(fn->getReturnType()));
+  }
+  finish();
+}
+
+//Only locals whose address is needed get a slot.
+place ir_builder::declare(const decl* d) {
+  auto iter = m_addressed.find(d);
+  ir_value* slot = iter != m_addressed.end() ? makeAlloca(d, iter->second) : nullptr;
+  m_locals.emplace(d, slot);
+  return {slot ? nullptr : d, slot};
+}
+
+ir_value* ir_builder::read(const place& p) {
+  if (p.local) {
+    return readVariable(p.local, m_block);
+  }
+  return emit(ir_load, static_cast<const ref_type*>(p.addr->ty)->getObjectType(), p.addr);
+}
+
+void ir_builder::write(const place& p, ir_value* v) {
+  if (p.local) {
+    return writeVariable(p.local, m_block, v);
+  }
+  emit(ir_store, nullptr, p.addr, v);
+}
+
+
+//Names that are not locals are globals, which are always in memory.
+place ir_builder::buildPlace(const expr* e) {
+  switch (e->getKind()) {
+    case expr::id_kind: {
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      auto iter = m_locals.find(d);
+      if (iter == m_locals.end()) {
+        return {nullptr, m_fn.getGlobal(e->getType(), d)};
+      }
+      return {iter->second ? nullptr : d, iter->second};
+    }
+    case expr::cast_kind:
+      return buildPlace(static_cast<const cast_expr*>(e)->m_src);
+    case expr::assign_kind: {
+      //The value is computed before the object it is stored to.
+      const assign_expr* a = static_cast<const assign_expr*>(e);
+      ir_value* v = buildExpr(a->m_rhs);
+      place p = buildPlace(a->m_lhs);
+      write(p, v);
+      return p;
+    }
+    case expr::cond_kind:
+      return {nullptr, buildConditional(static_cast<const cond_expr*>(e), false)};
+    case expr::conv_kind:
+      if (static_cast<const conv_expr*>(e)->m_conv == conv_identity) {
+        return buildPlace(static_cast<const conv_expr*>(e)->m_src);
+      }
+      throw std::logic_error("not an object");
+    default:
+      throw std::runtime_error("not implemented in this compiler version");
+  }
+}
+
+ir_value* ir_builder::buildExpr(const expr* e) {
+  switch (e->getKind()) {
+    case expr::bool_kind:
+      return m_fn.getConstant(e->getType(), const_value::makeBool(static_cast<const bool_expr*>(e)->val));
+    case expr::int_kind:
+      return m_fn.getConstant(e->getType(), const_value::makeInt(static_cast<const int_expr*>(e)->val));
+    case expr::float_kind:
+      return m_fn.getConstant(e->getType(), const_value::makeFloat(static_cast<float>(static_cast<const float_expr*>(e)->val)));
+    case expr::id_kind: {
+      //Constants with a compile-time value are used in place; other
+      //local constants are the value they were initialized with.
+      const decl* d = static_cast<const id_expr*>(e)->ref;
+      switch (d->getKind()) {
+        case decl::const_kind:
+        case decl::value_kind: {
+          const object_decl* obj = static_cast<const object_decl*>(d);
+          if (obj->hasValue()) {
+            return m_fn.getConstant(e->getType(), obj->getValue());
+          }
+          return readVariable(d, m_block);
+        }
+        case decl::fn_kind:
+          return m_fn.getGlobal(e->getType(), d);
+        default:
+          throw std::logic_error("not a valid id expression");
+      }
+    }
+    case expr::unop_kind:
+      return buildUnary(static_cast<const unop_expr*>(e));
+    case expr::binop_kind:
+      return buildBinary(static_cast<const binop_expr*>(e));
+    case expr::call_kind:
+      return buildCall(static_cast<const call_expr*>(e));
+    case expr::cast_kind:
+      //The operand was already converted to the target type.
+      return buildExpr(static_cast<const cast_expr*>(e)->m_src);
+    case expr::cond_kind:
+      return buildConditional(static_cast<const cond_expr*>(e), true);
+    case expr::conv_kind:
+      return buildConversion(static_cast<const conv_expr*>(e));
+    default:
+      throw std::runtime_error("not implemented in this compiler version");
+  }
+}
+
+ir_value* ir_builder::buildUnary(const unop_expr* e) {
+  ir_value* v = buildExpr(e->m_arg);
+  switch (e->m_op) {
+    case uo_pos:
+      return v;
+    case uo_neg:
+      return emit(e->getType()->getKind() == type::float_kind ? ir_fneg : ir_neg, e->getType(), v);
+    case uo_cmp:
+    case uo_not:
+      return emit(ir_bnot, e->getType(), v);
+    default:
+      throw std::runtime_error("not implemented in this compiler version");
+  }
+}
+
+//The operators and operations are listed in the same order, from add to
+//shr and from eq to ge.
+ir_value* ir_builder::buildBinary(const binop_expr* e) {
+  if (e->m_op == bo_land || e->m_op == bo_lor) {
+    return buildLogical(e);
+  }
+  ir_value* l = buildExpr(e->m_lhs);
+  ir_value* r = buildExpr(e->m_rhs);
+  if (e->m_op >= bo_eq) {
+    return emit(static_cast<ir_op>(ir_eq + (e->m_op - bo_eq)), e->getType(), l, r);
+  }
+  if (e->getType()->getKind() == type::float_kind) {
+    if (e->m_op > bo_rem) {
+      throw std::logic_error("not a float operation");
+    }
+    return emit(static_cast<ir_op>(ir_fadd + (e->m_op - bo_add)), e->getType(), l, r);
+  }
+  return emit(static_cast<ir_op>(ir_add + (e->m_op - bo_add)), e->getType(), l, r);
+}
+
+//The right operand is only evaluated when the left one does not decide
+//the result.
+ir_value* ir_builder::buildLogical(const binop_expr* e) {
+  bool land = e->m_op == bo_land;
+  ir_value* l = buildExpr(e->m_lhs);
+  ir_block* rhs = makeBlock();
+  ir_block* end = makeBlock();
+  if (land) {
+    branch(l, rhs, end);
+  } else {
+    branch(l, end, rhs);
+  }
+
+  sealBlock(rhs);
+  enterBlock(rhs);
+  ir_value* r = buildExpr(e->m_rhs);
+  jump(end);
+
+  return makeJoin(e->getType(), end, m_fn.getConstant(e->getType(), const_value::makeBool(!land)), r);
+}
+
+//A conditional object is chosen by its address, unless only its value
+//is wanted.
+ir_value* ir_builder::buildConditional(const cond_expr* e, bool value) {
+  bool ref = e->getType()->isReference();
+  auto arm = [&](const expr* x) {
+    if (!ref) {
+      return buildExpr(x);
+    }
+    place p = buildPlace(x);
+    if (value) {
+      return read(p);
+    }
+    if (!p.addr) {
+      throw std::logic_error("a conditional reference to a local without a slot");
+    }
+    return p.addr;
+  };
+
+  ir_value* c = buildExpr(e->m_cond);
+  ir_block* t = makeBlock();
+  ir_block* f = makeBlock();
+  ir_block* end = makeBlock();
+  branch(c, t, f);
+
+  sealBlock(t);
+  enterBlock(t);
+  ir_value* a = arm(e->m_true);
+  jump(end);
+
+  sealBlock(f);
+  enterBlock(f);
+  ir_value* b = arm(e->m_false);
+  jump(end);
+
+  return makeJoin(value ? e->getType()->getObjectType() : e->getType(), end, a, b);
+}
+
+//Arguments are evaluated left to right, after the function.
+ir_value* ir_builder::buildCall(const call_expr* e) {
+  ir_value* callee = buildExpr(e->m_base);
+  std::vector<ir_value*> args;
+  args.reserve(e->m_args.size());
+  for (const expr* a : e->m_args) {
+    args.push_back(buildExpr(a));
+  }
+  ir_insn* i = emitInsn(ir_call, e->getType(), static_cast<std::uint32_t>(args.size() + 1));
+  i->ops[0] = callee;
+  std::copy(args.begin(), args.end(), i->ops + 1);
+  return i;
+}
+
+ir_value* ir_builder::buildConversion(const conv_expr* e) {
+  switch (e->m_conv) {
+    case conv_identity:
+      return buildExpr(e->m_src);
+    case conv_value:
+      if (e->m_src->getKind() == expr::cond_kind) {
+        return buildConditional(static_cast<const cond_expr*>(e->m_src), true);
+      }
+      return read(buildPlace(e->m_src));
+    case conv_bool:
+      return emit(ir_tobool, e->getType(), buildExpr(e->m_src));
+    case conv_char:
+      return emit(ir_tochar, e->getType(), buildExpr(e->m_src));
+    case conv_int:
+      return emit(ir_toint, e->getType(), buildExpr(e->m_src));
+    case conv_ext:
+      return emit(ir_itof, e->getType(), buildExpr(e->m_src));
+    case conv_trunc:
+      return emit(ir_ftoi, e->getType(), buildExpr(e->m_src));
+  }
+  throw std::logic_error("not a valid conversion");
+}
+
+
+//Statements after a jump can never run, so they are not built.
+void ir_builder::buildStmt(const stmt* s) {
+  switch (s->getKind()) {
+    case stmt::block_kind:
+      for (const stmt* s1 : static_cast<const block_stmt*>(s)->getStatements()) {
+        if (!m_block) {
+          break;
+        }
+        buildStmt(s1);
+      }
+      return;
+
+    case stmt::when_kind: {
+      const when_stmt* w = static_cast<const when_stmt*>(s);
+      ir_value* c = buildExpr(w->getCondition());
+      ir_block* body = makeBlock();
+      ir_block* end = makeBlock();
+      branch(c, body, end);
+
+      sealBlock(body);
+      enterBlock(body);
+      buildStmt(w->getBody());
+      jump(end);
+
+      sealBlock(end);
+      return enterBlock(end);
+    }
+
+    case stmt::if_kind: {
+      const if_stmt* i = static_cast<const if_stmt*>(s);
+      ir_value* c = buildExpr(i->getCondition());
+      ir_block* t = makeBlock();
+      ir_block* f = i->getFalseBranch() ? makeBlock() : nullptr;
+      ir_block* end = makeBlock();
+      branch(c, t, f ? f : end);
+
+      sealBlock(t);
+      enterBlock(t);
+      buildStmt(i->getTrueBranch());
+      jump(end);
+
+      if (f) {
+        sealBlock(f);
+        enterBlock(f);
+        buildStmt(i->getFalseBranch());
+        jump(end);
+      }
+
+      sealBlock(end);
+      return enterBlock(end);
+    }
+
+    //The header is sealed once the body, and every continue in it, has
+    //been built.
+    case stmt::while_kind: {
+      const while_stmt* w = static_cast<const while_stmt*>(s);
+      ir_block* cond = makeBlock();
+      ir_block* body = makeBlock();
+      ir_block* end = makeBlock();
+      jump(cond);
+
+      enterBlock(cond);
+      ir_value* c = buildExpr(w->getCondition());
+      branch(c, body, end);
+
+      sealBlock(body);
+      enterBlock(body);
+      m_loops.push_back({end, cond});
+      buildStmt(w->getBody());
+      m_loops.pop_back();
+      jump(cond);
+
+      sealBlock(cond);
+      sealBlock(end);
+      return enterBlock(end);
+    }
+
+    case stmt::break_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("break outside of a loop");
+      }
+      return jump(m_loops.back().brk);
+
+    case stmt::cont_kind:
+      if (m_loops.empty()) {
+        throw std::runtime_error("continue outside of a loop");
+      }
+      return jump(m_loops.back().cont);
+
+    case stmt::ret_kind: {
+      const expr* e = static_cast<const ret_stmt*>(s)->m_val;
+      emit(ir_ret, nullptr, e ? buildExpr(e) : getZero(m_fn.getDecl()->getReturnType()));
+      m_block = nullptr;
+      return;
+    }
+
+    case stmt::decl_kind:
+      return buildDecl(static_cast<const decl_stmt*>(s)->m_decl);
+
+    //Pure expressions are still evaluated, since dividing by zero traps.
+    case stmt::expr_kind: {
+      const expr* e = static_cast<const expr_stmt*>(s)->m_expr;
+      if (e->getType()->isReference()) {
+        buildPlace(e);
+      } else {
+        buildExpr(e);
+      }
+      return;
+    }
+  }
+}
+
+//A variable without an initializer starts out as zero. Constants
+//evaluated at compile time are used in place.
+void ir_builder::buildDecl(const decl* d) {
+  const object_decl* obj = static_cast<const object_decl*>(d);
+  switch (d->getKind()) {
+    case decl::var_kind: {
+      ir_value* init = obj->getInit() ? buildExpr(obj->getInit()) : getZero(obj->getType());
+      return write(declare(d), init);
+    }
+    case decl::const_kind:
+    case decl::value_kind:
+      if (!obj->hasValue()) {
+        write(declare(d), buildExpr(obj->getInit()));
+      }
+      return;
+    default:
+      throw std::runtime_error("not a valid local declaration");
+  }
+}
+
+
+ir_program::ir_program(const decl* prog) : m_prog(prog) {
+  for (const decl* d : static_cast<const prog_decl*>(prog)->getDeclarations()) {
+    if (d->getKind() != decl::fn_kind || !static_cast<const fn_decl*>(d)->getBody()) {
+      continue;
+    }
+    auto fn = std::make_unique<ir_function>(static_cast<const fn_decl*>(d));
+    ir_builder(*fn).build();
+    m_fns.push_back(std::move(fn));
+  }
+}
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <vector>
+#include "small_vector.hpp"
+
+#include <utility>
 
 class expr;
 class decl;
@@ -25,8 +27,6 @@ class stmt {
 
 
   public:
-    virtual ~stmt() = default;
-
     kind getKind() const {
       return m_kind;
     }
@@ -35,11 +35,11 @@ class stmt {
     kind m_kind;
 };
 
-using stmt_list = std::vector<stmt*>;
+using stmt_list = small_vector<stmt*, 8>;
 
 struct block_stmt : stmt {
 
-  block_stmt(const stmt_list& ss) : stmt(block_kind), m_stmts(ss) {}
+  block_stmt(stmt_list&& ss) : stmt(block_kind), m_stmts(std::move(ss)) {}
 
   const stmt_list& getStatements() const {
     return m_stmts;
@@ -109,7 +109,7 @@ struct break_stmt : stmt {
 };
 
 struct cont_stmt : stmt {
-    cont_stmt() : stmt(break_kind) {}
+    cont_stmt() : stmt(cont_kind) {}
 };
 
 struct ret_stmt : stmt {
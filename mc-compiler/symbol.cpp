@@ -1 +1,194 @@
 #include "symbol.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+
+std::ostream& operator<<(std::ostream& os, const symbol_entry& sym) {
+  return os << sym.str();
+}
+
+static std::uint64_t load(const char* p, std::size_t n) {
+  std::uint64_t v = 0;
+  std::memcpy(&v, p, n);
+  return v;
+}
+
+//Multiply and fold the high half of the product back into the low half.
+static std::uint64_t mix(std::uint64_t a, std::uint64_t b) {
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+}
+
+//A fast, non-cryptographic hash that consumes 8 bytes at a time.
+std::uint64_t hashString(std::string_view str) {
+  const std::uint64_t k0 = 0xa0761d6478bd642full;
+  const std::uint64_t k1 = 0xe7037ed1a0b428dbull;
+
+  const char* p = str.data();
+  std::size_t n = str.size();
+  std::uint64_t h = k0 ^ n;
+  for (; n >= 8; p += 8, n -= 8) {
+    h = mix(h ^ load(p, 8), k1);
+  }
+  if (n) {
+    h = mix(h ^ load(p, n), k1);
+  }
+  return mix(h, k0);
+}
+
+symbol_table::symbol_table() : m_count(0), m_published(0) {
+  for (shard& s : m_shards) {
+    s.table.store(makeTable(64, nullptr), std::memory_order_relaxed);
+  }
+  for (auto& seg : m_segments) {
+    seg.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+symbol_table::~symbol_table() {
+  for (shard& s : m_shards) {
+    slot_table* t = s.table.load(std::memory_order_relaxed);
+    while (t) {
+      slot_table* prev = t->prev;
+      std::free(t);
+      t = prev;
+    }
+  }
+  for (auto& seg : m_segments) {
+    delete[] seg.load(std::memory_order_relaxed);
+  }
+}
+
+symbol_table::slot_table* symbol_table::makeTable(std::size_t capacity, slot_table* prev) {
+  std::size_t n = sizeof(slot_table) + (capacity - 1) * sizeof(std::atomic<const symbol_entry*>);
+  slot_table* t = static_cast<slot_table*>(std::malloc(n));
+  if (!t) {
+    throw std::bad_alloc();
+  }
+  t->mask = capacity - 1;
+  t->prev = prev;
+  for (std::size_t i = 0; i != capacity; ++i) {
+    new (&t->slots[i]) std::atomic<const symbol_entry*>(nullptr);
+  }
+  return t;
+}
+
+const symbol_entry* symbol_table::find(const slot_table* t, std::string_view str, std::uint64_t h) {
+  for (std::size_t i = h & t->mask; ; i = (i + 1) & t->mask) {
+    const symbol_entry* e = t->slots[i].load(std::memory_order_acquire);
+    if (!e) {
+      return nullptr;
+    }
+    if (e->hash() == h && e->str() == str) {
+      return e;
+    }
+  }
+}
+
+void symbol_table::place(slot_table* t, const symbol_entry* e) {
+  std::size_t i = e->hash() & t->mask;
+  while (t->slots[i].load(std::memory_order_relaxed)) {
+    i = (i + 1) & t->mask;
+  }
+  t->slots[i].store(e, std::memory_order_release);
+}
+
+symbol symbol_table::get(std::string_view str) {
+  std::uint64_t h = hashString(str);
+  shard& s = m_shards[h >> (64 - shard_bits)];
+  if (const symbol_entry* e = find(s.table.load(std::memory_order_acquire), str, h)) {
+    return e;
+  }
+  return insert(s, str, h);
+}
+
+symbol symbol_table::insert(shard& s, std::string_view str, std::uint64_t h) {
+  std::lock_guard<std::mutex> guard(s.lock);
+
+  //Another thread may have inserted it since we looked.
+  slot_table* t = s.table.load(std::memory_order_relaxed);
+  if (const symbol_entry* e = find(t, str, h)) {
+    return e;
+  }
+
+  //Keep the load factor at or below 1/2. The new table is only published
+  //once it is complete.
+  if ((s.count + 1) * 2 > t->mask + 1) {
+    slot_table* bigger = makeTable((t->mask + 1) * 2, t);
+    for (std::size_t i = 0; i <= t->mask; ++i) {
+      if (const symbol_entry* e = t->slots[i].load(std::memory_order_relaxed)) {
+        place(bigger, e);
+      }
+    }
+    s.table.store(bigger, std::memory_order_release);
+    t = bigger;
+  }
+
+  std::uint32_t id = m_count.fetch_add(1, std::memory_order_relaxed);
+  void* mem = s.mem.allocate(sizeof(symbol_entry) + str.size() + 1, alignof(symbol_entry));
+  symbol_entry* e = new (mem) symbol_entry(h, id, str.size());
+  char* chars = reinterpret_cast<char*>(e + 1);
+  std::memcpy(chars, str.data(), str.size());
+  chars[str.size()] = 0;
+
+  publish(e);
+  place(t, e);
+  ++s.count;
+  return e;
+}
+
+//Segment k holds the 2^(first_segment_bits + k) ids that follow those in
+//the segments before it.
+static void locate(std::uint32_t id, int first_bits, int& seg, std::uint32_t& offset) {
+  std::uint32_t v = (id >> first_bits) + 1;
+  seg = 31 - __builtin_clz(v);
+  offset = id - (((1u << seg) - 1) << first_bits);
+}
+
+void symbol_table::publish(const symbol_entry* e) {
+  int k;
+  std::uint32_t offset;
+  locate(e->id(), first_segment_bits, k, offset);
+
+  std::atomic<const symbol_entry*>* seg = m_segments[k].load(std::memory_order_acquire);
+  if (!seg) {
+    //Entries in one segment can come from different shards, so two threads
+    //may race to create it.
+    std::size_t n = std::size_t(1) << (first_segment_bits + k);
+    auto* fresh = new std::atomic<const symbol_entry*>[n];
+    for (std::size_t i = 0; i != n; ++i) {
+      fresh[i].store(nullptr, std::memory_order_relaxed);
+    }
+    if (m_segments[k].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel)) {
+      seg = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  seg[offset].store(e, std::memory_order_release);
+
+  //Extend the published prefix past every entry stored so far. If the
+  //entry at the end of the prefix is not stored yet, its own publisher
+  //will extend the prefix once it is.
+  std::uint32_t n = m_published.load(std::memory_order_acquire);
+  while (lookup(n)) {
+    if (m_published.compare_exchange_weak(n, n + 1, std::memory_order_acq_rel)) {
+      ++n;
+    }
+  }
+}
+
+//Null if the entry for 'id' is not stored yet.
+const symbol_entry* symbol_table::lookup(std::uint32_t id) const {
+  int k;
+  std::uint32_t offset;
+  locate(id, first_segment_bits, k, offset);
+  std::atomic<const symbol_entry*>* seg = m_segments[k].load(std::memory_order_acquire);
+  return seg ? seg[offset].load(std::memory_order_acquire) : nullptr;
+}
+
+symbol symbol_table::operator[](std::uint32_t id) const {
+  return lookup(id);
+}
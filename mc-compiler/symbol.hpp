@@ -1,27 +1,133 @@
 #pragma once
 
+#include "arena.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
 #include <string>
-#include<unordered_set>
-// A symbol is...
-using symbol = const std::string*;
+#include <string_view>
 
-//A sumbol table is a collection of symbol.s  These are used to ensure that sting comparison is *fast*.
-//Many applications link additional information to symbols.  Sutton does not#p.
+// A symbol is a unique spelling. Its characters are stored immediately
+// after the entry, followed by a null terminator.
+class symbol_entry {
+  public:
+    symbol_entry(std::uint64_t h, std::uint32_t id, std::uint32_t len) : m_hash(h), m_id(id), m_len(len) {}
+
+    std::string_view str() const {
+      return {data(), m_len};
+    }
+
+    const char* data() const {
+      return reinterpret_cast<const char*>(this + 1);
+    }
+
+    std::size_t size() const {
+      return m_len;
+    }
+
+    std::uint64_t hash() const {
+      return m_hash;
+    }
+
+    // A dense index, suitable for side tables stored in vectors.
+    std::uint32_t id() const {
+      return m_id;
+    }
 
+  private:
+    std::uint64_t m_hash;
+    std::uint32_t m_id;
+    std::uint32_t m_len;
+};
+
+using symbol = const symbol_entry*;
+
+std::ostream& operator<<(std::ostream& os, const symbol_entry& sym);
+
+std::uint64_t hashString(std::string_view str);
+
+//A sumbol table is a collection of symbol.s  These are used to ensure that sting comparison is *fast*.
+//Many applications link additional information to symbols; the dense ids
+//let them do that with plain vectors.
+//
+//The table is safe to share between threads, so many lexers and parsers
+//can intern into one namespace. It is split into shards by hash. Each
+//shard has its own arena and open-addressing table; lookups of existing
+//spellings take no locks, and only inserting a new spelling locks its
+//shard. Symbols never move, so pointers and ids are stable everywhere.
 class symbol_table {
   public:
+    symbol_table();
+    ~symbol_table();
+
+    symbol_table(const symbol_table&) = delete;
+    symbol_table& operator=(const symbol_table&) = delete;
+
     symbol get(const char* str);
     symbol get(const std::string& str);
+    symbol get(std::string_view str);
+
+    // Returns the symbol with the given id.
+    symbol operator[](std::uint32_t id) const;
+
+    // The number of symbols that can be looked up by id: every id in
+    // [0, size()) has been published. An id handed out to one thread may
+    // briefly be at or past size() while a lower id is still being
+    // inserted by another.
+    std::size_t size() const {
+      return m_published.load(std::memory_order_acquire);
+    }
+
   private:
-    std::unordered_set<std::string> m_syms;
+    static constexpr int shard_bits = 6;
+    static constexpr int num_shards = 1 << shard_bits;
+
+    //Open addressing with linear probing; the capacity is a power of 2.
+    //Tables that have been outgrown are kept until the symbol table is
+    //destroyed, since readers may still be probing them.
+    struct slot_table {
+      std::size_t mask;
+      slot_table* prev;
+      std::atomic<const symbol_entry*> slots[1];
+    };
+
+    struct alignas(64) shard {
+      std::mutex lock;
+      std::atomic<slot_table*> table{nullptr};
+      std::size_t count = 0;
+      arena mem;
+    };
+
+    //The id directory is a list of segments that double in size, so it
+    //can grow without moving the entries readers are looking at.
+    static constexpr int first_segment_bits = 10;
+    static constexpr int num_segments = 32 - first_segment_bits;
+
+    static slot_table* makeTable(std::size_t capacity, slot_table* prev);
+    static const symbol_entry* find(const slot_table* t, std::string_view str, std::uint64_t h);
+    static void place(slot_table* t, const symbol_entry* e);
+
+    symbol insert(shard& s, std::string_view str, std::uint64_t h);
+    void publish(const symbol_entry* e);
+    const symbol_entry* lookup(std::uint32_t id) const;
+
+    shard m_shards[num_shards];
+
+    std::atomic<std::uint32_t> m_count;
+
+    //The length of the prefix of ids whose entries are all published.
+    std::atomic<std::uint32_t> m_published;
+
+    std::atomic<std::atomic<const symbol_entry*>*> m_segments[num_segments];
 };
 
 inline symbol symbol_table::get(const char* str) {
-  return &*m_syms.insert(str).first;
+  return get(std::string_view(str));
 }
 
-
 //Returns a unique symbol for the spelling of 'str'.
 inline symbol symbol_table::get(const std::string& str) {
-  return &*m_syms.insert(str).first;
+  return get(std::string_view(str));
 }
@@ -0,0 +1,107 @@
+#include "target.hpp"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <mutex>
+#include <stdexcept>
+
+static llvm::CodeGenOpt::Level getCodeGenLevel(opt_level level) {
+    switch (level) {
+      case opt_none:
+        return llvm::CodeGenOpt::None;
+      case opt_less:
+        return llvm::CodeGenOpt::Less;
+      case opt_default:
+        return llvm::CodeGenOpt::Default;
+      case opt_aggressive:
+        return llvm::CodeGenOpt::Aggressive;
+    }
+    throw std::logic_error("not a valid optimization level");
+}
+
+//Only the features the host reports as present are enabled.
+static std::string getHostFeatures() {
+    llvm::StringMap<bool> host;
+    llvm::SubtargetFeatures features;
+    if (llvm::sys::getHostCPUFeatures(host)) {
+        for (const llvm::StringMapEntry<bool>& f : host) {
+            features.AddFeature(f.getKey(), f.getValue());
+        }
+    }
+    return features.getString();
+}
+
+std::unique_ptr<llvm::TargetMachine> makeTargetMachine(const std::string& cpu, opt_level level) {
+    static std::once_flag init;
+    std::call_once(init, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    std::string triple = llvm::sys::getProcessTriple();
+    std::string err;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, err);
+    if (!target) {
+        throw std::runtime_error("no target for " + triple + ": " + err);
+    }
+
+    std::string name = cpu;
+    std::string features;
+    if (cpu == "native") {
+        name = llvm::sys::getHostCPUName().str();
+        features = getHostFeatures();
+    }
+
+    //Position-independent, so objects link into PIE executables.
+    llvm::TargetOptions options;
+    llvm::TargetMachine* tm = target->createTargetMachine(triple, name, features, options, llvm::Reloc::PIC_, llvm::None, getCodeGenLevel(level));
+    if (!tm) {
+        throw std::runtime_error("cannot generate code for " + triple + " (" + name + ")");
+    }
+    return std::unique_ptr<llvm::TargetMachine>(tm);
+}
+
+void setTarget(llvm::Module& mod, const llvm::TargetMachine& tm) {
+    mod.setTargetTriple(tm.getTargetTriple().str());
+    mod.setDataLayout(tm.createDataLayout());
+}
+
+void emit(llvm::Module& mod, llvm::TargetMachine& tm, emit_kind kind, llvm::raw_fd_ostream& os) {
+    switch (kind) {
+      case emit_llvm:
+        mod.print(os, nullptr);
+        return;
+      case emit_bitcode:
+        llvm::WriteBitcodeToFile(mod, os);
+        return;
+      case emit_assembly:
+      case emit_object:
+        break;
+    }
+
+    //The object writer patches headers after the fact, so a pipe is
+    //written through a buffer.
+    std::unique_ptr<llvm::buffer_ostream> buf;
+    llvm::raw_pwrite_stream* out = &os;
+    if (!os.supportsSeeking()) {
+        buf = std::make_unique<llvm::buffer_ostream>(os);
+        out = buf.get();
+    }
+
+    llvm::CodeGenFileType type = kind == emit_object ? llvm::CGFT_ObjectFile : llvm::CGFT_AssemblyFile;
+    llvm::legacy::PassManager pm;
+    if (tm.addPassesToEmitFile(pm, *out, nullptr, type)) {
+        throw std::runtime_error("the target cannot emit this kind of file");
+    }
+    pm.run(mod);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "codegen.hpp"
+
+#include <memory>
+#include <string>
+
+namespace llvm {
+  class Module;
+  class TargetMachine;
+  class raw_fd_ostream;
+}
+
+// What the driver writes out.
+enum emit_kind {
+  emit_llvm,     //Textual IR
+  emit_bitcode,
+  emit_assembly,
+  emit_object,
+};
+
+// A target machine for the host. When 'cpu' is "native" the host is asked
+// for its CPU and the features it supports, so the optimizer and code
+// generator can use every vector extension it has.
+std::unique_ptr<llvm::TargetMachine> makeTargetMachine(const std::string& cpu, opt_level level);
+
+// Gives 'mod' the triple and data layout of 'tm'. The optimizer needs
+// them to see the target.
+void setTarget(llvm::Module& mod, const llvm::TargetMachine& tm);
+
+// Writes 'mod' to 'os' as it is produced, with no textual IR in between
+// unless that is what was asked for.
+void emit(llvm::Module& mod, llvm::TargetMachine& tm, emit_kind kind, llvm::raw_fd_ostream& os);
@@ -0,0 +1,170 @@
+#include "tier.hpp"
+#include "decl.hpp"
+#include "target.hpp"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+template<typename T>
+static T check(llvm::Expected<T> x) {
+    if (!x) {
+        throw std::runtime_error("jit: " + llvm::toString(x.takeError()));
+    }
+    return std::move(*x);
+}
+
+static void check(llvm::Error err) {
+    if (err) {
+        throw std::runtime_error("jit: " + llvm::toString(std::move(err)));
+    }
+}
+
+static double getMilliseconds(std::chrono::steady_clock::time_point since) {
+    std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - since;
+    return ms.count();
+}
+
+tiered_engine::tiered_engine(const decl* prog, const tier_options& opts)
+    : m_prog(prog), m_opts(opts), m_bc(prog), m_vm(m_bc), m_start(std::chrono::steady_clock::now()), m_stop(false) {
+    m_vm.setHotHandler(opts.threshold, [this](std::uint32_t fn) {
+        onHot(fn);
+    });
+}
+
+tiered_engine::~tiered_engine() {
+    stop();
+}
+
+int tiered_engine::runMain() {
+    return m_vm.runMain();
+}
+
+std::vector<tier_event> tiered_engine::getEvents() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_events;
+}
+
+//Where native code calls other functions. Whichever tier the callee is in
+//now is the one that runs.
+void tiered_engine::callFunction(void* engine, std::uint32_t fn, bc_value* frame) {
+    interpreter& vm = static_cast<tiered_engine*>(engine)->m_vm;
+    if (native_fn code = vm.getNative(fn)) {
+        code(frame);
+    } else {
+        vm.call(fn, frame);
+    }
+}
+
+//The compiler thread is only started once something is hot, so short
+//runs never pay for it.
+void tiered_engine::onHot(std::uint32_t fn) {
+    tier_event e{fn, m_vm.getProfile(fn), getMilliseconds(m_start), 0, {}};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(e);
+    }
+    m_cv.notify_one();
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&tiered_engine::work, this);
+    }
+}
+
+void tiered_engine::work() {
+    for (;;) {
+        tier_event e;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] {
+                return m_stop || !m_queue.empty();
+            });
+            if (m_stop) {
+                return;
+            }
+            e = m_queue.front();
+            m_queue.pop_front();
+        }
+        compile(e);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_events.push_back(e);
+    }
+}
+
+//A function that cannot be compiled stays interpreted; the error is kept
+//with its event.
+void tiered_engine::compile(tier_event& e) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        if (!m_jit) {
+            static std::once_flag init;
+            std::call_once(init, [] {
+                llvm::InitializeNativeTarget();
+                llvm::InitializeNativeTargetAsmPrinter();
+            });
+            m_jit = check(llvm::orc::LLJITBuilder().create());
+
+            //Float % lowers to a call to fmodf, found in this process.
+            char prefix = m_jit->getDataLayout().getGlobalPrefix();
+            m_jit->getMainJITDylib().addGenerator(check(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(prefix)));
+        }
+
+        auto cxt = std::make_unique<llvm::LLVMContext>();
+        tier_link link{&m_bc, m_vm.getGlobals(), this, &callFunction};
+        std::unique_ptr<llvm::Module> mod = generateTiered(*cxt, m_prog, m_bc.getFunction(e.fn).decl, link);
+        std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine("native", m_opts.level);
+        setTarget(*mod, *tm);
+        optimize(*mod, m_opts.level, tm.get());
+        check(m_jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(mod), std::move(cxt))));
+
+        llvm::JITEvaluatedSymbol sym = check(m_jit->lookup(getTierEntryName(e.fn)));
+        m_vm.setNative(e.fn, reinterpret_cast<native_fn>(static_cast<std::uintptr_t>(sym.getAddress())));
+    } catch (const std::exception& x) {
+        e.error = x.what();
+    }
+    e.compile_ms = getMilliseconds(start);
+}
+
+void tiered_engine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_cv.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void tiered_engine::printStats(std::ostream& os) const {
+    os << std::left << std::setw(24) << "function" << std::right << std::setw(12) << "calls" << std::setw(12) << "loops"
+       << "  tier\n";
+    for (std::uint32_t fn = 0; fn != m_bc.getFunctions().size(); ++fn) {
+        const bc_profile& p = m_vm.getProfile(fn);
+        if (p.calls == 0) {
+            continue;
+        }
+        os << std::left << std::setw(24) << m_bc.getFunction(fn).name->str() << std::right << std::setw(12) << p.calls
+           << std::setw(12) << p.loops << "  " << (m_vm.getNative(fn) ? "native" : "interp") << '\n';
+    }
+
+    os << std::fixed << std::setprecision(2);
+    for (const tier_event& e : getEvents()) {
+        os << "tier-up " << m_bc.getFunction(e.fn).name->str() << " at " << e.queued_ms << " ms ("
+           << e.profile.calls << " calls, " << e.profile.loops << " loops): ";
+        if (e.error.empty()) {
+            os << "compiled in " << e.compile_ms << " ms\n";
+        } else {
+            os << "failed: " << e.error << '\n';
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "codegen.hpp"
+#include "interp.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+  namespace orc {
+    class LLJIT;
+  }
+}
+
+struct tier_options {
+  // Calls plus loop iterations in the interpreter before a function is
+  // compiled.
+  std::uint32_t threshold = 1000;
+
+  opt_level level = opt_default;
+};
+
+// A function that crossed the threshold, and what became of it.
+struct tier_event {
+  std::uint32_t fn;
+  bc_profile profile;   //When it was queued
+  double queued_ms;     //Since the engine started
+  double compile_ms;    //Lowering, optimizing and code generation
+  std::string error;    //Why it stayed interpreted, if it did
+};
+
+// Runs a program in the interpreter and compiles the functions that turn
+// out to be hot to native code on a background thread, so a run starts as
+// fast as the interpreter and the hot code ends up as fast as the JIT.
+// A function that is running when its native code arrives finishes in
+// the interpreter; its next call is native.
+//
+// Native code divides by zero the way compiled programs do, by trapping.
+class tiered_engine {
+  public:
+    explicit tiered_engine(const decl* prog, const tier_options& opts = {});
+
+    // Waits for the function being compiled, if any, and drops the rest.
+    ~tiered_engine();
+
+    // Calls 'def main() -> int' and returns what it returns.
+    int runMain();
+
+    const bc_program& getProgram() const {
+      return m_bc;
+    }
+
+    const interpreter& getInterpreter() const {
+      return m_vm;
+    }
+
+    std::vector<tier_event> getEvents() const;
+
+    // A table of every function that ran, with its counts and tier, then
+    // every tier-up.
+    void printStats(std::ostream& os) const;
+
+  private:
+    static void callFunction(void* engine, std::uint32_t fn, bc_value* frame);
+
+    void onHot(std::uint32_t fn);
+    void work();
+    void compile(tier_event& e);
+    void stop();
+
+    const decl* m_prog;
+    tier_options m_opts;
+    bc_program m_bc;
+    interpreter m_vm;
+    std::chrono::steady_clock::time_point m_start;
+
+    //Created by the compiler thread when it is first needed.
+    std::unique_ptr<llvm::orc::LLJIT> m_jit;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<tier_event> m_queue;
+    std::vector<tier_event> m_events;
+    bool m_stop;
+    std::thread m_thread;
+};
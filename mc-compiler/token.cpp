@@ -260,7 +260,7 @@ static std::string escape(char c) {
   }
 }
 
-static std::string escape (const std::string& s) {
+static std::string escape (std::string_view s) {
   std::string result;
   for (char c : s) {
     result += escape(c);
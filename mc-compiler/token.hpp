@@ -200,7 +200,7 @@ class token {
     radix getRadix() const;
     bool getBoolean() const;
     char getChar() const;
-    const std::string& getString() const;
+    std::string_view getString() const;
     type_spec getTypeSpecifier() const;
 
   private:
@@ -267,9 +267,9 @@ inline char token::getChar() const {
     return m_attr.charval;
 }
 
-inline const std::string& token::getString() const {
+inline std::string_view token::getString() const {
     assert(m_name == tok_string);
-    return *m_attr.strval.sym;
+    return m_attr.strval.sym->str();
 }
 
 inline type_spec token::getTypeSpecifier() const {
@@ -1,19 +1,15 @@
 #include "type.hpp"
+#include "ast.hpp"
 
+#include <functional>
 #include <iostream>
 
-bool type::isReferenceTo(const type* t) {
-  if (const ref_type* rt = dynamic_cast<const ref_type*>(this)) {
-    return isSameAs(rt->getObjectType(), t);
-  }
-  return false;
+bool type::isReferenceTo(const type* t) const {
+  return isReference() && static_cast<const ref_type*>(this)->getObjectType() == t;
 }
 
-bool type::isPointerTo(const type* t) {
-  if (const ptr_type* rt = dynamic_cast<const ptr_type*>(this)) {
-    return isSameAs(rt->getElementType(), t);
-  }
-  return false;
+bool type::isPointerTo(const type* t) const {
+  return isPointer() && static_cast<const ptr_type*>(this)->getElementType() == t;
 }
 
 bool type::isArithmetic() const {
@@ -33,49 +29,45 @@ bool type::isNumeric() const {
 }
 
 type* type::getObjectType() const {
-  if (const ref_type* rt = dynamic_cast<const ref_type*>(this)) {
-    return rt->getObjectType();
+  if (isReference()) {
+    return static_cast<const ref_type*>(this)->getObjectType();
   }
   return const_cast<type*>(this);
 }
 
-static bool isSameAsPtr(const ptr_type* t1, const ptr_type* t2) {
-  return isSameAs(t1->getElementType(), t2->getElementType());
-}
+type_context::type_context(ast_context& ast) : m_ast(ast), m_bool(ast.make<bool_type>()), m_char(ast.make<char_type>()), m_int(ast.make<int_type>()), m_float(ast.make<float_type>()) {}
 
-static bool isSameAsRef(const ref_type* t1, const ref_type* t2) {
-  return isSameAs(t1->getObjectType(), t2->getObjectType());
+type* type_context::getPointerType(type* t) {
+  if (!t->m_ptr) {
+    t->m_ptr = m_ast.make<ptr_type>(t);
+  }
+  return t->m_ptr;
 }
 
-static bool isSameAsFn(const fn_type* t1, const fn_type* t2) {
-  auto cmp = [](const type* a, const type* b) {
-    return isSameAs(a, b);
-  };
-  const type_list& p1 = t1->getParameterTypes();
-  const type_list& p2 = t2->getParameterTypes();
-  return std::equal(p1.begin(), p1.end(), p2.begin(), p2.end(), cmp);
+type* type_context::getReferenceType(type* t) {
+  if (!t->m_ref) {
+    t->m_ref = m_ast.make<ref_type>(t);
+  }
+  return t->m_ref;
 }
 
-bool isSameAs(const type* t1, const type* t2) {
-  if (t1 == t2) {
-    return true;
-  }
+fn_type* type_context::getFunctionType(const type_list& parms, type* ret) {
+  type_list key;
+  key.reserve(parms.size() + 1);
+  key.push_back(ret);
+  key.insert(key.end(), parms.begin(), parms.end());
 
-  if (t1->getKind() != t2->getKind()) {
-    return false;
+  fn_type*& fn = m_fns[key];
+  if (!fn) {
+    fn = m_ast.make<fn_type>(parms, ret);
   }
+  return fn;
+}
 
-  switch (t1->getKind()) {
-    case type::bool_kind:
-    case type::char_kind:
-    case type::int_kind:
-    case type::float_kind:
-      return true;
-    case type::ptr_kind:
-      return isSameAsPtr(static_cast<const ptr_type*>(t1), static_cast<const ptr_type*>(t2));
-    case type::ref_kind:
-      return isSameAsRef(static_cast<const ref_type*>(t1), static_cast<const ref_type*>(t2));
-    case type::fn_kind:
-      return isSameAsFn(static_cast<const fn_type*>(t1), static_cast<const fn_type*>(t2));
+std::size_t type_context::key_hash::operator()(const type_list& key) const {
+  std::size_t h = key.size();
+  for (const type* t : key) {
+    h = h * 31 + std::hash<const type*>()(t);
   }
+  return h;
 }
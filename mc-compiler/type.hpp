@@ -1,6 +1,12 @@
 #pragma once
 
-#include <vector>
+#include "small_vector.hpp"
+
+#include <cstddef>
+#include <unordered_map>
+
+class ast_context;
+class type_context;
 
 class type {
     public:
@@ -15,11 +21,9 @@ class type {
       };
 
     protected:
-      type(kind k) : m_kind(k) {}
+      type(kind k) : m_kind(k), m_ptr(), m_ref() {}
 
     public:
-      virtual ~type() = default;
-
       kind getKind() const {
         return m_kind;
       }
@@ -40,13 +44,13 @@ class type {
         return m_kind == ref_kind;
       }
 
-      bool isReferenceTo(const type* t);
+      bool isReferenceTo(const type* t) const;
 
       bool isPointer() const {
         return m_kind == ptr_kind;
           }
 
-      bool isPointerTo(const type* t);
+      bool isPointerTo(const type* t) const;
 
       bool isFunction() const {
         return m_kind == fn_kind;
@@ -67,10 +71,16 @@ class type {
       type* getObjectType() const;
 
     private:
+      friend class type_context;
+
       kind m_kind;
+
+      //The pointer and reference types to this one, once they exist.
+      type* m_ptr;
+      type* m_ref;
 };
 
-using type_list = std::vector<type*>;
+using type_list = small_vector<type*, 4>;
 
 
 struct bool_type : type {
@@ -127,4 +137,54 @@ struct fn_type : type {
   type* m_ret;
 };
 
-bool isSameAs(const type* t1, const type* t2);
+//Types are canonical, so structurally equal types are the same object.
+inline bool isSameAs(const type* t1, const type* t2) {
+  return t1 == t2;
+}
+
+// Creates the types of one compilation and keeps them unique: asking for
+// a pointer, reference or function type with the same components twice
+// yields the same node. The nodes live in the compilation's ast_context.
+class type_context {
+  public:
+    explicit type_context(ast_context& ast);
+
+    type_context(const type_context&) = delete;
+    type_context& operator=(const type_context&) = delete;
+
+    type* getBoolType() const {
+      return m_bool;
+    }
+
+    type* getCharType() const {
+      return m_char;
+    }
+
+    type* getIntType() const {
+      return m_int;
+    }
+
+    type* getFloatType() const {
+      return m_float;
+    }
+
+    type* getPointerType(type* t);
+    type* getReferenceType(type* t);
+    fn_type* getFunctionType(const type_list& parms, type* ret);
+
+  private:
+    //Function types are keyed by their return type followed by their
+    //parameter types.
+    struct key_hash {
+      std::size_t operator()(const type_list& key) const;
+    };
+
+    ast_context& m_ast;
+
+    type* m_bool;
+    type* m_char;
+    type* m_int;
+    type* m_float;
+
+    std::unordered_map<type_list, fn_type*, key_hash> m_fns;
+};
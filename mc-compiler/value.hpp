@@ -0,0 +1,46 @@
+#pragma once
+
+#include "type.hpp"
+
+#include <cstdint>
+
+// A scalar MC value computed at compile time.
+struct const_value {
+  const_value() : kind(type::int_kind), i(0) {}
+
+  static const_value makeBool(bool b) {
+    const_value v;
+    v.kind = type::bool_kind;
+    v.b = b;
+    return v;
+  }
+
+  static const_value makeChar(char c) {
+    const_value v;
+    v.kind = type::char_kind;
+    v.c = c;
+    return v;
+  }
+
+  static const_value makeInt(std::int32_t i) {
+    const_value v;
+    v.kind = type::int_kind;
+    v.i = i;
+    return v;
+  }
+
+  static const_value makeFloat(float f) {
+    const_value v;
+    v.kind = type::float_kind;
+    v.f = f;
+    return v;
+  }
+
+  type::kind kind;
+  union {
+    bool b;
+    char c;
+    std::int32_t i;
+    float f;
+  };
+};
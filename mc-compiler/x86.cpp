@@ -0,0 +1,313 @@
+#include "x86.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//ELF fields are written little-endian whatever the host is.
+namespace {
+  struct elf_buffer {
+    void put8(std::uint8_t v) {
+      bytes.push_back(v);
+    }
+
+    void put16(std::uint16_t v) {
+      put8(v);
+      put8(v >> 8);
+    }
+
+    void put32(std::uint32_t v) {
+      put16(v);
+      put16(v >> 16);
+    }
+
+    void put64(std::uint64_t v) {
+      put32(v);
+      put32(v >> 32);
+    }
+
+    void put(const std::vector<std::uint8_t>& v) {
+      bytes.insert(bytes.end(), v.begin(), v.end());
+    }
+
+    void align(std::size_t n) {
+      while (bytes.size() % n) {
+        put8(0);
+      }
+    }
+
+    std::vector<std::uint8_t> bytes;
+  };
+
+  struct elf_section {
+    std::uint32_t name;
+    std::uint32_t type;
+    std::uint64_t flags;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t link;
+    std::uint32_t info;
+    std::uint64_t align;
+    std::uint64_t entsize;
+  };
+
+  //Names are added once and referred to by offset.
+  struct elf_strings {
+    elf_strings() : bytes(1, 0) {}
+
+    std::uint32_t add(const std::string& s) {
+      std::uint32_t n = bytes.size();
+      bytes.insert(bytes.end(), s.begin(), s.end());
+      bytes.push_back(0);
+      return n;
+    }
+
+    std::vector<std::uint8_t> bytes;
+  };
+}
+
+enum {
+  sht_progbits = 1,
+  sht_symtab = 2,
+  sht_strtab = 3,
+  sht_rela = 4,
+
+  shf_write = 1,
+  shf_alloc = 2,
+  shf_execinstr = 4,
+  shf_info_link = 0x40,
+
+  stb_global = 1,
+  stt_notype = 0,
+  stt_object = 1,
+  stt_func = 2,
+
+  r_x86_64_pc32 = 2,
+  r_x86_64_plt32 = 4,
+};
+
+//Sections in the order of their headers.
+enum {
+  sec_null,
+  sec_text,
+  sec_data,
+  sec_rela,
+  sec_symtab,
+  sec_strtab,
+  sec_note,
+  sec_shstrtab,
+  sec_count,
+};
+
+void writeElf(const x86_object& obj, std::ostream& os) {
+  elf_strings shstr;
+  elf_strings str;
+  elf_section secs[sec_count] = {};
+
+  secs[sec_text] = {shstr.add(".text"), sht_progbits, shf_alloc | shf_execinstr, 0, obj.code.size(), 0, 0, 16, 0};
+  secs[sec_data] = {shstr.add(".data"), sht_progbits, shf_alloc | shf_write, 0, obj.data.size(), 0, 0, obj.data_align, 0};
+  secs[sec_rela] = {shstr.add(".rela.text"), sht_rela, shf_info_link, 0, 0, sec_symtab, sec_text, 8, 24};
+  secs[sec_symtab] = {shstr.add(".symtab"), sht_symtab, 0, 0, 0, sec_strtab, 1, 8, 24};
+  secs[sec_strtab] = {shstr.add(".strtab"), sht_strtab, 0, 0, 0, 0, 0, 1, 0};
+  //Without it the linker assumes the stack has to be executable.
+  secs[sec_note] = {shstr.add(".note.GNU-stack"), sht_progbits, 0, 0, 0, 0, 0, 1, 0};
+  secs[sec_shstrtab] = {shstr.add(".shstrtab"), sht_strtab, 0, 0, 0, 0, 0, 1, 0};
+
+  //Every symbol is global, so the local part is just the null symbol.
+  elf_buffer symtab;
+  symtab.bytes.resize(24);
+  for (const x86_symbol& s : obj.symbols) {
+    std::uint8_t type = s.sec == x86_symbol::undefined ? stt_notype : s.function ? stt_func : stt_object;
+    std::uint16_t shndx = s.sec == x86_symbol::text ? sec_text : s.sec == x86_symbol::data ? sec_data : 0;
+    symtab.put32(str.add(s.name));
+    symtab.put8(stb_global << 4 | type);
+    symtab.put8(0);
+    symtab.put16(shndx);
+    symtab.put64(s.offset);
+    symtab.put64(s.size);
+  }
+
+  //The field is relative to its end, four bytes on.
+  elf_buffer rela;
+  for (const x86_reloc& r : obj.relocs) {
+    rela.put64(r.offset);
+    rela.put64(std::uint64_t(r.symbol + 1) << 32 | (r.call ? r_x86_64_plt32 : r_x86_64_pc32));
+    rela.put64(static_cast<std::uint64_t>(-4));
+  }
+
+  elf_buffer out;
+  out.bytes.resize(64);
+
+  out.align(16);
+  secs[sec_text].offset = out.bytes.size();
+  out.put(obj.code);
+
+  out.align(obj.data_align);
+  secs[sec_data].offset = out.bytes.size();
+  out.put(obj.data);
+
+  out.align(8);
+  secs[sec_rela].offset = out.bytes.size();
+  secs[sec_rela].size = rela.bytes.size();
+  out.put(rela.bytes);
+
+  secs[sec_symtab].offset = out.bytes.size();
+  secs[sec_symtab].size = symtab.bytes.size();
+  out.put(symtab.bytes);
+
+  secs[sec_strtab].offset = out.bytes.size();
+  secs[sec_strtab].size = str.bytes.size();
+  out.put(str.bytes);
+
+  secs[sec_note].offset = out.bytes.size();
+
+  secs[sec_shstrtab].offset = out.bytes.size();
+  secs[sec_shstrtab].size = shstr.bytes.size();
+  out.put(shstr.bytes);
+
+  out.align(8);
+  std::uint64_t shoff = out.bytes.size();
+  for (const elf_section& s : secs) {
+    out.put32(s.name);
+    out.put32(s.type);
+    out.put64(s.flags);
+    out.put64(0);
+    out.put64(s.offset);
+    out.put64(s.size);
+    out.put32(s.link);
+    out.put32(s.info);
+    out.put64(s.align);
+    out.put64(s.entsize);
+  }
+
+  elf_buffer header;
+  const std::uint8_t ident[16] = {0x7f, 'E', 'L', 'F', 2, 1, 1};
+  header.bytes.assign(ident, ident + 16);
+  header.put16(1);          //Relocatable
+  header.put16(62);         //x86-64
+  header.put32(1);
+  header.put64(0);
+  header.put64(0);
+  header.put64(shoff);
+  header.put32(0);
+  header.put16(64);
+  header.put16(0);
+  header.put16(0);
+  header.put16(64);
+  header.put16(sec_count);
+  header.put16(sec_shstrtab);
+  std::copy(header.bytes.begin(), header.bytes.end(), out.bytes.begin());
+
+  os.write(reinterpret_cast<const char*>(out.bytes.data()), out.bytes.size());
+}
+
+
+static std::size_t roundUp(std::size_t n, std::size_t to) {
+  return (n + to - 1) / to * to;
+}
+
+//Calls to the process's own functions may be too far for a 32-bit
+//displacement, so each goes through a stub after the code that jumps to
+//its absolute address.
+static constexpr std::size_t stub_size = 16;
+
+x86_image::x86_image(const x86_object& obj) : m_base(nullptr), m_size(0) {
+#ifndef __x86_64__
+  throw std::runtime_error("x86-64 code cannot run on this host");
+#endif
+
+  std::vector<void*> addrs(obj.symbols.size());
+  std::vector<std::size_t> stubs(obj.symbols.size(), 0);
+  std::size_t nstubs = 0;
+  for (std::size_t i = 0; i != obj.symbols.size(); ++i) {
+    const x86_symbol& s = obj.symbols[i];
+    if (s.sec == x86_symbol::undefined) {
+      addrs[i] = ::dlsym(RTLD_DEFAULT, s.name.c_str());
+      if (!addrs[i]) {
+        throw std::runtime_error("undefined symbol '" + s.name + "'");
+      }
+      stubs[i] = obj.code.size() + nstubs++ * stub_size;
+    }
+  }
+
+  std::size_t page = ::sysconf(_SC_PAGESIZE);
+  std::size_t text_size = roundUp(obj.code.size() + nstubs * stub_size, page);
+  m_size = text_size + roundUp(obj.data.size() ? obj.data.size() : 1, page);
+  void* base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    throw std::runtime_error(std::string("cannot map code: ") + std::strerror(errno));
+  }
+  m_base = base;
+  try {
+    link(obj, addrs, stubs, text_size);
+  } catch (...) {
+    ::munmap(m_base, m_size);
+    throw;
+  }
+}
+
+void x86_image::link(const x86_object& obj, std::vector<void*>& addrs, const std::vector<std::size_t>& stubs, std::size_t text_size) {
+  std::uint8_t* text = static_cast<std::uint8_t*>(m_base);
+  std::uint8_t* data = text + text_size;
+  std::copy(obj.code.begin(), obj.code.end(), text);
+  std::copy(obj.data.begin(), obj.data.end(), data);
+
+  for (std::size_t i = 0; i != obj.symbols.size(); ++i) {
+    const x86_symbol& s = obj.symbols[i];
+    switch (s.sec) {
+      case x86_symbol::text:
+        addrs[i] = text + s.offset;
+        m_symbols.emplace(s.name, addrs[i]);
+        break;
+      case x86_symbol::data:
+        addrs[i] = data + s.offset;
+        m_symbols.emplace(s.name, addrs[i]);
+        break;
+      case x86_symbol::undefined: {
+        //movabs r11, addr; jmp r11
+        std::uint8_t* stub = text + stubs[i];
+        std::uint64_t a = reinterpret_cast<std::uintptr_t>(addrs[i]);
+        stub[0] = 0x49;
+        stub[1] = 0xbb;
+        std::memcpy(stub + 2, &a, 8);
+        stub[10] = 0x41;
+        stub[11] = 0xff;
+        stub[12] = 0xe3;
+        addrs[i] = stub;
+        break;
+      }
+    }
+  }
+
+  for (const x86_reloc& r : obj.relocs) {
+    std::uint8_t* field = text + r.offset;
+    std::int64_t d = static_cast<std::uint8_t*>(addrs[r.symbol]) - (field + 4);
+    if (d < std::numeric_limits<std::int32_t>::min() || d > std::numeric_limits<std::int32_t>::max()) {
+      throw std::runtime_error("'" + obj.symbols[r.symbol].name + "' is too far away to refer to");
+    }
+    std::int32_t d32 = static_cast<std::int32_t>(d);
+    std::memcpy(field, &d32, 4);
+  }
+
+  if (::mprotect(m_base, text_size, PROT_READ | PROT_EXEC) != 0) {
+    throw std::runtime_error(std::string("cannot protect code: ") + std::strerror(errno));
+  }
+}
+
+x86_image::~x86_image() {
+  if (m_base) {
+    ::munmap(m_base, m_size);
+  }
+}
+
+void* x86_image::getSymbol(const std::string& name) const {
+  auto iter = m_symbols.find(name);
+  return iter == m_symbols.end() ? nullptr : iter->second;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A symbol of an x86_object: a function in the code, a variable in the
+// data, or something defined elsewhere.
+struct x86_symbol {
+  enum section {
+    undefined,
+    text,
+    data,
+  };
+
+  std::string name;
+  section sec;
+  bool function;
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+// A 32-bit field of the code that holds the distance from the end of the
+// field to a symbol.
+struct x86_reloc {
+  std::uint64_t offset;
+  std::uint32_t symbol;
+  bool call; //Through the PLT when the symbol is in a shared library
+};
+
+// Position-independent x86-64 machine code and data, with what is left to
+// link.
+struct x86_object {
+  std::vector<std::uint8_t> code;
+  std::vector<std::uint8_t> data;
+  std::uint32_t data_align = 1;
+  std::vector<x86_symbol> symbols;
+  std::vector<x86_reloc> relocs;
+};
+
+// Writes 'obj' as an ELF relocatable object for x86-64 Linux.
+void writeElf(const x86_object& obj, std::ostream& os);
+
+// An x86_object loaded into memory to be run by this process. Undefined
+// symbols are looked up in the process, so the C library is available.
+class x86_image {
+  public:
+    explicit x86_image(const x86_object& obj);
+    ~x86_image();
+
+    x86_image(const x86_image&) = delete;
+    x86_image& operator=(const x86_image&) = delete;
+
+    // The address of the symbol named 'name', or null.
+    void* getSymbol(const std::string& name) const;
+
+  private:
+    void link(const x86_object& obj, std::vector<void*>& addrs, const std::vector<std::size_t>& stubs, std::size_t text_size);
+
+    void* m_base;
+    std::size_t m_size;
+    std::unordered_map<std::string, void*> m_symbols;
+};
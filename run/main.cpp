@@ -1,13 +1,268 @@
+#include "mc-compiler/ast.hpp"
+#include "mc-compiler/baseline.hpp"
+#include "mc-compiler/bytecode.hpp"
+#include "mc-compiler/c99.hpp"
 #include "mc-compiler/file.hpp"
+#include "mc-compiler/interp.hpp"
+#include "mc-compiler/ir.hpp"
 #include "mc-compiler/lexer.hpp"
 #include "mc-compiler/parser.hpp"
 
+#ifdef MC_HAVE_CODEGEN
+#include "mc-compiler/codegen.hpp"
+#include "mc-compiler/jit.hpp"
+#include "mc-compiler/target.hpp"
+#include "mc-compiler/tier.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+
+static int usage() {
+  std::cerr << "usage: mc-compiler [--no-fold] [-O0|-O1|-O2|-O3] [-j <threads>] [-mcpu=<cpu>]\n"
+            << "                   [--emit=llvm|bc|asm|obj|bytecode|c|ir] [-o <file>] [--run] [--interp]\n"
+            << "                   [--baseline] [--ssa] [--tiered [--tier-threshold=<n>] [--tier-stats]] <file>\n";
+  return 1;
+}
+
+//The input's path without its extension.
+static std::string getStem(const char* input) {
+  std::string base = input;
+  std::size_t slash = base.rfind('/');
+  std::size_t dot = base.rfind('.');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+    base.erase(dot);
+  }
+  return base;
+}
+
+#ifdef MC_HAVE_CODEGEN
+static bool getEmitKind(const char* name, emit_kind& kind) {
+  static const struct {
+    const char* name;
+    emit_kind kind;
+  } kinds[] = {
+    {"llvm", emit_llvm},
+    {"bc", emit_bitcode},
+    {"asm", emit_assembly},
+    {"obj", emit_object},
+  };
+  for (const auto& k : kinds) {
+    if (std::strcmp(name, k.name) == 0) {
+      kind = k.kind;
+      return true;
+    }
+  }
+  return false;
+}
+
+//Text goes to stdout by default; binary output goes next to the input.
+static std::string getOutputPath(const char* input, emit_kind kind) {
+  if (kind == emit_llvm || kind == emit_assembly) {
+    return "-";
+  }
+  return getStem(input) + (kind == emit_bitcode ? ".bc" : ".o");
+}
+#endif
 
 int main(int argc, char* argv[]) {
-  file input(argv[1]);
-  symbol_table syms;
+  const char* path = nullptr;
+  const char* output = nullptr;
+  const char* emit_name = "llvm";
+  std::string cpu = "native";
+  bool fold = true;
+  int level = 0;
+  unsigned jobs = 1;
+  bool run = false;
+  bool interp = false;
+  bool baseline = false;
+  bool ssa = false;
+  bool tiered = false;
+  bool tier_stats = false;
+  unsigned long threshold = 0;
+  for (int i = 1; i != argc; ++i) {
+    if (std::strcmp(argv[i], "--no-fold") == 0) {
+      fold = false;
+    } else if (std::strcmp(argv[i], "--run") == 0) {
+      run = true;
+    } else if (std::strcmp(argv[i], "--interp") == 0) {
+      interp = true;
+    } else if (std::strcmp(argv[i], "--baseline") == 0) {
+      baseline = true;
+    } else if (std::strcmp(argv[i], "--ssa") == 0) {
+      ssa = true;
+    } else if (std::strcmp(argv[i], "--tiered") == 0) {
+      tiered = true;
+    } else if (std::strcmp(argv[i], "--tier-stats") == 0) {
+      tier_stats = true;
+    } else if (std::strncmp(argv[i], "--tier-threshold=", 17) == 0) {
+      threshold = std::strtoul(argv[i] + 17, nullptr, 10);
+      if (threshold == 0) {
+        return usage();
+      }
+    } else if (argv[i][0] == '-' && argv[i][1] == 'O' && '0' <= argv[i][2] && argv[i][2] <= '3' && !argv[i][3]) {
+      level = argv[i][2] - '0';
+    } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 != argc) {
+      jobs = std::strtoul(argv[++i], nullptr, 10);
+      if (jobs == 0) {
+        return usage();
+      }
+    } else if (std::strncmp(argv[i], "-mcpu=", 6) == 0) {
+      cpu = argv[i] + 6;
+    } else if (std::strncmp(argv[i], "--emit=", 7) == 0) {
+      emit_name = argv[i] + 7;
+    } else if (std::strcmp(argv[i], "-o") == 0 && i + 1 != argc) {
+      output = argv[++i];
+    } else if (argv[i][0] == '-' || path) {
+      return usage();
+    } else {
+      path = argv[i];
+    }
+  }
+  if (!path) {
+    return usage();
+  }
+
+  bool bytecode = std::strcmp(emit_name, "bytecode") == 0;
+  bool c_source = std::strcmp(emit_name, "c") == 0;
+  bool ssa_ir = std::strcmp(emit_name, "ir") == 0;
+#ifdef MC_HAVE_CODEGEN
+  emit_kind kind = emit_llvm;
+  if (!bytecode && !c_source && !ssa_ir && !getEmitKind(emit_name, kind)) {
+    return usage();
+  }
+#endif
+
+  try {
+    file input(path);
+    symbol_table syms;
+    ast_context ast;
+
+    parser p(syms, ast, input);
+    p.getSemantics().setFolding(fold);
+    decl* prog = p.parseProgram();
+
+    //Interpreting needs no code generator at all.
+    if (interp || bytecode) {
+      bc_program bc(prog);
+      if (!interp) {
+        bc.print(std::cout);
+        return 0;
+      }
+      interpreter vm(bc);
+      return vm.runMain();
+    }
+
+    //Nor does translating to C, which goes to stdout like other text.
+    if (c_source && !run && !baseline) {
+      if (!output) {
+        generateC(prog, std::cout);
+        return 0;
+      }
+      std::ofstream os(output);
+      if (!os) {
+        throw std::runtime_error(std::string("cannot open ") + output);
+      }
+      generateC(prog, os);
+      return 0;
+    }
+
+    //Nor does printing the SSA IR, which is checked first.
+    if (ssa_ir && !run && !baseline) {
+      ir_program ir(prog);
+      ir.verify();
+      ir.print(std::cout);
+      return 0;
+    }
+
+    //Neither does the baseline compiler, which only writes objects.
+    if (baseline) {
+      if (run) {
+        return runBaseline(prog);
+      }
+      std::string out = output ? output : getStem(path) + ".o";
+      std::ofstream os(out, std::ios::binary);
+      if (!os) {
+        throw std::runtime_error("cannot open " + out);
+      }
+      writeElf(generateBaseline(prog), os);
+      return 0;
+    }
+
+#ifdef MC_HAVE_CODEGEN
+    opt_level opt = static_cast<opt_level>(level);
+    if (tiered) {
+      tier_options opts;
+      opts.level = opt;
+      if (threshold) {
+        opts.threshold = threshold;
+      }
+      tiered_engine engine(prog, opts);
+      int result = engine.runMain();
+      if (tier_stats) {
+        engine.printStats(std::cerr);
+      }
+      return result;
+    }
+
+    std::unique_ptr<llvm::TargetMachine> tm = makeTargetMachine(cpu, opt);
+    auto cxt = std::make_unique<llvm::LLVMContext>();
+    std::unique_ptr<llvm::Module> mod;
+    if (ssa) {
+      ir_program ir(prog);
+      ir.verify();
+      mod = generate(*cxt, ir);
+      setTarget(*mod, *tm);
+      optimize(*mod, opt, tm.get());
+    } else if (jobs > 1) {
+      mod = generate(*cxt, prog, opt, jobs, cpu);
+    } else {
+      mod = generate(*cxt, prog);
+      setTarget(*mod, *tm);
+      optimize(*mod, opt, tm.get());
+    }
+
+    //The exit status is whatever main returns.
+    if (run) {
+      return runMain(std::move(cxt), std::move(mod));
+    }
 
-  parser p(syms, input);
-  decl* dec = p.parseDeclaration();
+    //Written straight to the file descriptor; only assembly and IR are
+    //opened as text.
+    std::string out = output ? output : getOutputPath(path, kind);
+    bool text = kind == emit_llvm || kind == emit_assembly;
+    std::error_code ec;
+    llvm::raw_fd_ostream os(out, ec, text ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+    if (ec) {
+      throw std::runtime_error("cannot open " + out + ": " + ec.message());
+    }
+    emit(*mod, *tm, kind, os);
+#else
+    (void)prog;
+    (void)level;
+    (void)jobs;
+    (void)output;
+    (void)emit_name;
+    (void)tier_stats;
+    (void)threshold;
+    (void)ssa;
+    if (run || tiered) {
+      std::cerr << "error: this build cannot run programs\n";
+      return 1;
+    }
+#endif
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
 }